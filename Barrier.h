@@ -0,0 +1,47 @@
+// Barrier.h
+
+// A meeting point for a fixed number of threads, reusable round after
+// round: wait() returns once every one of them has called it.  It lets
+// worker threads started once do many rounds of work, each round's results
+// combined between two waits, instead of starting and joining threads for
+// every round.  (C++11 has no barrier of its own.)  A wait also orders
+// memory, so what one thread wrote before it is seen by all the others
+// after it.
+
+#ifndef BARRIER_INCLUDED
+#define BARRIER_INCLUDED
+
+#include <mutex>
+#include <condition_variable>
+
+class Barrier
+{
+public:
+    explicit Barrier(unsigned int count) : m_count(count), m_waiting(0), m_round(0) {}
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        unsigned long long round = m_round;
+        if (++m_waiting == m_count)
+        {
+            m_waiting = 0;
+            m_round++;
+            m_next.notify_all();
+            return;
+        }
+        m_next.wait(lock, [this, round] { return m_round != round; });
+    }
+
+    Barrier(const Barrier&) = delete;
+    Barrier& operator=(const Barrier&) = delete;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_next;
+    unsigned int m_count;
+    unsigned int m_waiting;     // threads waiting in this round
+    unsigned long long m_round; // how many times everyone has met
+};
+
+#endif // BARRIER_INCLUDED
@@ -0,0 +1,844 @@
+#include "provided.h"
+#include "IndexedHeap.h"
+#include "SearchWorkspace.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <atomic>
+using namespace std;
+
+// A contraction hierarchy gives every node of the street graph a rank, then
+// removes ("contracts") the nodes one at a time in rank order.  Contracting v
+// adds a shortcut u->x for each pair of remaining neighbours whose shortest
+// route ran through v, so distances among the remaining nodes never change.
+// What's left is two small graphs: for each node, the arcs to higher ranked
+// nodes leaving it (up) and arriving at it (down).  Some shortest route from
+// s to t always climbs in rank and then descends, so a query searches up from
+// s and up (against the arcs) from t, and meets near the top of the hierarchy
+// after settling a few hundred nodes instead of thousands.  A shortcut
+// remembers the node it bypasses, so the route can be unpacked back into the
+// map's own segments.
+//
+// Layout of a saved hierarchy.  The file starts with a HierarchyHeader,
+// followed by these sections, each padded to an 8-byte boundary:
+//
+//   uint32_t      rank[nodeCount]
+//   uint32_t      upFirst[nodeCount + 1]
+//   HierarchyArc  up[upCount]
+//   uint32_t      downFirst[nodeCount + 1]
+//   HierarchyArc  down[downCount]
+//
+// mapFingerprint is a checksum of the map's graph, so a hierarchy is never
+// used with a map other than the one it was built from.  Like a map
+// snapshot, a loaded hierarchy is used in place.
+
+namespace
+{
+    const char HIERARCHY_MAGIC[8] = { 'G', 'O', 'O', 'B', 'C', 'H', '\0', '\0' };
+    const uint32_t HIERARCHY_VERSION = 1;
+    const uint32_t HIERARCHY_BYTE_ORDER = 0x01020304;
+    const unsigned int NO_NODE = 0xffffffff;
+
+    struct HierarchyHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t nodeCount;
+        uint32_t edgeCount;
+        uint32_t upCount;
+        uint32_t downCount;
+        uint64_t mapFingerprint;
+        uint64_t checksum;
+    };
+
+      // An arc of the hierarchy.  In up[], node is where the arc goes; in
+      // down[], where it comes from.  A shortcut bypasses the contracted node
+      // middle; any other arc is the map's edge number edge.
+    struct HierarchyArc
+    {
+        unsigned int node;
+        unsigned int middle;
+        unsigned int edge;
+        unsigned int padding;   // zero; keeps length aligned
+        double       length;
+    };
+
+    static_assert(sizeof(HierarchyArc) == 24, "hierarchy files store arcs directly");
+
+    uint64_t fnv1a(const char* p, size_t n, uint64_t h = 14695981039346656037ULL)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            h ^= static_cast<unsigned char>(p[i]);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    size_t padTo8(size_t n)
+    {
+        return (n + 7) & ~size_t(7);
+    }
+
+    uint64_t fingerprint(const StreetGraph& g)
+    {
+        uint64_t h = fnv1a(reinterpret_cast<const char*>(g.firstEdge), (g.nodeCount + 1) * sizeof(unsigned int));
+        return fnv1a(reinterpret_cast<const char*>(g.edges), g.firstEdge[g.nodeCount] * sizeof(StreetEdge), h);
+    }
+
+    // The graph while it is being contracted.  Arcs to a node are removed
+    // when it is contracted, so every arc here joins two remaining nodes.
+    class Contractor
+    {
+    public:
+        Contractor(const StreetGraph& graph);
+        void contractAll(vector<unsigned int>& rank,
+                         vector<unsigned int>& upFirst, vector<HierarchyArc>& up,
+                         vector<unsigned int>& downFirst, vector<HierarchyArc>& down);
+    private:
+        // Witness searches give up after settling this many nodes; a missed
+        // witness only costs an unneeded shortcut, never a wrong answer.
+        static const unsigned int WITNESS_SETTLE_LIMIT = 500;
+
+        vector<vector<HierarchyArc>> m_out;
+        vector<vector<HierarchyArc>> m_in;
+        vector<unsigned int> m_contractedNeighbours;
+        vector<unsigned int> m_level;     // 1 + highest level of a contracted neighbour
+
+        // witness search scratch space, reset after each search
+        IndexedHeap m_heap;
+        vector<double> m_dist;
+        vector<unsigned int> m_touched;
+
+        unsigned int contract(unsigned int v, bool simulate);
+        void witnessSearch(unsigned int source, unsigned int avoid, double limit);
+        void addArc(unsigned int from, unsigned int to, unsigned int middle, unsigned int edge, double length);
+        double priority(unsigned int v);
+    };
+
+    Contractor::Contractor(const StreetGraph& graph)
+     : m_out(graph.nodeCount), m_in(graph.nodeCount),
+       m_contractedNeighbours(graph.nodeCount, 0), m_level(graph.nodeCount, 0),
+       m_heap(graph.nodeCount), m_dist(graph.nodeCount, numeric_limits<double>::infinity())
+    {
+        for (unsigned int n = 0; n < graph.nodeCount; n++)
+        {
+            StreetEdgeRange edges = graph.edgesFrom(n);
+            for (const StreetEdge* e = edges.begin(); e != edges.end(); e++)
+            {
+                if ((*e).end != n)  // a loop never shortens anything
+                    addArc(n, (*e).end, NO_NODE, e - graph.edges, (*e).length);
+            }
+        }
+    }
+
+      // add the arc from -> to, or shorten it if it's already there
+    void Contractor::addArc(unsigned int from, unsigned int to, unsigned int middle, unsigned int edge, double length)
+    {
+        HierarchyArc a = { to, middle, edge, 0, length };
+        vector<HierarchyArc>& out = m_out[from];
+        vector<HierarchyArc>& in = m_in[to];
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            if (out[i].node == to)
+            {
+                if (length < out[i].length)
+                {
+                    out[i] = a;
+                    for (size_t j = 0; j < in.size(); j++)
+                    {
+                        if (in[j].node == from)
+                        {
+                            in[j] = a;
+                            in[j].node = from;
+                        }
+                    }
+                }
+                return;
+            }
+        }
+        out.push_back(a);
+        a.node = from;
+        in.push_back(a);
+    }
+
+      // shortest distances from source among the remaining nodes other than
+      // avoid, as far as limit; leaves them in m_dist
+    void Contractor::witnessSearch(unsigned int source, unsigned int avoid, double limit)
+    {
+        for (size_t i = 0; i < m_touched.size(); i++)
+            m_dist[m_touched[i]] = numeric_limits<double>::infinity();
+        m_touched.clear();
+        m_heap.clear();
+
+        m_dist[source] = 0;
+        m_touched.push_back(source);
+        m_heap.pushOrDecrease(source, 0);
+        unsigned int settled = 0;
+        while (!m_heap.empty()  &&  settled < WITNESS_SETTLE_LIMIT)
+        {
+            if (m_heap.topKey() > limit)
+                break;
+            unsigned int u = m_heap.pop();
+            settled++;
+            const vector<HierarchyArc>& out = m_out[u];
+            for (size_t i = 0; i < out.size(); i++)
+            {
+                unsigned int x = out[i].node;
+                if (x == avoid)
+                    continue;
+                double d = m_dist[u] + out[i].length;
+                if (d < m_dist[x])
+                {
+                    if (m_dist[x] == numeric_limits<double>::infinity())
+                        m_touched.push_back(x);
+                    m_dist[x] = d;
+                    m_heap.pushOrDecrease(x, d);
+                }
+            }
+        }
+    }
+
+      // Contract v, or if simulate, only count the shortcuts that would take.
+      // Returns the number of shortcuts.
+    unsigned int Contractor::contract(unsigned int v, bool simulate)
+    {
+        unsigned int shortcuts = 0;
+        const vector<HierarchyArc>& in = m_in[v];
+        const vector<HierarchyArc>& out = m_out[v];
+        struct Shortcut
+        {
+            unsigned int from;
+            unsigned int to;
+            double length;
+        };
+        vector<Shortcut> added;
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            unsigned int u = in[i].node;
+            double limit = 0;
+            for (size_t j = 0; j < out.size(); j++)
+            {
+                if (out[j].node != u)
+                    limit = max(limit, in[i].length + out[j].length);
+            }
+            if (limit == 0)
+                continue;
+            witnessSearch(u, v, limit);
+            for (size_t j = 0; j < out.size(); j++)
+            {
+                unsigned int x = out[j].node;
+                double viaV = in[i].length + out[j].length;
+                if (x == u  ||  m_dist[x] <= viaV)
+                    continue;   // there's a route at least as short without v
+                shortcuts++;
+                if (!simulate)
+                {
+                    Shortcut sc = { u, x, viaV };
+                    added.push_back(sc);
+                }
+            }
+        }
+        if (simulate)
+            return shortcuts;
+
+        // take v out of the graph, then add the shortcuts around it
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            vector<HierarchyArc>& neighbourOut = m_out[in[i].node];
+            for (size_t j = 0; j < neighbourOut.size(); j++)
+            {
+                if (neighbourOut[j].node == v)
+                {
+                    neighbourOut[j] = neighbourOut.back();
+                    neighbourOut.pop_back();
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            vector<HierarchyArc>& neighbourIn = m_in[out[i].node];
+            for (size_t j = 0; j < neighbourIn.size(); j++)
+            {
+                if (neighbourIn[j].node == v)
+                {
+                    neighbourIn[j] = neighbourIn.back();
+                    neighbourIn.pop_back();
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < added.size(); i++)
+            addArc(added[i].from, added[i].to, v, NO_NODE, added[i].length);
+        return shortcuts;
+    }
+
+      // Nodes whose contraction adds few shortcuts go first; counting
+      // contracted neighbours and levels spreads the contraction evenly over
+      // the map, which keeps the hierarchy shallow.
+    double Contractor::priority(unsigned int v)
+    {
+        int degree = m_in[v].size() + m_out[v].size();
+        int edgeDifference = 2 * int(contract(v, true)) - degree;
+        return 2.0 * edgeDifference + m_contractedNeighbours[v] + m_level[v];
+    }
+
+    void Contractor::contractAll(vector<unsigned int>& rank,
+                                 vector<unsigned int>& upFirst, vector<HierarchyArc>& up,
+                                 vector<unsigned int>& downFirst, vector<HierarchyArc>& down)
+    {
+        unsigned int nodeCount = m_out.size();
+        vector<double> currentPriority(nodeCount);
+        typedef pair<double, unsigned int> Candidate;
+        priority_queue<Candidate, vector<Candidate>, greater<Candidate>> queue;
+        for (unsigned int n = 0; n < nodeCount; n++)
+        {
+            currentPriority[n] = priority(n);
+            queue.push(Candidate(currentPriority[n], n));
+        }
+
+        vector<vector<HierarchyArc>> upOf(nodeCount);
+        vector<vector<HierarchyArc>> downOf(nodeCount);
+        rank.assign(nodeCount, NO_NODE);
+        unsigned int nextRank = 0;
+        while (!queue.empty())
+        {
+            Candidate c = queue.top();
+            queue.pop();
+            unsigned int v = c.second;
+            if (rank[v] != NO_NODE  ||  c.first != currentPriority[v])
+                continue;   // a stale entry
+            // lazy update: if v's priority has grown past the next node's,
+            // put it back and try again
+            double p = priority(v);
+            if (p != currentPriority[v])
+            {
+                currentPriority[v] = p;
+                if (!queue.empty()  &&  p > queue.top().first)
+                {
+                    queue.push(Candidate(p, v));
+                    continue;
+                }
+            }
+
+            // v's remaining arcs all join it to nodes ranked above it
+            rank[v] = nextRank++;
+            upOf[v] = m_out[v];
+            downOf[v] = m_in[v];
+            contract(v, false);
+
+            vector<unsigned int> neighbours;
+            for (size_t i = 0; i < upOf[v].size(); i++)
+                neighbours.push_back(upOf[v][i].node);
+            for (size_t i = 0; i < downOf[v].size(); i++)
+                neighbours.push_back(downOf[v][i].node);
+            sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            for (size_t i = 0; i < neighbours.size(); i++)
+            {
+                unsigned int n = neighbours[i];
+                m_contractedNeighbours[n]++;
+                m_level[n] = max(m_level[n], m_level[v] + 1);
+                currentPriority[n] = priority(n);
+                queue.push(Candidate(currentPriority[n], n));
+            }
+            m_out[v].clear();
+            m_in[v].clear();
+        }
+
+        upFirst.assign(1, 0);
+        downFirst.assign(1, 0);
+        up.clear();
+        down.clear();
+        for (unsigned int n = 0; n < nodeCount; n++)
+        {
+            up.insert(up.end(), upOf[n].begin(), upOf[n].end());
+            down.insert(down.end(), downOf[n].begin(), downOf[n].end());
+            upFirst.push_back(up.size());
+            downFirst.push_back(down.size());
+        }
+    }
+}
+
+class ContractionHierarchyImpl
+{
+public:
+    ContractionHierarchyImpl();
+    ~ContractionHierarchyImpl();
+    bool build(const StreetMap* sm);
+    bool load(string hierarchyFile, const StreetMap* sm);
+    bool save(string hierarchyFile) const;
+    bool isBuilt() const { return m_map != nullptr; }
+    bool isBuiltFor(const StreetMap* sm) const
+    {
+        return m_map == sm  &&  sm != nullptr  &&  m_generation == sm->generation();
+    }
+    unsigned int shortcutCount() const;
+    bool route(unsigned int start, unsigned int end, vector<unsigned int>& edges,
+               double& length, unsigned int& settled) const;
+    void distanceMatrix(const vector<unsigned int>& sources, const vector<unsigned int>& targets,
+                        vector<double>& distances) const;
+private:
+    const StreetMap* m_map;     // the map this hierarchy was built from, or nullptr
+    unsigned int m_generation;  // and that map's generation then
+    unsigned int m_nodeCount;
+    const unsigned int* m_rank;
+    const unsigned int* m_upFirst;
+    const HierarchyArc* m_up;
+    const unsigned int* m_downFirst;
+    const HierarchyArc* m_down;
+
+    // the arrays above point either into these (after build)...
+    vector<unsigned int> m_rankStore;
+    vector<unsigned int> m_upFirstStore;
+    vector<HierarchyArc> m_upStore;
+    vector<unsigned int> m_downFirstStore;
+    vector<HierarchyArc> m_downStore;
+    // ...or into this (after load)
+    MappedFile m_file;
+
+    void clear();
+    void unpack(unsigned int from, const HierarchyArc& arc, vector<unsigned int>& edges) const;
+    void searchUp(unsigned int from, bool forward, SearchWorkspace& ws, vector<unsigned int>& settled) const;
+};
+
+ContractionHierarchyImpl::ContractionHierarchyImpl()
+{
+    clear();
+}
+
+ContractionHierarchyImpl::~ContractionHierarchyImpl()
+{
+}
+
+void ContractionHierarchyImpl::clear()
+{
+    m_map = nullptr;
+    m_generation = 0;
+    m_nodeCount = 0;
+    m_rank = m_upFirst = m_downFirst = nullptr;
+    m_up = m_down = nullptr;
+    m_rankStore.clear();
+    m_upFirstStore.clear();
+    m_upStore.clear();
+    m_downFirstStore.clear();
+    m_downStore.clear();
+    m_file.close();
+}
+
+bool ContractionHierarchyImpl::build(const StreetMap* sm)
+{
+    clear();
+    const StreetGraph& graph = sm->graph();
+    Contractor c(graph);
+    c.contractAll(m_rankStore, m_upFirstStore, m_upStore, m_downFirstStore, m_downStore);
+    m_map = sm;
+    m_generation = sm->generation();
+    m_nodeCount = graph.nodeCount;
+    m_rank = m_rankStore.data();
+    m_upFirst = m_upFirstStore.data();
+    m_up = m_upStore.data();
+    m_downFirst = m_downFirstStore.data();
+    m_down = m_downStore.data();
+    return true;
+}
+
+bool ContractionHierarchyImpl::save(string hierarchyFile) const
+{
+    if (!isBuilt())
+        return false;
+    const StreetGraph& graph = m_map->graph();
+    unsigned int upCount = m_upFirst[m_nodeCount];
+    unsigned int downCount = m_downFirst[m_nodeCount];
+
+    string body;
+    auto append = [&](const void* p, size_t n)
+    {
+        body.append(static_cast<const char*>(p), n);
+        body.resize(padTo8(body.size()), '\0');
+    };
+    append(m_rank, m_nodeCount * sizeof(unsigned int));
+    append(m_upFirst, (m_nodeCount + 1) * sizeof(unsigned int));
+    append(m_up, upCount * sizeof(HierarchyArc));
+    append(m_downFirst, (m_nodeCount + 1) * sizeof(unsigned int));
+    append(m_down, downCount * sizeof(HierarchyArc));
+
+    HierarchyHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HIERARCHY_MAGIC, sizeof(header.magic));
+    header.version = HIERARCHY_VERSION;
+    header.byteOrder = HIERARCHY_BYTE_ORDER;
+    header.nodeCount = m_nodeCount;
+    header.edgeCount = graph.firstEdge[graph.nodeCount];
+    header.upCount = upCount;
+    header.downCount = downCount;
+    header.mapFingerprint = fingerprint(graph);
+    header.checksum = fnv1a(body.data(), body.size());
+
+    ofstream outf(hierarchyFile, ios::binary);
+    if (!outf)
+        return false;
+    outf.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outf.write(body.data(), body.size());
+    return bool(outf);
+}
+
+bool ContractionHierarchyImpl::load(string hierarchyFile, const StreetMap* sm)
+{
+    MappedFile f;
+    if (!f.open(hierarchyFile))
+        return false;
+
+    HierarchyHeader header;
+    if (f.size() < sizeof(header))
+        return false;
+    memcpy(&header, f.data(), sizeof(header));
+    const StreetGraph& graph = sm->graph();
+    if (memcmp(header.magic, HIERARCHY_MAGIC, sizeof(header.magic)) != 0  ||
+        header.version != HIERARCHY_VERSION  ||  header.byteOrder != HIERARCHY_BYTE_ORDER  ||
+        header.nodeCount != graph.nodeCount  ||  header.edgeCount != graph.firstEdge[graph.nodeCount]  ||
+        header.mapFingerprint != fingerprint(graph))
+        return false;
+
+    size_t n = header.nodeCount;
+    size_t expected = sizeof(header) + padTo8(n * sizeof(unsigned int)) +
+        2 * padTo8((n + 1) * sizeof(unsigned int)) +
+        padTo8(header.upCount * sizeof(HierarchyArc)) + padTo8(header.downCount * sizeof(HierarchyArc));
+    if (f.size() != expected  ||
+        fnv1a(f.data() + sizeof(header), f.size() - sizeof(header)) != header.checksum)
+        return false;
+
+    clear();
+    m_file.swap(f);
+
+    const char* p = m_file.data() + sizeof(header);
+    auto take = [&p](size_t bytes) -> const char*
+    {
+        const char* section = p;
+        p += padTo8(bytes);
+        return section;
+    };
+    m_rank = reinterpret_cast<const unsigned int*>(take(n * sizeof(unsigned int)));
+    m_upFirst = reinterpret_cast<const unsigned int*>(take((n + 1) * sizeof(unsigned int)));
+    m_up = reinterpret_cast<const HierarchyArc*>(take(header.upCount * sizeof(HierarchyArc)));
+    m_downFirst = reinterpret_cast<const unsigned int*>(take((n + 1) * sizeof(unsigned int)));
+    m_down = reinterpret_cast<const HierarchyArc*>(take(header.downCount * sizeof(HierarchyArc)));
+    m_nodeCount = header.nodeCount;
+    m_map = sm;
+    m_generation = sm->generation();
+    return true;
+}
+
+unsigned int ContractionHierarchyImpl::shortcutCount() const
+{
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < m_upFirst[m_nodeCount]; i++)
+        count += m_up[i].middle != NO_NODE;
+    for (unsigned int i = 0; i < m_downFirst[m_nodeCount]; i++)
+        count += m_down[i].middle != NO_NODE;
+    return count;
+}
+
+  // append to edges the map edges making up arc, which leaves from
+void ContractionHierarchyImpl::unpack(unsigned int from, const HierarchyArc& arc, vector<unsigned int>& edges) const
+{
+    if (arc.middle == NO_NODE)
+    {
+        edges.push_back(arc.edge);
+        return;
+    }
+    // The shortcut from -> arc.node bypasses middle, which was contracted
+    // before both ends, so its halves are middle's own arcs: from -> middle
+    // among its down arcs, middle -> arc.node among its up arcs.
+    unsigned int middle = arc.middle;
+    for (unsigned int i = m_downFirst[middle]; i < m_downFirst[middle+1]; i++)
+    {
+        if (m_down[i].node == from)
+        {
+            unpack(from, m_down[i], edges);
+            break;
+        }
+    }
+    for (unsigned int i = m_upFirst[middle]; i < m_upFirst[middle+1]; i++)
+    {
+        if (m_up[i].node == arc.node)
+        {
+            unpack(middle, m_up[i], edges);
+            break;
+        }
+    }
+}
+
+bool ContractionHierarchyImpl::route(unsigned int start, unsigned int end, vector<unsigned int>& edges,
+                                     double& length, unsigned int& settled) const
+{
+    edges.clear();
+    length = 0;
+    settled = 0;
+    if (start == end)
+        return true;
+
+    // forward search up from start, backward search up from end; each node
+    // remembers the node and arc it was reached by.  The workspaces belong to
+    // the thread and are reused by its every query.
+    static thread_local SearchWorkspace ws[2];
+    static thread_local vector<unsigned int> chain;
+    const double INF = numeric_limits<double>::infinity();
+    IndexedHeap* heap[2] = { &ws[0].heap(), &ws[1].heap() };
+    const unsigned int* first[2] = { m_upFirst, m_downFirst };
+    const HierarchyArc* arcs[2] = { m_up, m_down };
+
+    ws[0].start(m_nodeCount);
+    ws[1].start(m_nodeCount);
+    ws[0].reach(start, 0, NO_NODE);
+    ws[1].reach(end, 0, NO_NODE);
+    heap[0]->pushOrDecrease(start, 0);
+    heap[1]->pushOrDecrease(end, 0);
+    double best = INF;
+    unsigned int meeting = NO_NODE;
+
+    // alternate between the directions; a direction is finished once its
+    // nearest unsettled node is no closer than the best route found
+    int side = 0;
+    while (true)
+    {
+        bool forwardDone = heap[0]->empty()  ||  heap[0]->topKey() >= best;
+        bool backwardDone = heap[1]->empty()  ||  heap[1]->topKey() >= best;
+        if (forwardDone  &&  backwardDone)
+            break;
+        if ((side == 0 && forwardDone)  ||  (side == 1 && backwardDone))
+            side = 1 - side;
+
+        unsigned int u = heap[side]->pop();
+        settled++;
+        if (ws[1-side].reached(u)  &&  ws[side].distance(u) + ws[1-side].distance(u) < best)
+        {
+            best = ws[side].distance(u) + ws[1-side].distance(u);
+            meeting = u;
+        }
+        for (unsigned int i = first[side][u]; i < first[side][u+1]; i++)
+        {
+            const HierarchyArc& a = arcs[side][i];
+            double d = ws[side].distance(u) + a.length;
+            if (d < ws[side].distance(a.node))
+            {
+                ws[side].reach(a.node, d, u, i);
+                heap[side]->pushOrDecrease(a.node, d);
+            }
+        }
+        side = 1 - side;
+    }
+
+    if (meeting == NO_NODE)
+        return false;
+
+    // start .. meeting, collected backwards and then unpacked in order
+    chain.clear();
+    for (unsigned int n = meeting; n != start; n = ws[0].parent(n))
+        chain.push_back(n);
+    for (size_t i = chain.size(); i-- > 0; )
+    {
+        unsigned int n = chain[i];
+        unpack(ws[0].parent(n), m_up[ws[0].parentEdge(n)], edges);
+    }
+    // meeting .. end; a down arc stored at u leads from its node to u
+    for (unsigned int n = meeting; n != end; n = ws[1].parent(n))
+    {
+        HierarchyArc forward = m_down[ws[1].parentEdge(n)];
+        forward.node = ws[1].parent(n);
+        unpack(n, forward, edges);
+    }
+    length = best;
+    return true;
+}
+
+  // Settle every node that can be reached from "from" by climbing the
+  // hierarchy: along up arcs if forward, else against down arcs (which finds
+  // the routes from those nodes down to "from").  settled gets the nodes in
+  // the order they were settled, and ws their distances.
+void ContractionHierarchyImpl::searchUp(unsigned int from, bool forward, SearchWorkspace& ws,
+                                        vector<unsigned int>& settled) const
+{
+    const unsigned int* first = forward ? m_upFirst : m_downFirst;
+    const HierarchyArc* arcs = forward ? m_up : m_down;
+    IndexedHeap& heap = ws.heap();
+    settled.clear();
+    ws.start(m_nodeCount);
+    ws.reach(from, 0, NO_NODE);
+    heap.pushOrDecrease(from, 0);
+    while (!heap.empty())
+    {
+        unsigned int u = heap.pop();
+        settled.push_back(u);
+        for (unsigned int i = first[u]; i < first[u+1]; i++)
+        {
+            const HierarchyArc& a = arcs[i];
+            double d = ws.distance(u) + a.length;
+            if (d < ws.distance(a.node))
+            {
+                ws.reach(a.node, d, u, i);
+                heap.pushOrDecrease(a.node, d);
+            }
+        }
+    }
+}
+
+// Many-to-many distances by buckets.  Some shortest route from s to t climbs
+// to a top node and then descends, so a search up from each target (against
+// the arcs) leaves an entry in a bucket at every node it settles: the target
+// and its distance down from there.  A search up from each source then adds
+// its distance to each node it settles to the entries in that node's bucket,
+// and the least sum for each target is the answer.  That is one small search
+// per source and per target instead of a query per pair.  Each direction's
+// searches are handed out to threads one at a time.
+void ContractionHierarchyImpl::distanceMatrix(const vector<unsigned int>& sources, const vector<unsigned int>& targets,
+                                              vector<double>& distances) const
+{
+    struct BucketEntry
+    {
+        unsigned int target;    // index into targets
+        double distance;        // from the bucket's node down to the target
+    };
+    const double INF = numeric_limits<double>::infinity();
+    size_t columns = targets.size();
+    distances.assign(sources.size() * columns, INF);
+    if (sources.empty()  ||  targets.empty())
+        return;
+
+    auto inParallel = [](size_t jobs, const function<void(size_t)>& job)
+    {
+        atomic<size_t> nextJob(0);
+        auto work = [&]()
+        {
+            for (size_t j = nextJob++; j < jobs; j = nextJob++)
+                job(j);
+        };
+        size_t threadCount = min<size_t>(thread::hardware_concurrency(), jobs);
+        if (threadCount <= 1)
+            work();
+        else
+        {
+            vector<thread> threads;
+            for (size_t t = 0; t < threadCount; t++)
+                threads.push_back(thread(work));
+            for (size_t t = 0; t < threadCount; t++)
+                threads[t].join();
+        }
+    };
+    static thread_local SearchWorkspace ws;
+    static thread_local vector<unsigned int> settled;
+
+    // each target's search, kept apart so threads don't share anything, then
+    // gathered into buckets by node
+    vector<vector<pair<unsigned int, double>>> reached(columns);
+    inParallel(columns, [&](size_t j)
+    {
+        searchUp(targets[j], false, ws, settled);
+        reached[j].reserve(settled.size());
+        for (size_t k = 0; k < settled.size(); k++)
+            reached[j].push_back(make_pair(settled[k], ws.distance(settled[k])));
+    });
+    vector<unsigned int> bucketFirst(m_nodeCount + 1, 0);
+    for (size_t j = 0; j < columns; j++)
+    {
+        for (size_t k = 0; k < reached[j].size(); k++)
+            bucketFirst[reached[j][k].first + 1]++;
+    }
+    for (unsigned int n = 0; n < m_nodeCount; n++)
+        bucketFirst[n+1] += bucketFirst[n];
+    vector<BucketEntry> buckets(bucketFirst[m_nodeCount]);
+    vector<unsigned int> fill(bucketFirst.begin(), bucketFirst.end() - 1);
+    for (size_t j = 0; j < columns; j++)
+    {
+        for (size_t k = 0; k < reached[j].size(); k++)
+        {
+            BucketEntry e = { unsigned(j), reached[j][k].second };
+            buckets[fill[reached[j][k].first]++] = e;
+        }
+        vector<pair<unsigned int, double>>().swap(reached[j]);
+    }
+
+    inParallel(sources.size(), [&](size_t i)
+    {
+        searchUp(sources[i], true, ws, settled);
+        double* row = distances.data() + i * columns;
+        for (size_t k = 0; k < settled.size(); k++)
+        {
+            unsigned int u = settled[k];
+            double d = ws.distance(u);
+            for (unsigned int b = bucketFirst[u]; b < bucketFirst[u+1]; b++)
+            {
+                if (d + buckets[b].distance < row[buckets[b].target])
+                    row[buckets[b].target] = d + buckets[b].distance;
+            }
+        }
+    });
+}
+
+//******************** ContractionHierarchy functions ************************
+
+// These functions simply delegate to ContractionHierarchyImpl's functions.
+// You probably don't want to change any of this code.
+
+ContractionHierarchy::ContractionHierarchy()
+{
+    m_impl = new ContractionHierarchyImpl;
+}
+
+ContractionHierarchy::~ContractionHierarchy()
+{
+    delete m_impl;
+}
+
+bool ContractionHierarchy::build(const StreetMap* sm)
+{
+    return m_impl->build(sm);
+}
+
+bool ContractionHierarchy::load(string hierarchyFile, const StreetMap* sm)
+{
+    return m_impl->load(hierarchyFile, sm);
+}
+
+bool ContractionHierarchy::save(string hierarchyFile) const
+{
+    return m_impl->save(hierarchyFile);
+}
+
+bool ContractionHierarchy::isBuilt() const
+{
+    return m_impl->isBuilt();
+}
+
+bool ContractionHierarchy::isBuiltFor(const StreetMap* sm) const
+{
+    return m_impl->isBuiltFor(sm);
+}
+
+unsigned int ContractionHierarchy::shortcutCount() const
+{
+    return m_impl->shortcutCount();
+}
+
+bool ContractionHierarchy::route(unsigned int startNode, unsigned int endNode, vector<unsigned int>& edges,
+                                 double& length, unsigned int& nodesSettled) const
+{
+    return m_impl->route(startNode, endNode, edges, length, nodesSettled);
+}
+
+void ContractionHierarchy::distanceMatrix(const vector<unsigned int>& sources, const vector<unsigned int>& targets,
+                                          vector<double>& distances) const
+{
+    m_impl->distanceMatrix(sources, targets, distances);
+}
@@ -1,23 +1,158 @@
 #include "provided.h"
+#include "GeoDistance.h"
+#include "TourSearch.h"
+#include "HeldKarp.h"
+#include "MapStop.h"
+#include "Barrier.h"
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <limits>
 using namespace std;
 
+namespace
+{
+    const unsigned int NEIGHBORS = 10;     // how many of each point's nearest others TourSearch tries
+    const unsigned int KICKS_PER_ROUND = 100;   // by each thread
+
+      // how many threads the options ask for
+    unsigned int threadsFor(const OptimizerOptions& options)
+    {
+        return options.threads > 0 ? options.threads : max(1u, thread::hardware_concurrency());
+    }
+
+    template <typename Distance>
+    double tourLength(Distance dist, const vector<unsigned int>& order)
+    {
+        double length = 0;
+        for (size_t i = 0; i < order.size(); i++)
+            length += dist(order[i], order[(i + 1) % order.size()]);
+        return length;
+    }
+
+      // Iterated local search from search's tour, in rounds, leaving the
+      // best tour found in search.  Each thread has its own generator,
+      // seeded from the options' seed and the thread's number, and in each
+      // round makes its kicks from the best tour of the rounds before,
+      // keeping a kicked tour only if it's shorter.  Between rounds the
+      // shortest of the threads' tours (the lowest numbered thread's, in a
+      // tie) becomes the best, so the outcome doesn't depend on timing.
+      // The threads are started once and meet at a barrier before and after
+      // each round; this thread is thread 0, and alone decides whether
+      // there's another round.
+    template <typename Search>
+    void iterateKicks(Search& search, const OptimizerOptions& options)
+    {
+        typedef chrono::steady_clock Clock;
+        Clock::time_point deadline = Clock::now() + chrono::duration_cast<Clock::duration>(
+                                         chrono::duration<double>(options.timeBudget));
+        unsigned int threadCount = threadsFor(options);
+        vector<Search> current(threadCount, search), trial(threadCount, search);
+        vector<mt19937> rng;
+        for (unsigned int t = 0; t < threadCount; t++)
+        {
+            seed_seq seeds = { options.seed, t };
+            rng.push_back(mt19937(seeds));
+        }
+        
+        auto work = [&](unsigned int t)
+        {
+            current[t] = search;
+            for (unsigned int k = 0; k < KICKS_PER_ROUND; k++)
+            {
+                trial[t] = current[t];
+                trial[t].kick(rng[t]);
+                if (trial[t].length() < current[t].length())
+                    swap(current[t], trial[t]);
+            }
+        };
+        Barrier barrier(threadCount);
+        bool done = false;
+        vector<thread> threads;
+        for (unsigned int t = 1; t < threadCount; t++)
+        {
+            threads.push_back(thread([&, t]
+            {
+                for (;;)
+                {
+                    barrier.wait();     // for the round to start
+                    if (done)
+                        return;
+                    work(t);
+                    barrier.wait();     // for every thread to finish it
+                }
+            }));
+        }
+        for (unsigned int round = 0; ; round++)
+        {
+            done = (options.rounds > 0  &&  round >= options.rounds)  ||
+                   (options.timeBudget > 0  &&  Clock::now() >= deadline);
+            barrier.wait();
+            if (done)
+                break;
+            work(0);
+            barrier.wait();
+            for (unsigned int t = 0; t < threadCount; t++)
+            {
+                if (current[t].length() < search.length())
+                    search = current[t];
+            }
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+    }
+
+      // The shortest tour of the n points under dist, as read from point 0:
+      // exactly, if there are few enough, or else the best the search finds.
+      // row(p, out) gives the distances from p, for the neighbor lists.
+    template <typename Distance, typename Row>
+    void findTour(Distance dist, unsigned int n, Row row, const OptimizerOptions& options, vector<unsigned int>& order)
+    {
+        if (n - 1 <= min(options.exactLimit, HeldKarp::MAX_POINTS - 1))
+        {
+            HeldKarp exact;
+            exact.solve(dist, n, threadsFor(options), order);
+            return;
+        }
+        NeighborLists neighbors;
+        neighbors.build(n, NEIGHBORS, row);
+        TourSearch<Distance> search(dist, neighbors);
+        search.nearestNeighbor(0);
+        search.improve();
+        if (options.timeBudget > 0  ||  options.rounds > 0)
+            iterateKicks(search, options);
+        
+        const vector<unsigned int>& tour = search.order();
+        size_t start = find(tour.begin(), tour.end(), 0u) - tour.begin();
+        order.resize(n);
+        for (unsigned int i = 0; i < n; i++)
+            order[i] = tour[(start + i) % n];
+    }
+}
+
 class DeliveryOptimizerImpl
 {
 public:
-    DeliveryOptimizerImpl(const StreetMap* sm);
+    DeliveryOptimizerImpl(const StreetMap* sm, const OptimizerOptions& options);
     ~DeliveryOptimizerImpl();
     void optimizeDeliveryOrder(
         const GeoCoord& depot,
         vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
-        double& newCrowDistance) const;
+        double& newCrowDistance,
+        double* oldRoadDistance,
+        double* newRoadDistance) const;
     
 private:
     const StreetMap* m_stmap;
+    OptimizerOptions m_options;
 };
 
-DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm):m_stmap(sm)
+DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm, const OptimizerOptions& options)
+ : m_stmap(sm), m_options(options)
 {
 }
 
@@ -25,26 +160,85 @@ DeliveryOptimizerImpl::~DeliveryOptimizerImpl()
 {
 }
 
+// The depot is point 0 of a closed tour and the deliveries are points 1 to
+// n, in the order given; the tour that TourSearch finds, read from the depot,
+// is the new order; for few enough deliveries, HeldKarp finds the shortest
+// tour instead.  Distances are straight lines, or routes from the road
+// distance matrix if the options ask for them and every stop can reach every
+// other.  With a time budget or rounds in the options, iterated local search
+// follows the local search.  A new order is kept only if it's shorter than
+// the old one, by whichever distance it was found with.
 void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     const GeoCoord& depot,
     vector<DeliveryRequest>& deliveries,
     double& oldCrowDistance,
-    double& newCrowDistance) const
+    double& newCrowDistance,
+    double* oldRoadDistance,
+    double* newRoadDistance) const
 {
-    oldCrowDistance = distanceEarthMiles(depot,deliveries[0].location);
-    for (int i = 0; i != deliveries.size(); i++)
+    oldCrowDistance = newCrowDistance = 0;
+    if (oldRoadDistance != nullptr)
+        *oldRoadDistance = *newRoadDistance = 0;
+    if (deliveries.empty())
+        return;
+    
+    unsigned int n = deliveries.size() + 1;
+    vector<double> latitude(n), longitude(n), cosLatitude(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const GeoCoord& where = (i == 0 ? depot : deliveries[i-1].location);
+        latitude[i] = where.latitude;
+        longitude[i] = where.longitude;
+        cosLatitude[i] = cos(deg2rad(where.latitude));
+    }
+    CrowDistance crow = { latitude.data(), longitude.data(), cosLatitude.data() };
+    vector<unsigned int> given(n), order;
+    for (unsigned int i = 0; i < n; i++)
+        given[i] = i;
+    oldCrowDistance = newCrowDistance = tourLength(crow, given);
+    
+    vector<double> matrix;
+    bool found = false, byRoad = false;
+    if (m_options.roadDistance  ||  oldRoadDistance != nullptr)
+    {
+        vector<GeoCoord> points(1, depot);
+        for (size_t i = 0; i < deliveries.size(); i++)
+            points.push_back(deliveries[i].location);
+        found = roadDistanceMatrix(m_stmap, points, m_options.snapRadius, m_options.router, matrix);
+    }
+    RoadDistance road = { matrix.data(), n };
+    if (oldRoadDistance != nullptr)
+        *oldRoadDistance = *newRoadDistance = found ? tourLength(road, given) : numeric_limits<double>::infinity();
+    if (m_options.roadDistance  &&  found)
+        byRoad = find(matrix.begin(), matrix.end(), numeric_limits<double>::infinity()) == matrix.end();
+    
+    if (byRoad)
     {
-        if (i != deliveries.size()-1)
+        findTour(road, n, [&](unsigned int p, double* out)
         {
-        oldCrowDistance += distanceEarthMiles(deliveries[i].location,deliveries[i+1].location);
-        }
-        else
+            copy(matrix.begin() + size_t(p) * n, matrix.begin() + size_t(p + 1) * n, out);
+        }, m_options, order);
+        if (tourLength(road, order) >= tourLength(road, given))
+            return;
+    }
+    else
+    {
+        findTour(crow, n, [&](unsigned int p, double* out)
         {
-            oldCrowDistance += distanceEarthMiles(deliveries[i].location,depot);
-        }
+            distancesMiles(latitude[p], longitude[p], latitude.data(), longitude.data(), cosLatitude.data(), n, out);
+        }, m_options, order);
+        if (tourLength(crow, order) >= oldCrowDistance)
+            return;
     }
-
-    newCrowDistance = oldCrowDistance;
+    
+    vector<DeliveryRequest> reordered;
+    reordered.reserve(n - 1);
+    for (unsigned int i = 1; i < n; i++)
+        reordered.push_back(deliveries[order[i] - 1]);
+    deliveries.swap(reordered);
+    newCrowDistance = tourLength(crow, order);
+    if (oldRoadDistance != nullptr  &&  found)
+        *newRoadDistance = tourLength(road, order);
 }
 
 //******************** DeliveryOptimizer functions ****************************
@@ -54,7 +248,12 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
 
 DeliveryOptimizer::DeliveryOptimizer(const StreetMap* sm)
 {
-    m_impl = new DeliveryOptimizerImpl(sm);
+    m_impl = new DeliveryOptimizerImpl(sm, OptimizerOptions());
+}
+
+DeliveryOptimizer::DeliveryOptimizer(const StreetMap* sm, const OptimizerOptions& options)
+{
+    m_impl = new DeliveryOptimizerImpl(sm, options);
 }
 
 DeliveryOptimizer::~DeliveryOptimizer()
@@ -68,5 +267,17 @@ void DeliveryOptimizer::optimizeDeliveryOrder(
         double& oldCrowDistance,
         double& newCrowDistance) const
 {
-    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance);
+    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance, nullptr, nullptr);
+}
+
+void DeliveryOptimizer::optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        vector<DeliveryRequest>& deliveries,
+        double& oldCrowDistance,
+        double& newCrowDistance,
+        double& oldRoadDistance,
+        double& newRoadDistance) const
+{
+    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance,
+                                         &oldRoadDistance, &newRoadDistance);
 }
@@ -1,26 +1,58 @@
 #include "provided.h"
+#include "MapStop.h"
 #include <vector>
 #include <string>
+#include <limits>
 
 using namespace std;
 
+namespace
+{
+    // One piece of a route: a segment, or the part of one between a stop
+    // partway along it and one of its ends.
+    struct Step
+    {
+        unsigned int name;  // street name id
+        double angle;       // heading, as angleOfLine measures it
+        double length;      // in miles
+    };
+
+      // the same as angleBetween2Lines, for Steps
+    double angleBetween(const Step& s1, const Step& s2)
+    {
+        double result = s2.angle - s1.angle;
+        if (result < 0)
+            result += 360;
+        return result;
+    }
+}
+
 class DeliveryPlannerImpl
 {
 public:
-    DeliveryPlannerImpl(const StreetMap* sm);
+    DeliveryPlannerImpl(const StreetMap* sm, const PlannerOptions& options);
     ~DeliveryPlannerImpl();
     DeliveryResult generateDeliveryPlan(
         const GeoCoord& depot,
         const vector<DeliveryRequest>& deliveries,
         vector<DeliveryCommand>& commands,
-        double& totalDistanceTravelled) const;
+        double& totalDistanceTravelled,
+        vector<double>* legDistances) const;
     
 private:
     const StreetMap* m_stmap;
+    PlannerOptions m_options;
     string findDirFromAngle(const double angle) const;
+    DeliveryResult routeBetween(const PointToPointRouter& router, const MapStop& from, const MapStop& to,
+                                CompactRoute& path, vector<Step>& steps, double& dist) const;
+    void addStep(double fromLatitude, double fromLongitude, double toLatitude, double toLongitude,
+                 unsigned int name, vector<Step>& steps) const;
+    void addEdges(const vector<unsigned int>& edges, vector<Step>& steps) const;
+    void addDirections(const vector<Step>& steps, vector<DeliveryCommand>& commands) const;
 };
 
-DeliveryPlannerImpl::DeliveryPlannerImpl(const StreetMap* sm):m_stmap(sm)
+DeliveryPlannerImpl::DeliveryPlannerImpl(const StreetMap* sm, const PlannerOptions& options)
+ : m_stmap(sm), m_options(options)
 {
 }
 
@@ -32,188 +64,192 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
     const GeoCoord& depot,
     const vector<DeliveryRequest>& deliveries,
     vector<DeliveryCommand>& commands,
-    double& totalDistanceTravelled) const
+    double& totalDistanceTravelled,
+    vector<double>* legDistances) const
 {
-    DeliveryOptimizer optimize(m_stmap);
-    double oldCrow,newCrow;
+    if (legDistances != nullptr)
+        legDistances->clear();
     vector<DeliveryRequest> copy = deliveries;
-    optimize.optimizeDeliveryOrder(depot, copy, oldCrow, newCrow);
-    PointToPointRouter router(m_stmap);
+    if (!m_options.keepOrder)
+    {
+        OptimizerOptions optimizerOptions = m_options.optimizer;
+        optimizerOptions.snapRadius = m_options.snapRadius;     // so it finds the stops where we do
+        DeliveryOptimizer optimize(m_stmap, optimizerOptions);
+        double oldCrow,newCrow;
+        optimize.optimizeDeliveryOrder(depot, copy, oldCrow, newCrow);
+    }
+    PointToPointRouter router(m_stmap, m_options.router);
     totalDistanceTravelled = 0;
     
-    // calculate from depot to first location
-    GeoCoord start = depot;
-    GeoCoord end = copy[0].location;
-    if (start == end)
+    // look up every stop once; from here on the router works on node ids
+    MapStop depotStop;
+    vector<MapStop> stops(copy.size());
+    if (!locateStop(m_stmap, depot, m_options.snapRadius, depotStop))
+        return BAD_COORD;
+    for (size_t i = 0; i != copy.size(); i++)
     {
-        DeliveryCommand next_command;
-        next_command.initAsDeliverCommand(copy[0].item);
-        commands.push_back(next_command);
+        if (!locateStop(m_stmap, copy[i].location, m_options.snapRadius, stops[i]))
+            return BAD_COORD;
     }
-    else
+    
+    // from the depot to each location in turn, then back to the depot
+    CompactRoute path;
+    vector<Step> steps;
+    for (size_t i = 0; i <= copy.size(); i++)
     {
+        const MapStop& from = (i == 0 ? depotStop : stops[i-1]);
+        const MapStop& to = (i == copy.size() ? depotStop : stops[i]);
         double dist = 0;
-        list<StreetSegment> routeToTake;
-        DeliveryResult test = router.generatePointToPointRoute(start, end, routeToTake, dist);
-        if (test == NO_ROUTE)
-            return NO_ROUTE;
-        if (test == BAD_COORD)
-            return BAD_COORD;
-        totalDistanceTravelled += dist;
-        
-        double seg_dist = 0;
-        StreetSegment currentStreet = *routeToTake.begin();
-        for (auto p = routeToTake.begin(); p != routeToTake.end(); p++)
+        if (from.where != to.where)
         {
-            seg_dist += distanceEarthMiles((*p).start,(*p).end);
-            if ((*p).name != currentStreet.name)
-            {
-                DeliveryCommand next_command;
-                next_command.initAsProceedCommand(findDirFromAngle(angleOfLine(currentStreet)), currentStreet.name, seg_dist);
-                commands.push_back(next_command);
-                seg_dist = 0;
-                
-                // will only emit turn command if between the correct angles
-                // otherwise will postpone the proceed command to the next time the street changes
-                double angle_diff = angleBetween2Lines(currentStreet,(*p));
-                if (angle_diff > 1.0 && angle_diff < 359.0)
-                {
-                    DeliveryCommand turn;
-                    if (angle_diff < 180)
-                        turn.initAsTurnCommand("left", (*p).name);
-                    else
-                        turn.initAsTurnCommand("right", (*p).name);
-                    commands.push_back(turn);
-                }
-                currentStreet = (*p); // this is the new street we're on
-            }
-            if ((*p).end == end)
-            {
-                DeliveryCommand next_command;
-                next_command.initAsProceedCommand(findDirFromAngle(angleOfLine(currentStreet)),currentStreet.name,seg_dist);
-                seg_dist = 0;
-                commands.push_back(next_command);
-                DeliveryCommand final_command;
-                final_command.initAsDeliverCommand(copy[0].item);
-                commands.push_back(final_command);
-            }
+            DeliveryResult test = routeBetween(router, from, to, path, steps, dist);
+            if (test != DELIVERY_SUCCESS)
+                return test;
+            totalDistanceTravelled += dist;
+            addDirections(steps, commands);
+        }
+        if (legDistances != nullptr)
+            legDistances->push_back(dist);
+        if (i != copy.size())
+        {
+            DeliveryCommand deliver;
+            deliver.initAsDeliverCommand(copy[i].item);
+            commands.push_back(deliver);
         }
     }
-   
-    
-    // calculate from N location to N+1 location
-    for (int i = 0; i != copy.size(); i++)
+    return DELIVERY_SUCCESS;  
+}
+
+  // Proceed and turn commands for following steps.  A proceed command covers
+  // a street's steps up to and including the first one on the next street.
+void DeliveryPlannerImpl::addDirections(const vector<Step>& steps, vector<DeliveryCommand>& commands) const
+{
+    double seg_dist = 0;
+    const Step* currentStreet = &steps[0];
+    for (size_t k = 0; k < steps.size(); k++)
     {
-        double dist = 0;
-        list<StreetSegment> routeToTake;
-        if (i != copy.size()-1)
+        const Step& p = steps[k];
+        seg_dist += p.length;
+        if (p.name != currentStreet->name)
         {
-            GeoCoord start = copy[i].location;
-            GeoCoord end = copy[i+1].location;
-            DeliveryResult test = router.generatePointToPointRoute(start, end, routeToTake, dist);
-            if (test == NO_ROUTE)
-                return NO_ROUTE;
-            if (test == BAD_COORD)
-                return BAD_COORD;
-            if (start == end)
-            {
-                DeliveryCommand next_command;
-                next_command.initAsDeliverCommand(copy[i+1].item);
-                commands.push_back(next_command);
-            }
-            else
+            DeliveryCommand next_command;
+            next_command.initAsProceedCommand(findDirFromAngle(currentStreet->angle), m_stmap, currentStreet->name, seg_dist);
+            commands.push_back(next_command);
+            seg_dist = 0;
+            
+            // will only emit turn command if between the correct angles
+            // otherwise will postpone the proceed command to the next time the street changes
+            double angle_diff = angleBetween(*currentStreet, p);
+            if (angle_diff > 1.0 && angle_diff < 359.0)
             {
-                double seg_dist = 0;
-                StreetSegment currentStreet = *routeToTake.begin();
-                for (auto p = routeToTake.begin(); p != routeToTake.end(); p++)
-                {
-                    seg_dist += distanceEarthMiles((*p).start,(*p).end);
-                    if ((*p).name != currentStreet.name)
-                    {
-                        DeliveryCommand next_command;
-                        next_command.initAsProceedCommand(findDirFromAngle(angleOfLine(currentStreet)), currentStreet.name, seg_dist);
-                        commands.push_back(next_command);
-                        seg_dist = 0;
-                        
-                        // will only emit turn command if between the correct angles
-                        // otherwise will postpone the proceed command to the next time the street changes
-                        double angle_diff = angleBetween2Lines(currentStreet,(*p));
-                        if (angle_diff > 1.0 && angle_diff < 359.0)
-                        {
-                            DeliveryCommand turn;
-                            if (angle_diff < 180)
-                                turn.initAsTurnCommand("left", (*p).name);
-                            else
-                                turn.initAsTurnCommand("right", (*p).name);
-                            commands.push_back(turn);
-                        }
-                        currentStreet = (*p); // this is the new street we're on
-                    }
-                    if ((*p).end == end)
-                    {
-                        DeliveryCommand next_command;
-                        next_command.initAsProceedCommand(findDirFromAngle(angleOfLine(currentStreet)),currentStreet.name,seg_dist);
-                        seg_dist = 0;
-                        commands.push_back(next_command);
-                        DeliveryCommand final_command;
-                        final_command.initAsDeliverCommand(copy[i+1].item);
-                        commands.push_back(final_command);
-                    }
-                }
+                DeliveryCommand turn;
+                if (angle_diff < 180)
+                    turn.initAsTurnCommand("left", m_stmap, p.name);
+                else
+                    turn.initAsTurnCommand("right", m_stmap, p.name);
+                commands.push_back(turn);
             }
+            currentStreet = &p; // this is the new street we're on
         }
-        else
+    }
+    DeliveryCommand last_command;
+    last_command.initAsProceedCommand(findDirFromAngle(currentStreet->angle), m_stmap, currentStreet->name, seg_dist);
+    commands.push_back(last_command);
+}
+
+  // The shortest route between two stops, as steps.  A stop partway along
+  // a segment is left or reached by one of that segment's ends, so the route
+  // is the best of up to four between the ends' nodes, with the pieces of
+  // segment between the stops and the nodes added on.
+DeliveryResult DeliveryPlannerImpl::routeBetween(const PointToPointRouter& router, const MapStop& from, const MapStop& to,
+                                                 CompactRoute& path, vector<Step>& steps, double& dist) const
+{
+    steps.clear();
+    if (from.node != MapStop::NOT_AT_NODE  &&  to.node != MapStop::NOT_AT_NODE)
+    {
+        DeliveryResult result = router.generatePointToPointRoute(from.node, to.node, path);
+        if (result == DELIVERY_SUCCESS)
+        {
+            addEdges(path.edges, steps);
+            dist = path.length;
+        }
+        return result;
+    }
+    
+    const StreetGraph& graph = m_stmap->graph();
+    if (alongOneSegment(m_stmap, from, to, dist))
+    {
+        addStep(from.where.latitude, from.where.longitude, to.where.latitude, to.where.longitude,
+                graph.edges[from.snap.edge].name, steps);
+        return DELIVERY_SUCCESS;
+    }
+    
+    vector<Anchor> sources, targets;
+    anchorsOf(m_stmap, from, sources);
+    anchorsOf(m_stmap, to, targets);
+    vector<unsigned int> sourceNodes, targetNodes;
+    for (size_t i = 0; i < sources.size(); i++)
+        sourceNodes.push_back(sources[i].node);
+    for (size_t j = 0; j < targets.size(); j++)
+        targetNodes.push_back(targets[j].node);
+    vector<double> distances;
+    vector<CompactRoute> paths;
+    DeliveryResult result = router.computeDistanceMatrix(sourceNodes, targetNodes, distances, &paths);
+    if (result != DELIVERY_SUCCESS)
+        return result;
+    
+    size_t bestI = 0, bestJ = 0;
+    dist = numeric_limits<double>::infinity();
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        for (size_t j = 0; j < targets.size(); j++)
         {
-            GeoCoord start = copy[i].location;
-            GeoCoord end = depot;
-            DeliveryResult test = router.generatePointToPointRoute(start, end, routeToTake, dist);
-            if (test == NO_ROUTE)
-                return NO_ROUTE;
-            if (test == BAD_COORD)
-                return BAD_COORD;
-            if (start != end)
+            double d = sources[i].offset + distances[i * targets.size() + j] + targets[j].offset;
+            if (d < dist)
             {
-                double seg_dist = 0;
-                StreetSegment currentStreet = *routeToTake.begin();
-                for (auto p = routeToTake.begin(); p != routeToTake.end(); p++)
-                {
-                    seg_dist += distanceEarthMiles((*p).start,(*p).end);
-                    if ((*p).name != currentStreet.name)
-                    {
-                        DeliveryCommand next_command;
-                        next_command.initAsProceedCommand(findDirFromAngle(angleOfLine(currentStreet)), currentStreet.name, seg_dist);
-                        commands.push_back(next_command);
-                        seg_dist = 0;
-                        
-                        // will only emit turn command if between the correct angles
-                        // otherwise will postpone the proceed command to the next time the street changes
-                        double angle_diff = angleBetween2Lines(currentStreet,(*p));
-                        if (angle_diff > 1.0 && angle_diff < 359.0)
-                        {
-                            DeliveryCommand turn;
-                            if (angle_diff < 180)
-                                turn.initAsTurnCommand("left", (*p).name);
-                            else
-                                turn.initAsTurnCommand("right", (*p).name);
-                            commands.push_back(turn);
-                        }
-                        currentStreet = (*p); // this is the new street we're on
-                    }
-                    if ((*p).end == end)
-                    {
-                        DeliveryCommand final_command;
-                        final_command.initAsProceedCommand(findDirFromAngle(angleOfLine(currentStreet)),currentStreet.name,seg_dist);
-                        seg_dist = 0;
-                        commands.push_back(final_command);
-                    }
-                }
+                dist = d;
+                bestI = i;
+                bestJ = j;
             }
         }
-        totalDistanceTravelled += dist;
     }
-    return DELIVERY_SUCCESS;  
+    if (dist == numeric_limits<double>::infinity())
+        return NO_ROUTE;
+    
+    unsigned int first = sources[bestI].node;
+    unsigned int last = targets[bestJ].node;
+    if (from.node == MapStop::NOT_AT_NODE)
+        addStep(from.where.latitude, from.where.longitude, graph.latitude[first], graph.longitude[first],
+                graph.edges[from.snap.edge].name, steps);
+    addEdges(paths[bestI * targets.size() + bestJ].edges, steps);
+    if (to.node == MapStop::NOT_AT_NODE)
+        addStep(graph.latitude[last], graph.longitude[last], to.where.latitude, to.where.longitude,
+                graph.edges[to.snap.edge].name, steps);
+    return DELIVERY_SUCCESS;
 }
-                                                          
+
+  // a step that isn't a whole edge
+void DeliveryPlannerImpl::addStep(double fromLatitude, double fromLongitude, double toLatitude, double toLongitude,
+                                  unsigned int name, vector<Step>& steps) const
+{
+    double angle = rad2deg(atan2(toLatitude - fromLatitude, toLongitude - fromLongitude));
+    Step s = { name, angle < 0 ? angle + 360 : angle,
+               distanceEarthMiles(fromLatitude, fromLongitude, toLatitude, toLongitude) };
+    steps.push_back(s);
+}
+
+  // the steps along edges
+void DeliveryPlannerImpl::addEdges(const vector<unsigned int>& edges, vector<Step>& steps) const
+{
+    const StreetGraph& graph = m_stmap->graph();
+    for (size_t k = 0; k < edges.size(); k++)
+    {
+        const StreetEdge& e = graph.edges[edges[k]];
+        Step s = { e.name, graph.angle[edges[k]], e.length };
+        steps.push_back(s);
+    }
+}
+
 string DeliveryPlannerImpl::findDirFromAngle(const double angle) const
 {
     if (angle>= 0 && angle<22.5)
@@ -243,7 +279,12 @@ string DeliveryPlannerImpl::findDirFromAngle(const double angle) const
 
 DeliveryPlanner::DeliveryPlanner(const StreetMap* sm)
 {
-    m_impl = new DeliveryPlannerImpl(sm);
+    m_impl = new DeliveryPlannerImpl(sm, PlannerOptions());
+}
+
+DeliveryPlanner::DeliveryPlanner(const StreetMap* sm, const PlannerOptions& options)
+{
+    m_impl = new DeliveryPlannerImpl(sm, options);
 }
 
 DeliveryPlanner::~DeliveryPlanner()
@@ -257,5 +298,15 @@ DeliveryResult DeliveryPlanner::generateDeliveryPlan(
     vector<DeliveryCommand>& commands,
     double& totalDistanceTravelled) const
 {
-    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled);
+    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled, nullptr);
+}
+
+DeliveryResult DeliveryPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    vector<DeliveryCommand>& commands,
+    double& totalDistanceTravelled,
+    vector<double>& legDistances) const
+{
+    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled, &legDistances);
 }
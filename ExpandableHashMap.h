@@ -2,18 +2,50 @@
 
 // Skeleton for the ExpandableHashMap class template.  You must implement the first six
 // member functions.
-#include <list>
 
-template<typename KeyType, typename ValueType>
+#ifndef EXPANDABLEHASHMAP_INCLUDED
+#define EXPANDABLEHASHMAP_INCLUDED
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// How an ExpandableHashMap lays out its table.  Both layouts hash keys with a
+// function "unsigned int hasher(const KeyType&)" supplied by the user.
+
+  // an array of lists of separately allocated nodes
+struct ChainedBuckets {};
+
+  // one flat array of slots searched by Robin Hood linear probing; a parallel
+  // byte array records each slot's distance from its home slot, so a probe
+  // mostly reads those bytes and touches at most a couple of slots
+struct OpenAddressing {};
+
+  // chains that readers walk without taking any lock while a writer (one at a
+  // time) updates them; see the ConcurrentReads section below
+struct ConcurrentReads {};
+
+template<typename KeyType, typename ValueType, typename Layout = ChainedBuckets>
 class ExpandableHashMap
 {
 public:
-	ExpandableHashMap<KeyType,ValueType>(double maximumLoadFactor = 0.5);
+	  // With incrementalRehash, growing the table doesn't move every node at
+	  // once: the old and new bucket arrays are both kept, and each later
+	  // associate() moves a few old buckets over until the old array is empty.
+	  // This bounds the cost of any single associate() at the price of find()
+	  // checking two buckets while a move is in progress.
+	ExpandableHashMap(double maximumLoadFactor = 0.5, bool incrementalRehash = false);
 	~ExpandableHashMap();
 	void reset();
 	int size() const;
 	void associate(const KeyType& key, const ValueType& value);
 
+	  // make room for n associations, so inserting them won't rehash
+	void reserve(int n);
+
 	  // for a map that can't be modified, return a pointer to const ValueType
 	const ValueType* find(const KeyType& key) const;
 
@@ -34,64 +66,68 @@ private:
     
     //find which bucket to place the key and value in:
     unsigned int findBucket(const KeyType& k) const;
+    unsigned int findBucket(const KeyType& k, int buckets) const;
     class Node
     {
     public:
         KeyType m_key;
         ValueType m_value;
+        Node* m_next;
     };
-    std::list<Node*>* m_map;
+    
+    // Each bucket is a singly linked chain of nodes.  Bucket arrays are
+    // allocated zero-filled with calloc, so a new table's memory is only
+    // touched as buckets are used rather than all at once.
+    Node** m_map;
+    
+    // while an incremental rehash is in progress, the buckets of the old
+    // table from m_migrated on haven't been moved to m_map yet
+    bool m_incremental;
+    Node** m_old;
+    int m_oldBuckets;
+    int m_migrated;
+    
+    // old buckets moved per associate().  For any m_maxLoad of at least 1/4
+    // that's enough to finish a move before the next one is needed; if not,
+    // the rest of the old table is moved at once.
+    static const int MIGRATE_PER_OPERATION = 4;
+    
+    static Node** newTable(int buckets);
+    static const Node* findIn(const Node* chain, const KeyType& key);
+    void rehash(int buckets);
+    void migrate(int buckets);
+    void deleteAll();
 };
 
-template<typename KeyType, typename ValueType>
-ExpandableHashMap<KeyType,ValueType>::ExpandableHashMap(double maximumLoadFactor): m_maxLoad(maximumLoadFactor),m_size(0),m_buckets(8)
+template<typename KeyType, typename ValueType, typename Layout>
+ExpandableHashMap<KeyType,ValueType,Layout>::ExpandableHashMap(double maximumLoadFactor, bool incrementalRehash): m_maxLoad(maximumLoadFactor),m_size(0),m_buckets(8),m_incremental(incrementalRehash),m_old(nullptr),m_oldBuckets(0),m_migrated(0)
 {
-    m_map = new std::list<Node*> [8];
+    m_map = newTable(8);
 }
 
-template<typename KeyType, typename ValueType>
-ExpandableHashMap<KeyType,ValueType>::~ExpandableHashMap()
+template<typename KeyType, typename ValueType, typename Layout>
+ExpandableHashMap<KeyType,ValueType,Layout>::~ExpandableHashMap()
 {
-    for (int i = 0; i < m_buckets; i++)
-    {
-        if (!m_map[i].empty())
-        {
-            for (auto p = m_map[i].begin(); p != m_map[i].end(); p++)
-            {
-                delete (*p);
-            }
-        }
-    }
-    delete [] m_map;
+    deleteAll();
 }
 
-template<typename KeyType, typename ValueType>
-void ExpandableHashMap<KeyType,ValueType>::reset()
+template<typename KeyType, typename ValueType, typename Layout>
+void ExpandableHashMap<KeyType,ValueType,Layout>::reset()
 {
-    for (int i = 0; i < m_buckets; i++)
-    {
-        if (!m_map[i].empty())
-        {
-            for (auto p = m_map[i].begin(); p != m_map[i].end(); p++)
-            {
-                delete (*p);
-            }
-        }
-    }
-    delete [] m_map;
-    m_map = new std::list<Node*> [8];
+    deleteAll();
+    m_map = newTable(8);
     m_size = 0;
     m_buckets = 8;
 }
 
-template<typename KeyType, typename ValueType>
-int ExpandableHashMap<KeyType,ValueType>::size() const
+template<typename KeyType, typename ValueType, typename Layout>
+int ExpandableHashMap<KeyType,ValueType,Layout>::size() const
 {
     return m_size;
 }
 
-template<typename KeyType, typename ValueType>
-void ExpandableHashMap<KeyType,ValueType>::associate(const KeyType& key, const ValueType& value)
+template<typename KeyType, typename ValueType, typename Layout>
+void ExpandableHashMap<KeyType,ValueType,Layout>::associate(const KeyType& key, const ValueType& value)
 {
     ValueType* valueToChange = find(key);
     if (valueToChange)
@@ -104,27 +140,25 @@ void ExpandableHashMap<KeyType,ValueType>::associate(const KeyType& key, const V
     double buckets = m_buckets;
     double load = size/buckets;
     
+    if (m_old != nullptr)
+        migrate(MIGRATE_PER_OPERATION);
+    
     // if adding this item will exceed the max load factor, rehash table
     if (load > m_maxLoad)
     {
-        std::list<Node*>* new_map;
-        int old_bucket_number = m_buckets;
-        m_buckets *= 2;
-        new_map = new std::list<Node*>[m_buckets];
-        for (int i = 0; i < old_bucket_number; i++)
+        if (!m_incremental)
+            rehash(m_buckets * 2);
+        else
         {
-            if (!m_map[i].empty())
-            {
-                for (auto p = m_map[i].begin(); p != m_map[i].end(); p++)
-                {
-                    unsigned int new_bucket = findBucket((*p)->m_key);
-                    new_map[new_bucket].push_back(*p);
-                }
-            }
+            // start moving to a table twice the size; the nodes follow a few
+            // buckets at a time in later calls
+            migrate(m_oldBuckets);
+            m_old = m_map;
+            m_oldBuckets = m_buckets;
+            m_migrated = 0;
+            m_buckets *= 2;
+            m_map = newTable(m_buckets);
         }
-             
-        delete [] m_map;
-        m_map = new_map;
     }
     
     unsigned int bucket_num = findBucket(key);
@@ -133,36 +167,691 @@ void ExpandableHashMap<KeyType,ValueType>::associate(const KeyType& key, const V
     new_association = new Node;
     new_association->m_key = key;
     new_association->m_value = value;
-    m_map[bucket_num].push_back(new_association);
+    new_association->m_next = m_map[bucket_num];
+    m_map[bucket_num] = new_association;
     
 }
 
+template<typename KeyType, typename ValueType, typename Layout>
+void ExpandableHashMap<KeyType,ValueType,Layout>::reserve(int n)
+{
+    int buckets = m_buckets;
+    while (n > buckets * m_maxLoad)
+        buckets *= 2;
+    if (buckets != m_buckets)
+        rehash(buckets);
+}
+
 // If no association exists with the given key, return nullptr; otherwise,
 // return a pointer to the value associated with that key. This pointer can be // used to examine that value, and if the hashmap is allowed to be modified, to // modify that value directly within the map (the second overload enables
 // this). Using a little C++ magic, we have implemented it in terms of the
 // first overload, which you must implement.
 
+template<typename KeyType, typename ValueType, typename Layout>
+const ValueType* ExpandableHashMap<KeyType,ValueType,Layout>::find(const KeyType& key) const
+{
+    const Node* n = findIn(m_map[findBucket(key)], key);
+    
+    // the key may still be in a bucket of the old table that hasn't moved yet
+    if (!n  &&  m_old != nullptr)
+    {
+        unsigned int old_bucket = findBucket(key, m_oldBuckets);
+        if (old_bucket >= static_cast<unsigned int>(m_migrated))
+            n = findIn(m_old[old_bucket], key);
+    }
+    
+    return n ? &n->m_value : nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Layout>
+const typename ExpandableHashMap<KeyType,ValueType,Layout>::Node*
+ExpandableHashMap<KeyType,ValueType,Layout>::findIn(const Node* chain, const KeyType& key)
+{
+    for (const Node* p = chain; p != nullptr; p = p->m_next)
+    {
+        if (p->m_key == key)
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Layout>
+typename ExpandableHashMap<KeyType,ValueType,Layout>::Node**
+ExpandableHashMap<KeyType,ValueType,Layout>::newTable(int buckets)
+{
+    void* p = std::calloc(buckets, sizeof(Node*));
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return static_cast<Node**>(p);
+}
+
+template<typename KeyType, typename ValueType, typename Layout>
+void ExpandableHashMap<KeyType,ValueType,Layout>::deleteAll()
+{
+    migrate(m_oldBuckets);
+    for (int i = 0; i < m_buckets; i++)
+    {
+        Node* p = m_map[i];
+        while (p != nullptr)
+        {
+            Node* next = p->m_next;
+            delete p;
+            p = next;
+        }
+    }
+    std::free(m_map);
+}
+
+// Move every node into a new table with the given number of buckets.
+template<typename KeyType, typename ValueType, typename Layout>
+void ExpandableHashMap<KeyType,ValueType,Layout>::rehash(int buckets)
+{
+    migrate(m_oldBuckets);  // finish any incremental rehash first
+    Node** new_map = newTable(buckets);
+    for (int i = 0; i < m_buckets; i++)
+    {
+        Node* p = m_map[i];
+        while (p != nullptr)
+        {
+            Node* next = p->m_next;
+            unsigned int new_bucket = findBucket(p->m_key, buckets);
+            p->m_next = new_map[new_bucket];
+            new_map[new_bucket] = p;
+            p = next;
+        }
+    }
+    std::free(m_map);
+    m_map = new_map;
+    m_buckets = buckets;
+}
+
+// Move up to the given number of buckets of the old table into m_map.
+template<typename KeyType, typename ValueType, typename Layout>
+void ExpandableHashMap<KeyType,ValueType,Layout>::migrate(int buckets)
+{
+    for ( ; buckets > 0  &&  m_migrated < m_oldBuckets; buckets--, m_migrated++)
+    {
+        Node* p = m_old[m_migrated];
+        while (p != nullptr)
+        {
+            Node* next = p->m_next;
+            unsigned int new_bucket = findBucket(p->m_key);
+            p->m_next = m_map[new_bucket];
+            m_map[new_bucket] = p;
+            p = next;
+        }
+    }
+    if (m_old != nullptr  &&  m_migrated == m_oldBuckets)
+    {
+        std::free(m_old);
+        m_old = nullptr;
+        m_oldBuckets = 0;
+        m_migrated = 0;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Layout>
+unsigned int ExpandableHashMap<KeyType,ValueType,Layout>::findBucket(const KeyType& k) const
+{
+    return findBucket(k, m_buckets);
+}
+
+template<typename KeyType, typename ValueType, typename Layout>
+unsigned int ExpandableHashMap<KeyType,ValueType,Layout>::findBucket(const KeyType& k, int buckets) const
+{
+    unsigned int hasher(const KeyType& k); // prototype
+    unsigned int h = hasher(k);
+    unsigned int bucket_num = h % buckets;
+    return bucket_num;
+}
+
+//******************** OpenAddressing layout **********************************
+
 template<typename KeyType, typename ValueType>
-const ValueType* ExpandableHashMap<KeyType,ValueType>::find(const KeyType& key) const
+class ExpandableHashMap<KeyType,ValueType,OpenAddressing>
 {
-    unsigned int bucket_num = findBucket(key);
+public:
+    ExpandableHashMap(double maximumLoadFactor = 0.5);
+    ~ExpandableHashMap();
+    void reset();
+    int size() const;
+    void associate(const KeyType& key, const ValueType& value);
+    void associate(KeyType&& key, ValueType&& value);
+
+      // If key has no association, associate it with a ValueType constructed
+      // in place from args.  Either way, return a pointer to key's value.
+    template<typename... Args>
+    ValueType* emplace(const KeyType& key, Args&&... args);
+
+      // make room for n associations, so inserting them won't rehash
+    void reserve(int n);
+
+      // remove key's association; return false if it had none
+    bool erase(const KeyType& key);
+
+    const ValueType* find(const KeyType& key) const;
+
+    ValueType* find(const KeyType& key)
+    {
+        return const_cast<ValueType*>(const_cast<const ExpandableHashMap*>(this)->find(key));
+    }
+
+    ExpandableHashMap(const ExpandableHashMap&) = delete;
+    ExpandableHashMap& operator=(const ExpandableHashMap&) = delete;
+
+private:
+    struct Slot
+    {
+        KeyType m_key;
+        ValueType m_value;
+    };
+    
+    double m_maxLoad;
+    int m_size;
+    unsigned int m_capacity;    // a power of 2
+    unsigned int m_shift;       // 32 - log2(m_capacity)
+    unsigned char* m_dist;      // 0 if the slot is empty, else 1 + its distance from home
+    Slot* m_slots;              // raw storage; only slots with m_dist != 0 hold objects
     
-    for (auto p = m_map[bucket_num].begin(); p != m_map[bucket_num].end(); p++)
+    static const unsigned char MAX_DIST = 255;
+    
+    unsigned int homeSlot(const KeyType& k) const;
+    void allocate(unsigned int capacity);
+    void destroyAll();
+    void grow(unsigned int capacity);
+    void place(Slot&& s);
+    template<typename K, typename V>
+    void put(K&& key, V&& value);
+};
+
+template<typename KeyType, typename ValueType>
+ExpandableHashMap<KeyType,ValueType,OpenAddressing>::ExpandableHashMap(double maximumLoadFactor): m_maxLoad(maximumLoadFactor),m_size(0)
+{
+    allocate(8);
+}
+
+template<typename KeyType, typename ValueType>
+ExpandableHashMap<KeyType,ValueType,OpenAddressing>::~ExpandableHashMap()
+{
+    destroyAll();
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::reset()
+{
+    destroyAll();
+    allocate(8);
+    m_size = 0;
+}
+
+template<typename KeyType, typename ValueType>
+int ExpandableHashMap<KeyType,ValueType,OpenAddressing>::size() const
+{
+    return m_size;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::associate(const KeyType& key, const ValueType& value)
+{
+    put(key, value);
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::associate(KeyType&& key, ValueType&& value)
+{
+    put(std::move(key), std::move(value));
+}
+
+template<typename KeyType, typename ValueType>
+template<typename... Args>
+ValueType* ExpandableHashMap<KeyType,ValueType,OpenAddressing>::emplace(const KeyType& key, Args&&... args)
+{
+    ValueType* existing = find(key);
+    if (existing)
+        return existing;
+    if (m_size + 1 > m_capacity * m_maxLoad)
+        grow(m_capacity * 2);
+    m_size++;
+    place(Slot{ key, ValueType(std::forward<Args>(args)...) });
+    return find(key);
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::reserve(int n)
+{
+    unsigned int capacity = m_capacity;
+    while (n > capacity * m_maxLoad)
+        capacity *= 2;
+    if (capacity != m_capacity)
+        grow(capacity);
+}
+
+// Removing an association shifts the run of slots after it back by one,
+// until a slot that is empty or already at home, so no tombstones are needed.
+template<typename KeyType, typename ValueType>
+bool ExpandableHashMap<KeyType,ValueType,OpenAddressing>::erase(const KeyType& key)
+{
+    unsigned int mask = m_capacity - 1;
+    unsigned int i = homeSlot(key);
+    for (unsigned int d = 1; m_dist[i] >= d; d++)
     {
-        if ((*p)->m_key == key)
+        if (m_dist[i] == d  &&  m_slots[i].m_key == key)
         {
-            return &(*p)->m_value;
+            m_slots[i].~Slot();
+            for (unsigned int next = (i + 1) & mask; m_dist[next] > 1; next = (next + 1) & mask)
+            {
+                new (&m_slots[i]) Slot(std::move(m_slots[next]));
+                m_slots[next].~Slot();
+                m_dist[i] = m_dist[next] - 1;
+                i = next;
+            }
+            m_dist[i] = 0;
+            m_size--;
+            return true;
         }
+        i = (i + 1) & mask;
     }
+    return false;
+}
+
+template<typename KeyType, typename ValueType>
+const ValueType* ExpandableHashMap<KeyType,ValueType,OpenAddressing>::find(const KeyType& key) const
+{
+    unsigned int mask = m_capacity - 1;
+    unsigned int i = homeSlot(key);
     
+    // Robin Hood order means that once we pass a slot closer to its home than
+    // key would be, key can't be further along
+    for (unsigned int d = 1; m_dist[i] >= d; d++)
+    {
+        if (m_dist[i] == d  &&  m_slots[i].m_key == key)
+            return &m_slots[i].m_value;
+        i = (i + 1) & mask;
+    }
     return nullptr;
 }
 
 template<typename KeyType, typename ValueType>
-unsigned int ExpandableHashMap<KeyType,ValueType>::findBucket(const KeyType& k) const
+unsigned int ExpandableHashMap<KeyType,ValueType,OpenAddressing>::homeSlot(const KeyType& k) const
 {
     unsigned int hasher(const KeyType& k); // prototype
-    unsigned int h = hasher(k);
-    unsigned int bucket_num = h % m_buckets;
-    return bucket_num;
+    // Fibonacci hashing spreads the hasher's bits over the top log2(m_capacity) bits
+    return (hasher(k) * 2654435769u) >> m_shift;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::allocate(unsigned int capacity)
+{
+    m_capacity = capacity;
+    m_shift = 32;
+    for (unsigned int c = capacity; c > 1; c /= 2)
+        m_shift--;
+    m_dist = new unsigned char[capacity]();
+    m_slots = static_cast<Slot*>(::operator new(capacity * sizeof(Slot)));
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::destroyAll()
+{
+    for (unsigned int i = 0; i < m_capacity; i++)
+    {
+        if (m_dist[i] != 0)
+            m_slots[i].~Slot();
+    }
+    delete [] m_dist;
+    ::operator delete(m_slots);
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::grow(unsigned int capacity)
+{
+    unsigned char* oldDist = m_dist;
+    Slot* oldSlots = m_slots;
+    unsigned int oldCapacity = m_capacity;
+    allocate(capacity);
+    for (unsigned int i = 0; i < oldCapacity; i++)
+    {
+        if (oldDist[i] != 0)
+        {
+            place(std::move(oldSlots[i]));
+            oldSlots[i].~Slot();
+        }
+    }
+    delete [] oldDist;
+    ::operator delete(oldSlots);
+}
+
+// Insert s, which must not already be in the table.
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::place(Slot&& s)
+{
+    unsigned int mask = m_capacity - 1;
+    unsigned int i = homeSlot(s.m_key);
+    unsigned int d = 1;
+    Slot carry(std::move(s));
+    for (;;)
+    {
+        if (d == MAX_DIST)
+        {
+            // a pathological cluster; spread things out and try again
+            grow(m_capacity * 2);
+            place(std::move(carry));
+            return;
+        }
+        if (m_dist[i] == 0)
+        {
+            new (&m_slots[i]) Slot(std::move(carry));
+            m_dist[i] = d;
+            return;
+        }
+        if (m_dist[i] < d)
+        {
+            // take from the rich: the resident is closer to home than we are
+            std::swap(carry, m_slots[i]);
+            unsigned int residentDist = m_dist[i];
+            m_dist[i] = d;
+            d = residentDist;
+        }
+        i = (i + 1) & mask;
+        d++;
+    }
+}
+
+template<typename KeyType, typename ValueType>
+template<typename K, typename V>
+void ExpandableHashMap<KeyType,ValueType,OpenAddressing>::put(K&& key, V&& value)
+{
+    ValueType* valueToChange = find(key);
+    if (valueToChange)
+    {
+        *valueToChange = std::forward<V>(value);
+        return;
+    }
+    // if adding this item would exceed the max load factor, double the table
+    if (m_size + 1 > m_capacity * m_maxLoad)
+        grow(m_capacity * 2);
+    m_size++;
+    place(Slot{ std::forward<K>(key), std::forward<V>(value) });
+}
+
+//******************** ConcurrentReads layout *********************************
+
+// A map that many threads can read while one thread at a time updates it.
+//
+// Readers take no lock.  find() and visit() run inside a read-side critical
+// section: the reader bumps one of a set of counters tagged with the current
+// grace-period parity, and a writer that needs to free memory flips the parity
+// and waits for the old parity's counters to drain (the scheme used by
+// user-space RCU).  Nodes are never modified once another thread can see them:
+// changing a value splices in a new node, and growing the table builds a new
+// table of new nodes; the old ones are freed only after that wait.  Writers
+// are serialized by a mutex, so associate() may be called from any thread.
+//
+// Because a value can be replaced while a reader looks at it, there is no
+// pointer-returning find(); find() copies the value out, and visit() calls a
+// function on it in place while the critical section is held.
+
+template<typename KeyType, typename ValueType>
+class ExpandableHashMap<KeyType,ValueType,ConcurrentReads>
+{
+public:
+    ExpandableHashMap(double maximumLoadFactor = 0.5);
+    ~ExpandableHashMap();
+    void reset();
+    int size() const;
+    void associate(const KeyType& key, const ValueType& value);
+    void reserve(int n);
+
+      // If key is in the map, set value to a copy of its value and return true.
+    bool find(const KeyType& key, ValueType& value) const;
+
+      // If key is in the map, call f(const ValueType&) on its value and return
+      // true.  The value can't be freed while f runs; f must not call
+      // associate() or reset() on this map.
+    template<typename F>
+    bool visit(const KeyType& key, F f) const;
+
+    ExpandableHashMap(const ExpandableHashMap&) = delete;
+    ExpandableHashMap& operator=(const ExpandableHashMap&) = delete;
+
+private:
+    struct Node
+    {
+        Node(const KeyType& k, const ValueType& v, Node* next) : m_key(k), m_value(v), m_next(next) {}
+        const KeyType m_key;
+        const ValueType m_value;
+        std::atomic<Node*> m_next;
+    };
+    
+    struct Table
+    {
+        Table(unsigned int buckets) : m_buckets(buckets), m_heads(new std::atomic<Node*>[buckets])
+        {
+            for (unsigned int i = 0; i < buckets; i++)
+                m_heads[i].store(nullptr, std::memory_order_relaxed);
+        }
+        ~Table() { delete [] m_heads; }
+        unsigned int m_buckets;
+        std::atomic<Node*>* m_heads;
+    };
+    
+    // read-side counters, striped so readers on different threads don't
+    // fight over one cache line
+    static const int READER_SHARDS = 16;
+    struct alignas(64) ReaderCount
+    {
+        std::atomic<long> m_count;
+    };
+    
+    double m_maxLoad;
+    std::atomic<int> m_size;
+    std::atomic<Table*> m_table;
+    std::mutex m_writeLock;
+    std::atomic<unsigned int> m_phase;
+    mutable ReaderCount m_readers[2][READER_SHARDS];
+    
+    unsigned int findBucket(const KeyType& k, unsigned int buckets) const;
+    static int readerShard();
+    unsigned int beginRead() const;
+    void endRead(unsigned int parity) const;
+    void waitForReaders();
+    static void deleteTable(Table* t);
+    const Node* findNode(const Table* t, const KeyType& key) const;
+    void grow(unsigned int buckets);
+};
+
+template<typename KeyType, typename ValueType>
+ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::ExpandableHashMap(double maximumLoadFactor): m_maxLoad(maximumLoadFactor),m_size(0),m_table(new Table(8)),m_phase(0)
+{
+    for (int p = 0; p < 2; p++)
+        for (int i = 0; i < READER_SHARDS; i++)
+            m_readers[p][i].m_count.store(0, std::memory_order_relaxed);
+}
+
+template<typename KeyType, typename ValueType>
+ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::~ExpandableHashMap()
+{
+    deleteTable(m_table.load());
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::reset()
+{
+    std::lock_guard<std::mutex> lock(m_writeLock);
+    Table* old = m_table.exchange(new Table(8));
+    m_size = 0;
+    waitForReaders();
+    deleteTable(old);
 }
+
+template<typename KeyType, typename ValueType>
+int ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::size() const
+{
+    return m_size.load();
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::associate(const KeyType& key, const ValueType& value)
+{
+    std::lock_guard<std::mutex> lock(m_writeLock);
+    Table* t = m_table.load();
+    unsigned int b = findBucket(key, t->m_buckets);
+    
+    // replace an existing node by splicing a new one in its place
+    std::atomic<Node*>* link = &t->m_heads[b];
+    for (Node* p = link->load(); p != nullptr; p = link->load())
+    {
+        if (p->m_key == key)
+        {
+            link->store(new Node(key, value, p->m_next.load()), std::memory_order_release);
+            waitForReaders();
+            delete p;
+            return;
+        }
+        link = &p->m_next;
+    }
+    
+    if (m_size + 1 > t->m_buckets * m_maxLoad)
+    {
+        grow(t->m_buckets * 2);
+        t = m_table.load();
+        b = findBucket(key, t->m_buckets);
+    }
+    // a new node goes at the head of its chain; nothing is freed, so there's
+    // no need to wait for readers
+    t->m_heads[b].store(new Node(key, value, t->m_heads[b].load()), std::memory_order_release);
+    m_size++;
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::reserve(int n)
+{
+    std::lock_guard<std::mutex> lock(m_writeLock);
+    unsigned int buckets = m_table.load()->m_buckets;
+    while (n > buckets * m_maxLoad)
+        buckets *= 2;
+    if (buckets != m_table.load()->m_buckets)
+        grow(buckets);
+}
+
+template<typename KeyType, typename ValueType>
+bool ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::find(const KeyType& key, ValueType& value) const
+{
+    return visit(key, [&value](const ValueType& v) { value = v; });
+}
+
+template<typename KeyType, typename ValueType>
+template<typename F>
+bool ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::visit(const KeyType& key, F f) const
+{
+    unsigned int parity = beginRead();
+    const Node* n = findNode(m_table.load(std::memory_order_acquire), key);
+    if (n)
+        f(n->m_value);
+    endRead(parity);
+    return n != nullptr;
+}
+
+template<typename KeyType, typename ValueType>
+const typename ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::Node*
+ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::findNode(const Table* t, const KeyType& key) const
+{
+    unsigned int b = findBucket(key, t->m_buckets);
+    for (const Node* p = t->m_heads[b].load(std::memory_order_acquire); p != nullptr;
+         p = p->m_next.load(std::memory_order_acquire))
+    {
+        if (p->m_key == key)
+            return p;
+    }
+    return nullptr;
+}
+
+// Build a bigger table out of copies of every node, publish it, and free the
+// old one once no reader can still be walking it.  The writer lock is held.
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::grow(unsigned int buckets)
+{
+    Table* old = m_table.load();
+    Table* t = new Table(buckets);
+    for (unsigned int i = 0; i < old->m_buckets; i++)
+    {
+        for (Node* p = old->m_heads[i].load(); p != nullptr; p = p->m_next.load())
+        {
+            unsigned int b = findBucket(p->m_key, buckets);
+            t->m_heads[b].store(new Node(p->m_key, p->m_value, t->m_heads[b].load()), std::memory_order_relaxed);
+        }
+    }
+    m_table.store(t, std::memory_order_release);
+    waitForReaders();
+    deleteTable(old);
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::deleteTable(Table* t)
+{
+    for (unsigned int i = 0; i < t->m_buckets; i++)
+    {
+        Node* p = t->m_heads[i].load();
+        while (p != nullptr)
+        {
+            Node* next = p->m_next.load();
+            delete p;
+            p = next;
+        }
+    }
+    delete t;
+}
+
+template<typename KeyType, typename ValueType>
+int ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::readerShard()
+{
+    static std::atomic<int> nextShard(0);
+    thread_local int shard = nextShard++ % READER_SHARDS;
+    return shard;
+}
+
+template<typename KeyType, typename ValueType>
+unsigned int ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::beginRead() const
+{
+    int shard = readerShard();
+    for (;;)
+    {
+        unsigned int parity = m_phase.load() & 1;
+        m_readers[parity][shard].m_count.fetch_add(1);
+        // If the phase flipped before our count was visible, a writer may
+        // already have stopped waiting for this parity; back out and retry.
+        if ((m_phase.load() & 1) == parity)
+            return parity;
+        m_readers[parity][shard].m_count.fetch_sub(1);
+    }
+}
+
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::endRead(unsigned int parity) const
+{
+    m_readers[parity][readerShard()].m_count.fetch_sub(1, std::memory_order_release);
+}
+
+// Wait until every reader that might have seen memory unlinked before this
+// call has finished.  New readers switch to the other parity, so the wait ends.
+template<typename KeyType, typename ValueType>
+void ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::waitForReaders()
+{
+    unsigned int parity = m_phase.fetch_add(1) & 1;
+    for (int i = 0; i < READER_SHARDS; i++)
+    {
+        while (m_readers[parity][i].m_count.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+    }
+}
+
+template<typename KeyType, typename ValueType>
+unsigned int ExpandableHashMap<KeyType,ValueType,ConcurrentReads>::findBucket(const KeyType& k, unsigned int buckets) const
+{
+    unsigned int hasher(const KeyType& k); // prototype
+    return hasher(k) % buckets;
+}
+
+#endif // EXPANDABLEHASHMAP_INCLUDED
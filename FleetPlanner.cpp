@@ -0,0 +1,230 @@
+#include "provided.h"
+#include "GeoDistance.h"
+#include "TourSearch.h"
+#include "FleetSearch.h"
+#include "MapStop.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <limits>
+using namespace std;
+
+namespace
+{
+    const unsigned int NEIGHBORS = 20;     // how many of each point's nearest others FleetSearch tries
+
+    unsigned int threadsFor(const FleetOptions& options)
+    {
+        return options.threads > 0 ? options.threads : max(1u, thread::hardware_concurrency());
+    }
+
+      // Plan the vehicles' routes with search, over the depot and the
+      // deliveries kept (search's point p is the delivery kept[p-1]), then
+      // give each vehicle its deliveries and (in parallel, the vehicles
+      // shared out among threads) its directions, timing its arrivals by the
+      // legs those directions drive.
+    template <typename Search>
+    DeliveryResult planRoutes(Search& search, const StreetMap* sm, const GeoCoord& depot,
+                              const vector<FleetDelivery>& deliveries, const vector<unsigned int>& kept,
+                              const FleetOptions& options, vector<VehiclePlan>& vehicles,
+                              vector<unsigned int>& unassigned)
+    {
+        unsigned int threadCount = threadsFor(options);
+        search.construct();
+        search.improve(threadCount, options.timeBudget);
+
+        for (unsigned int r = 0; r < search.routeCount(); r++)
+        {
+            const vector<unsigned int>& route = search.route(r);
+            for (size_t i = 0; i < route.size(); i++)
+                vehicles[r].deliveries.push_back(kept[route[i] - 1]);
+        }
+        for (size_t k = 0; k < search.unassigned().size(); k++)
+            unassigned.push_back(kept[search.unassigned()[k] - 1]);
+
+        PlannerOptions plannerOptions;
+        plannerOptions.snapRadius = options.snapRadius;
+        plannerOptions.keepOrder = true;
+        plannerOptions.router = options.router;
+        vector<DeliveryResult> results(vehicles.size(), DELIVERY_SUCCESS);
+        atomic<size_t> next(0);
+        auto work = [&]()
+        {
+            DeliveryPlanner planner(sm, plannerOptions);
+            vector<DeliveryRequest> requests;
+            vector<double> legs;
+            for (size_t v = next++; v < vehicles.size(); v = next++)
+            {
+                VehiclePlan& plan = vehicles[v];
+                if (plan.deliveries.empty())
+                    continue;
+                requests.clear();
+                for (size_t i = 0; i < plan.deliveries.size(); i++)
+                    requests.push_back(deliveries[plan.deliveries[i]].request);
+                results[v] = planner.generateDeliveryPlan(depot, requests, plan.commands, plan.distance, legs);
+                if (results[v] != DELIVERY_SUCCESS)
+                    continue;
+                double t = 0;
+                for (size_t i = 0; i < plan.deliveries.size(); i++)
+                {
+                    const FleetDelivery& d = deliveries[plan.deliveries[i]];
+                    t += legs[i] / options.speed;
+                    plan.arrival.push_back(t);
+                    t = max(t, d.earliest) + options.serviceTime;
+                }
+            }
+        };
+        threadCount = min<size_t>(threadCount, max<size_t>(1, search.routeCount()));
+        vector<thread> threads;
+        for (unsigned int t = 1; t < threadCount; t++)
+            threads.push_back(thread(work));
+        work();
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+        for (size_t v = 0; v < results.size(); v++)
+        {
+            if (results[v] != DELIVERY_SUCCESS)
+                return results[v];
+        }
+        return DELIVERY_SUCCESS;
+    }
+}
+
+class FleetPlannerImpl
+{
+public:
+    FleetPlannerImpl(const StreetMap* sm, const FleetOptions& options);
+    ~FleetPlannerImpl();
+    DeliveryResult generateFleetPlan(
+        const GeoCoord& depot,
+        const vector<FleetDelivery>& deliveries,
+        vector<VehiclePlan>& vehicles,
+        vector<unsigned int>& unassigned,
+        double& totalDistanceTravelled) const;
+
+private:
+    const StreetMap* m_stmap;
+    FleetOptions m_options;
+};
+
+FleetPlannerImpl::FleetPlannerImpl(const StreetMap* sm, const FleetOptions& options)
+ : m_stmap(sm), m_options(options)
+{
+}
+
+FleetPlannerImpl::~FleetPlannerImpl()
+{
+}
+
+DeliveryResult FleetPlannerImpl::generateFleetPlan(
+    const GeoCoord& depot,
+    const vector<FleetDelivery>& deliveries,
+    vector<VehiclePlan>& vehicles,
+    vector<unsigned int>& unassigned,
+    double& totalDistanceTravelled) const
+{
+    vehicles.assign(m_options.vehicleCount, VehiclePlan());
+    unassigned.clear();
+    totalDistanceTravelled = 0;
+
+    // The deliveries a route from the depot can reach are kept for the
+    // search, whose point 0 is the depot and point p the delivery
+    // kept[p-1]; the rest no vehicle can make.
+    vector<GeoCoord> points(1, depot);
+    for (size_t i = 0; i < deliveries.size(); i++)
+        points.push_back(deliveries[i].request.location);
+    vector<bool> reachable;
+    if (!reachableFrom(m_stmap, points, m_options.snapRadius, m_options.router, reachable))
+        return BAD_COORD;
+    vector<unsigned int> kept;
+    points.resize(1);
+    vector<FleetStop> stops(1);
+    bool windows = false;
+    for (unsigned int i = 0; i < deliveries.size(); i++)
+    {
+        if (!reachable[i+1])
+        {
+            unassigned.push_back(i);
+            continue;
+        }
+        const FleetDelivery& d = deliveries[i];
+        kept.push_back(i);
+        points.push_back(d.request.location);
+        FleetStop s = { d.load, d.earliest, d.latest };
+        stops.push_back(s);
+        if (d.latest != numeric_limits<double>::infinity())
+            windows = true;
+    }
+    unsigned int n = points.size();
+
+    // A window can only be kept to by timing the routes actually driven.
+    DeliveryResult result;
+    if (m_options.roadDistance  ||  windows)
+    {
+        vector<double> matrix;
+        if (!roadDistanceMatrix(m_stmap, points, m_options.snapRadius, m_options.router, matrix))
+            return NO_ROUTE;
+        RoadDistance road = { matrix.data(), n };
+        NeighborLists neighbors;
+        neighbors.build(n, NEIGHBORS, [&](unsigned int p, double* out)
+        {
+            copy(matrix.begin() + size_t(p) * n, matrix.begin() + size_t(p + 1) * n, out);
+        });
+        FleetSearch<RoadDistance> search(road, neighbors, stops, m_options.vehicleCount, m_options.capacity,
+                                         m_options.speed, m_options.serviceTime);
+        result = planRoutes(search, m_stmap, depot, deliveries, kept, m_options, vehicles, unassigned);
+    }
+    else
+    {
+        vector<double> latitude(n), longitude(n), cosLatitude(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            latitude[i] = points[i].latitude;
+            longitude[i] = points[i].longitude;
+            cosLatitude[i] = cos(deg2rad(points[i].latitude));
+        }
+        CrowDistance crow = { latitude.data(), longitude.data(), cosLatitude.data() };
+        NeighborLists neighbors;
+        neighbors.build(n, NEIGHBORS, [&](unsigned int p, double* out)
+        {
+            distancesMiles(latitude[p], longitude[p], latitude.data(), longitude.data(), cosLatitude.data(), n, out);
+        });
+        FleetSearch<CrowDistance> search(crow, neighbors, stops, m_options.vehicleCount, m_options.capacity,
+                                         m_options.speed, m_options.serviceTime);
+        result = planRoutes(search, m_stmap, depot, deliveries, kept, m_options, vehicles, unassigned);
+    }
+    sort(unassigned.begin(), unassigned.end());
+    if (result != DELIVERY_SUCCESS)
+        return result;
+
+    for (size_t v = 0; v < vehicles.size(); v++)
+        totalDistanceTravelled += vehicles[v].distance;
+    return DELIVERY_SUCCESS;
+}
+
+//******************** FleetPlanner functions *********************************
+
+// These functions simply delegate to FleetPlannerImpl's functions.
+// You probably don't want to change any of this code.
+
+FleetPlanner::FleetPlanner(const StreetMap* sm, const FleetOptions& options)
+{
+    m_impl = new FleetPlannerImpl(sm, options);
+}
+
+FleetPlanner::~FleetPlanner()
+{
+    delete m_impl;
+}
+
+DeliveryResult FleetPlanner::generateFleetPlan(
+    const GeoCoord& depot,
+    const vector<FleetDelivery>& deliveries,
+    vector<VehiclePlan>& vehicles,
+    vector<unsigned int>& unassigned,
+    double& totalDistanceTravelled) const
+{
+    return m_impl->generateFleetPlan(depot, deliveries, vehicles, unassigned, totalDistanceTravelled);
+}
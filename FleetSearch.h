@@ -0,0 +1,602 @@
+// FleetSearch.h
+
+// Routes for a fleet of vehicles leaving a depot (point 0) together to make
+// deliveries (points 1 .. n), under any distance, given as a function object
+// dist(a, b).  Each delivery has a load and a time window; every vehicle has
+// the same capacity and speed.  A vehicle arriving before a window opens
+// waits for it, and must arrive before it closes.
+//
+// The routes start from Clarke and Wright's savings: every delivery begins on
+// a route of its own, and two routes are joined, end of one to start of the
+// other, in order of how much distance that saves, for the pairs of
+// deliveries on each other's neighbor lists, whenever the load and the time
+// windows allow.  Should that leave more routes than vehicles, the shortest
+// routes are broken up and their deliveries put wherever they add least.
+//
+// Then moves between routes shorten them: relocate (move a delivery to
+// another place), exchange (swap two deliveries on different routes) and
+// cross (swap the tails of two routes), each tried only where it would put a
+// delivery next to one on its neighbor list.  Each route keeps, for every
+// delivery on it, the time the vehicle arrives and starts there, the latest
+// it could start there without missing a later window, and the load before
+// it, so a move between routes is checked in constant time.  (A move within
+// one route is checked by timing the whole new route.)  In each pass, the
+// deliveries are shared among threads (started once, for all the passes),
+// each finding the best move for its deliveries while nothing changes; then
+// the moves are made, best first, skipping any whose routes an earlier move
+// in the pass has changed.  A delivery's best move is only looked for again
+// once its route, or a route holding one of its neighbors, has changed.  So
+// the result doesn't depend on the number of threads.
+
+#ifndef FLEETSEARCH_INCLUDED
+#define FLEETSEARCH_INCLUDED
+
+#include "TourSearch.h"
+#include "Barrier.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+struct FleetStop
+{
+    double load;
+    double earliest;    // in hours
+    double latest;
+};
+
+template <typename Distance>
+class FleetSearch
+{
+public:
+      // stops[p] describes point p (stops[0], the depot, isn't used);
+      // neighbors must cover the same points as dist, and outlive the search
+    FleetSearch(Distance dist, const NeighborLists& neighbors, const std::vector<FleetStop>& stops,
+                unsigned int vehicleCount, double capacity, double speed, double serviceTime)
+     : m_dist(dist), m_neighbors(&neighbors), m_stops(stops), m_vehicleCount(vehicleCount),
+       m_capacity(capacity), m_hoursPerMile(1 / speed), m_serviceTime(serviceTime),
+       m_routeOf(stops.size(), unsigned(NONE)), m_position(stops.size(), 0)
+    {}
+
+      // build the first routes, by savings
+    void construct()
+    {
+        unsigned int n = m_stops.size();
+        m_routes.clear();
+        m_unassigned.clear();
+        for (unsigned int p = 1; p < n; p++)
+        {
+            if (!possible(p))
+            {
+                m_unassigned.push_back(p);
+                continue;
+            }
+            m_routes.push_back(Route());
+            m_routes.back().stops.push_back(p);
+            update(m_routes.size() - 1);
+        }
+
+        struct Saving
+        {
+            double saved;
+            unsigned int from, to;
+        };
+        std::vector<Saving> savings;
+        for (unsigned int u = 1; u < n; u++)
+        {
+            if (m_routeOf[u] == NONE)
+                continue;
+            for (const unsigned int* q = m_neighbors->begin(u); q != m_neighbors->end(u); q++)
+            {
+                unsigned int v = *q;
+                if (v == 0  ||  m_routeOf[v] == NONE)
+                    continue;
+                Saving s = { m_dist(u, 0) + m_dist(0, v) - m_dist(u, v), u, v };
+                if (s.saved > EPSILON)
+                    savings.push_back(s);
+            }
+        }
+        std::sort(savings.begin(), savings.end(), [](const Saving& a, const Saving& b)
+        {
+            if (a.saved != b.saved)
+                return a.saved > b.saved;
+            return a.from != b.from ? a.from < b.from : a.to < b.to;
+        });
+        for (size_t k = 0; k < savings.size(); k++)
+        {
+            unsigned int u = savings[k].from, v = savings[k].to;
+            unsigned int a = m_routeOf[u], b = m_routeOf[v];
+            Route& ra = m_routes[a];
+            Route& rb = m_routes[b];
+            if (a == b  ||  m_position[u] + 1 != ra.stops.size()  ||  m_position[v] != 0  ||
+                ra.load + rb.load > m_capacity  ||  !fits(b, 0, leave(a, m_position[u]) + travel(u, v)))
+                continue;
+            ra.stops.insert(ra.stops.end(), rb.stops.begin(), rb.stops.end());
+            rb.stops.clear();
+            update(a);
+            update(b);
+        }
+        dropEmptyRoutes();
+
+        // too many routes: break up the shortest
+        while (m_routes.size() > m_vehicleCount)
+        {
+            unsigned int shortest = 0;
+            for (unsigned int r = 1; r < m_routes.size(); r++)
+            {
+                if (m_routes[r].stops.size() < m_routes[shortest].stops.size())
+                    shortest = r;
+            }
+            std::vector<unsigned int> homeless;
+            homeless.swap(m_routes[shortest].stops);
+            for (size_t k = 0; k < homeless.size(); k++)
+                m_routeOf[homeless[k]] = NONE;
+            update(shortest);
+            dropEmptyRoutes();
+            for (size_t k = 0; k < homeless.size(); k++)
+            {
+                if (!insertCheapest(homeless[k], false))
+                    m_unassigned.push_back(homeless[k]);
+            }
+        }
+    }
+
+      // Improve the routes until no move helps or timeBudget seconds (if
+      // positive) have passed, then find places for as many unassigned
+      // deliveries as possible.
+    void improve(unsigned int threadCount, double timeBudget)
+    {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                         std::chrono::duration<double>(timeBudget));
+        unsigned int n = m_stops.size();
+        std::vector<Move> best(n);
+        std::vector<bool> stale(n, true);
+        std::vector<bool> changed;
+        std::vector<unsigned int> look;
+        std::vector<Move> moves;
+
+        // the helpers are started once, and meet this thread at the barrier
+        // before and after each pass's search
+        std::atomic<size_t> next(0);
+        auto work = [&]()
+        {
+            for (size_t k = next++; k < look.size(); k = next++)
+                best[look[k]] = bestMove(look[k]);
+        };
+        unsigned int threads = std::min<size_t>(std::max(1u, threadCount), (n + 63) / 64);
+        Barrier barrier(threads);
+        bool done = false;
+        std::vector<std::thread> helpers;
+        for (unsigned int t = 1; t < threads; t++)
+        {
+            helpers.push_back(std::thread([&]
+            {
+                for (;;)
+                {
+                    barrier.wait();     // for the pass to start
+                    if (done)
+                        return;
+                    work();
+                    barrier.wait();     // for every thread to finish it
+                }
+            }));
+        }
+
+        while (timeBudget <= 0  ||  Clock::now() < deadline)
+        {
+            look.clear();
+            for (unsigned int u = 1; u < n; u++)
+            {
+                if (stale[u]  &&  m_routeOf[u] != NONE)
+                    look.push_back(u);
+            }
+            next = 0;
+            barrier.wait();
+            work();
+            barrier.wait();
+            for (size_t k = 0; k < look.size(); k++)
+                stale[look[k]] = false;
+
+            moves.clear();
+            for (unsigned int u = 1; u < n; u++)
+            {
+                if (m_routeOf[u] != NONE  &&  best[u].gain > EPSILON)
+                    moves.push_back(best[u]);
+            }
+            if (moves.empty())
+                break;
+            std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b)
+            {
+                return a.gain != b.gain ? a.gain > b.gain : a.u < b.u;
+            });
+            changed.assign(m_routes.size(), false);
+            for (size_t k = 0; k < moves.size(); k++)
+            {
+                unsigned int a = m_routeOf[moves[k].u], b = m_routeOf[moves[k].v];
+                if (changed[a]  ||  changed[b])
+                    continue;
+                apply(moves[k]);
+                changed[a] = changed[b] = true;
+            }
+            for (unsigned int u = 1; u < n; u++)
+            {
+                if (m_routeOf[u] == NONE  ||  stale[u])
+                    continue;
+                if (changed[m_routeOf[u]])
+                    stale[u] = true;
+                for (const unsigned int* q = m_neighbors->begin(u); q != m_neighbors->end(u)  &&  !stale[u]; q++)
+                {
+                    if (*q != 0  &&  m_routeOf[*q] != NONE  &&  changed[m_routeOf[*q]])
+                        stale[u] = true;
+                }
+            }
+        }
+        done = true;
+        barrier.wait();
+        for (size_t t = 0; t < helpers.size(); t++)
+            helpers[t].join();
+
+        std::vector<unsigned int> homeless;
+        homeless.swap(m_unassigned);
+        for (size_t k = 0; k < homeless.size(); k++)
+        {
+            if (!insertCheapest(homeless[k], true))
+                m_unassigned.push_back(homeless[k]);
+        }
+        dropEmptyRoutes();
+    }
+
+    unsigned int routeCount() const { return m_routes.size(); }
+    const std::vector<unsigned int>& route(unsigned int r) const { return m_routes[r].stops; }
+    const std::vector<unsigned int>& unassigned() const { return m_unassigned; }
+
+    double length() const
+    {
+        double total = 0;
+        for (size_t r = 0; r < m_routes.size(); r++)
+            total += m_routes[r].length;
+        return total;
+    }
+
+private:
+    static const unsigned int NONE = 0xffffffff;
+    static constexpr double EPSILON = 1e-9;     // smaller gains are rounding, and could cycle
+
+    enum MoveType
+    {
+        RELOCATE_AFTER, RELOCATE_BEFORE,    // u goes just after or before v
+        EXCHANGE,                           // u and v swap places
+        CROSS_AFTER,                        // u's route goes on with v and the rest of v's route
+        CROSS_BEFORE                        // v's route goes on with u and the rest of u's route
+    };
+
+    struct Move
+    {
+        Move() : type(RELOCATE_AFTER), u(0), v(0), gain(0) {}
+        MoveType type;
+        unsigned int u, v;
+        double gain;
+    };
+
+    struct Route
+    {
+        std::vector<unsigned int> stops;
+        std::vector<double> arrive;         // when the vehicle gets to each stop
+        std::vector<double> start;          // when it starts the delivery there, after any wait
+        std::vector<double> latest;         // the latest it could start there and still make the rest in time
+        std::vector<double> loadBefore;     // of the stops before each
+        double load;
+        double length;
+    };
+
+    Distance m_dist;
+    const NeighborLists* m_neighbors;
+    std::vector<FleetStop> m_stops;
+    unsigned int m_vehicleCount;
+    double m_capacity;
+    double m_hoursPerMile;
+    double m_serviceTime;
+    std::vector<Route> m_routes;
+    std::vector<unsigned int> m_routeOf;    // each delivery's route, or NONE
+    std::vector<unsigned int> m_position;   // and its place in that route
+    std::vector<unsigned int> m_unassigned;
+
+    double travel(unsigned int a, unsigned int b) const { return m_dist(a, b) * m_hoursPerMile; }
+
+      // the point at position i of route r; the depot before the first and
+      // after the last
+    unsigned int at(unsigned int r, int i) const
+    {
+        const std::vector<unsigned int>& s = m_routes[r].stops;
+        return (i < 0  ||  i >= int(s.size())) ? 0 : s[i];
+    }
+
+      // whether a vehicle could make delivery p at all: alone, straight from
+      // the depot
+    bool possible(unsigned int p) const
+    {
+        const FleetStop& s = m_stops[p];
+        return s.load <= m_capacity  &&  s.earliest <= s.latest  &&  travel(0, p) <= s.latest;
+    }
+
+      // when the vehicle leaves position i of route r (or the depot, for -1)
+    double leave(unsigned int r, int i) const
+    {
+        return i < 0 ? 0 : m_routes[r].start[i] + m_serviceTime;
+    }
+
+      // whether route r can go on from position i (or back to the depot,
+      // past the end) if the vehicle gets there at time t
+    bool fits(unsigned int r, int i, double t) const
+    {
+        return i >= int(m_routes[r].stops.size())  ||  t <= m_routes[r].latest[i];
+    }
+
+      // whether the vehicle can make delivery p if it gets there at time t,
+      // then go on with route r from position i
+    bool visits(unsigned int p, double t, unsigned int r, int i) const
+    {
+        if (!(t <= m_stops[p].latest))
+            return false;
+        double done = std::max(t, m_stops[p].earliest) + m_serviceTime;
+        return fits(r, i, done + travel(p, at(r, i)));
+    }
+
+      // the times, loads and length of route r, and where its stops are
+    void update(unsigned int r)
+    {
+        Route& route = m_routes[r];
+        unsigned int count = route.stops.size();
+        route.arrive.resize(count);
+        route.start.resize(count);
+        route.latest.resize(count);
+        route.loadBefore.resize(count);
+        double t = 0, load = 0, length = 0;
+        unsigned int prev = 0;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            unsigned int p = route.stops[i];
+            m_routeOf[p] = r;
+            m_position[p] = i;
+            length += m_dist(prev, p);
+            route.arrive[i] = t + travel(prev, p);
+            route.start[i] = std::max(route.arrive[i], m_stops[p].earliest);
+            route.loadBefore[i] = load;
+            load += m_stops[p].load;
+            t = route.start[i] + m_serviceTime;
+            prev = p;
+        }
+        route.length = length + m_dist(prev, 0);
+        route.load = load;
+        for (unsigned int i = count; i-- > 0; )
+        {
+            unsigned int p = route.stops[i];
+            route.latest[i] = m_stops[p].latest;
+            if (i + 1 < count)
+                route.latest[i] = std::min(route.latest[i], route.latest[i+1] - m_serviceTime - travel(p, route.stops[i+1]));
+        }
+    }
+
+    void dropEmptyRoutes()
+    {
+        unsigned int kept = 0;
+        for (unsigned int r = 0; r < m_routes.size(); r++)
+        {
+            if (m_routes[r].stops.empty())
+                continue;
+            if (kept != r)
+                std::swap(m_routes[kept], m_routes[r]);
+            kept++;
+        }
+        m_routes.resize(kept);
+        for (unsigned int r = 0; r < kept; r++)
+        {
+            for (size_t i = 0; i < m_routes[r].stops.size(); i++)
+                m_routeOf[m_routes[r].stops[i]] = r;
+        }
+    }
+
+      // Put delivery p where it adds least distance, in time and within the
+      // capacity; if newRoute, a vehicle with no route yet may take it alone.
+      // Returns false if there's no such place.
+    bool insertCheapest(unsigned int p, bool newRoute)
+    {
+        double bestAdded = std::numeric_limits<double>::infinity();
+        unsigned int bestRoute = NONE;
+        int bestAfter = 0;
+        for (unsigned int r = 0; r < m_routes.size(); r++)
+        {
+            if (m_routes[r].load + m_stops[p].load > m_capacity)
+                continue;
+            for (int i = -1; i < int(m_routes[r].stops.size()); i++)
+            {
+                unsigned int a = at(r, i), b = at(r, i + 1);
+                double added = m_dist(a, p) + m_dist(p, b) - m_dist(a, b);
+                if (added < bestAdded  &&  visits(p, leave(r, i) + travel(a, p), r, i + 1))
+                {
+                    bestAdded = added;
+                    bestRoute = r;
+                    bestAfter = i;
+                }
+            }
+        }
+        if (bestRoute == NONE)
+        {
+            if (!newRoute  ||  m_routes.size() >= m_vehicleCount  ||  !possible(p))
+                return false;
+            m_routes.push_back(Route());
+            m_routes.back().stops.push_back(p);
+            update(m_routes.size() - 1);
+            return true;
+        }
+        std::vector<unsigned int>& s = m_routes[bestRoute].stops;
+        s.insert(s.begin() + bestAfter + 1, p);
+        update(bestRoute);
+        return true;
+    }
+
+      // whether a route through these stops, in this order, is in time
+    bool inTime(const std::vector<unsigned int>& stops) const
+    {
+        double t = 0;
+        unsigned int prev = 0;
+        for (size_t i = 0; i < stops.size(); i++)
+        {
+            unsigned int p = stops[i];
+            t += travel(prev, p);
+            if (!(t <= m_stops[p].latest))
+                return false;
+            t = std::max(t, m_stops[p].earliest) + m_serviceTime;
+            prev = p;
+        }
+        return true;
+    }
+
+      // the most improving move putting u next to one of its neighbors; its
+      // gain is 0 if there's none
+    Move bestMove(unsigned int u) const
+    {
+        Move best;
+        unsigned int a = m_routeOf[u];
+        int i = m_position[u];
+        const Route& ra = m_routes[a];
+        unsigned int pa = at(a, i - 1), na = at(a, i + 1);
+        double removed = m_dist(pa, u) + m_dist(u, na) - m_dist(pa, na);
+        bool canLeave = fits(a, i + 1, leave(a, i - 1) + travel(pa, na));
+        auto consider = [&](MoveType type, unsigned int v, double gain)
+        {
+            if (gain > best.gain)
+            {
+                best.type = type;
+                best.u = u;
+                best.v = v;
+                best.gain = gain;
+            }
+        };
+        static thread_local std::vector<unsigned int> trial;
+
+        for (const unsigned int* q = m_neighbors->begin(u); q != m_neighbors->end(u); q++)
+        {
+            unsigned int v = *q;
+            if (v == 0  ||  m_routeOf[v] == NONE)
+                continue;
+            unsigned int b = m_routeOf[v];
+            int j = m_position[v];
+            const Route& rb = m_routes[b];
+
+            // relocate u just after v (between j and j+1) or just before it
+            // (between j-1 and j)
+            for (int after = 1; after >= 0; after--)
+            {
+                int k = after ? j : j - 1;     // u goes between positions k and k+1 of b
+                unsigned int x = at(b, k), y = at(b, k + 1);
+                if (x == u  ||  y == u)
+                    continue;
+                double gain = removed - (m_dist(x, u) + m_dist(u, y) - m_dist(x, y));
+                if (gain <= best.gain)
+                    continue;
+                if (a != b)
+                {
+                    if (canLeave  &&  rb.load + m_stops[u].load <= m_capacity  &&
+                        visits(u, leave(b, k) + travel(x, u), b, k + 1))
+                        consider(after ? RELOCATE_AFTER : RELOCATE_BEFORE, v, gain);
+                }
+                else
+                {
+                    trial = ra.stops;
+                    trial.erase(trial.begin() + i);
+                    int to = (after ? j : j - 1) + 1 - (i < j ? 1 : 0);
+                    trial.insert(trial.begin() + to, u);
+                    if (inTime(trial))
+                        consider(after ? RELOCATE_AFTER : RELOCATE_BEFORE, v, gain);
+                }
+            }
+            if (a == b)
+                continue;
+
+            // exchange u with the stop just before or after v
+            for (int side = -1; side <= 1; side += 2)
+            {
+                int k = j + side;
+                unsigned int w = at(b, k);
+                if (w == 0)
+                    continue;
+                unsigned int pb = at(b, k - 1), nb = at(b, k + 1);
+                double gain = m_dist(pa, u) + m_dist(u, na) + m_dist(pb, w) + m_dist(w, nb)
+                            - m_dist(pa, w) - m_dist(w, na) - m_dist(pb, u) - m_dist(u, nb);
+                if (gain <= best.gain)
+                    continue;
+                if (ra.load - m_stops[u].load + m_stops[w].load <= m_capacity  &&
+                    rb.load - m_stops[w].load + m_stops[u].load <= m_capacity  &&
+                    visits(w, leave(a, i - 1) + travel(pa, w), a, i + 1)  &&
+                    visits(u, leave(b, k - 1) + travel(pb, u), b, k + 1))
+                    consider(EXCHANGE, w, gain);
+            }
+
+            // cross: u then v and v's tail, with v's head then u's tail
+            {
+                unsigned int pv = at(b, j - 1);
+                double gain = m_dist(u, na) + m_dist(pv, v) - m_dist(u, v) - m_dist(pv, na);
+                double aLoad = ra.loadBefore[i] + m_stops[u].load + rb.load - rb.loadBefore[j];
+                double bLoad = rb.loadBefore[j] + ra.load - ra.loadBefore[i] - m_stops[u].load;
+                if (gain > best.gain  &&  aLoad <= m_capacity  &&  bLoad <= m_capacity  &&
+                    fits(b, j, leave(a, i) + travel(u, v))  &&  fits(a, i + 1, leave(b, j - 1) + travel(pv, na)))
+                    consider(CROSS_AFTER, v, gain);
+            }
+            // cross: v then u and u's tail, with u's head then v's tail
+            {
+                unsigned int nv = at(b, j + 1);
+                double gain = m_dist(v, nv) + m_dist(pa, u) - m_dist(v, u) - m_dist(pa, nv);
+                double bLoad = rb.loadBefore[j] + m_stops[v].load + ra.load - ra.loadBefore[i];
+                double aLoad = ra.loadBefore[i] + rb.load - rb.loadBefore[j] - m_stops[v].load;
+                if (gain > best.gain  &&  aLoad <= m_capacity  &&  bLoad <= m_capacity  &&
+                    fits(a, i, leave(b, j) + travel(v, u))  &&  fits(b, j + 1, leave(a, i - 1) + travel(pa, nv)))
+                    consider(CROSS_BEFORE, v, gain);
+            }
+        }
+        return best;
+    }
+
+    void apply(const Move& m)
+    {
+        unsigned int a = m_routeOf[m.u], b = m_routeOf[m.v];
+        std::vector<unsigned int>& sa = m_routes[a].stops;
+        std::vector<unsigned int>& sb = m_routes[b].stops;
+        unsigned int i = m_position[m.u], j = m_position[m.v];
+        switch (m.type)
+        {
+          case RELOCATE_AFTER:
+          case RELOCATE_BEFORE:
+            sa.erase(sa.begin() + i);
+            if (a == b  &&  i < j)
+                j--;
+            sb.insert(sb.begin() + j + (m.type == RELOCATE_AFTER ? 1 : 0), m.u);
+            break;
+          case EXCHANGE:
+            std::swap(sa[i], sb[j]);
+            break;
+          case CROSS_AFTER:
+          case CROSS_BEFORE:
+          {
+            // a keeps its stops up to u (CROSS_AFTER) or before u, and b its
+            // stops before v or up to v; then they swap the rest
+            unsigned int cutA = (m.type == CROSS_AFTER ? i + 1 : i);
+            unsigned int cutB = (m.type == CROSS_AFTER ? j : j + 1);
+            std::vector<unsigned int> tailA(sa.begin() + cutA, sa.end());
+            sa.resize(cutA);
+            sa.insert(sa.end(), sb.begin() + cutB, sb.end());
+            sb.resize(cutB);
+            sb.insert(sb.end(), tailA.begin(), tailA.end());
+            break;
+          }
+        }
+        update(a);
+        if (b != a)
+            update(b);
+    }
+};
+
+#endif // FLEETSEARCH_INCLUDED
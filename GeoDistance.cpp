@@ -0,0 +1,223 @@
+#include "provided.h"
+#include "GeoDistance.h"
+#include <cmath>
+#include <atomic>
+using namespace std;
+
+#if defined(__GNUC__)  &&  (defined(__x86_64__)  ||  defined(__i386__))
+#define GEODISTANCE_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const double PI = 3.14159265358979323846;
+    const double EARTH_RADIUS_MILES = 6371.0 / 1.609344;    // as distanceEarthMiles has it
+
+    // Taylor series, sin x = x (1 - x^2/3! + x^4/5! - ...): for |x| <= pi/2
+    // the first term left out, x^23/23!, is under 1e-18.  (Stopping two
+    // terms sooner costs nothing in a city but a thousand times the error
+    // across an ocean, where asin magnifies it.)
+    const int SIN_TERMS = 11;
+    const double SIN_SERIES[SIN_TERMS] =
+    {
+        1, -1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800,
+        1.0 / 6227020800.0, -1.0 / 1307674368000.0, 1.0 / 355687428096000.0,
+        -1.0 / 121645100408832000.0, 1.0 / 51090942171709440000.0
+    };
+
+    // asin x = x (1 + x^2/6 + 3x^4/40 + ...), the coefficient of x^(2k+1)
+    // being (2k)! / (4^k (k!)^2 (2k+1)): for x <= 1/2 the terms left out
+    // add up to less than 1e-16.
+    const int ASIN_TERMS = 23;
+    const double ASIN_SERIES[ASIN_TERMS] =
+    {
+        1, 0.16666666666666666, 0.074999999999999997, 0.044642857142857144,
+        0.030381944444444444, 0.022372159090909092, 0.017352764423076924, 0.013964843750000001,
+        0.011551800896139705, 0.0097616095291940784, 0.0083903358096168151, 0.0073125258735988454,
+        0.0064472103118896487, 0.0057400376708419236, 0.0051533096823199046, 0.0046601434869150962,
+        0.0042409070936793632, 0.0038809645588376691, 0.0035692053938259347, 0.0032970595034734849,
+        0.0030578216492580306, 0.0028461784011089421, 0.0026578706382072901
+    };
+}
+
+// One copy of the kernel for each instruction set.  The scalar one also
+// finishes the points left over after the others' last whole group.
+
+namespace ScalarKernel
+{
+    typedef double vec;
+    const size_t LANES = 1;
+
+    inline vec broadcast(double x) { return x; }
+    inline vec load(const double* p) { return *p; }
+    inline void store(double* p, vec v) { *p = v; }
+    inline vec add(vec a, vec b) { return a + b; }
+    inline vec sub(vec a, vec b) { return a - b; }
+    inline vec mul(vec a, vec b) { return a * b; }
+    inline vec muladd(vec a, vec b, vec c) { return a * b + c; }
+    inline vec sqrtv(vec v) { return std::sqrt(v); }
+    inline vec minv(vec a, vec b) { return b < a ? b : a; }
+    inline vec roundv(vec v) { return std::floor(v + 0.5); }
+    inline vec ifGreater(vec a, vec b, vec x, vec y) { return a > b ? x : y; }
+
+#include "GeoDistanceKernel.h"
+}
+
+#ifdef GEODISTANCE_X86
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+namespace Sse2Kernel
+{
+    typedef __m128d vec;
+    const size_t LANES = 2;
+
+    inline vec broadcast(double x) { return _mm_set1_pd(x); }
+    inline vec load(const double* p) { return _mm_loadu_pd(p); }
+    inline void store(double* p, vec v) { _mm_storeu_pd(p, v); }
+    inline vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+    inline vec sub(vec a, vec b) { return _mm_sub_pd(a, b); }
+    inline vec mul(vec a, vec b) { return _mm_mul_pd(a, b); }
+    inline vec muladd(vec a, vec b, vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    inline vec sqrtv(vec v) { return _mm_sqrt_pd(v); }
+    inline vec minv(vec a, vec b) { return _mm_min_pd(a, b); }
+    inline vec roundv(vec v)
+    {
+        // SSE2 has no rounding instruction, but adding and taking away
+        // 1.5 * 2^52 leaves no bits below the units place (for |v| < 2^51)
+        vec magic = _mm_set1_pd(6755399441055744.0);
+        return _mm_sub_pd(_mm_add_pd(v, magic), magic);
+    }
+    inline vec ifGreater(vec a, vec b, vec x, vec y)
+    {
+        vec mask = _mm_cmpgt_pd(a, b);
+        return _mm_or_pd(_mm_and_pd(mask, x), _mm_andnot_pd(mask, y));
+    }
+
+#include "GeoDistanceKernel.h"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+namespace Avx2Kernel
+{
+    typedef __m256d vec;
+    const size_t LANES = 4;
+
+    inline vec broadcast(double x) { return _mm256_set1_pd(x); }
+    inline vec load(const double* p) { return _mm256_loadu_pd(p); }
+    inline void store(double* p, vec v) { _mm256_storeu_pd(p, v); }
+    inline vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+    inline vec sub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+    inline vec mul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+    inline vec muladd(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+    inline vec sqrtv(vec v) { return _mm256_sqrt_pd(v); }
+    inline vec minv(vec a, vec b) { return _mm256_min_pd(a, b); }
+    inline vec roundv(vec v) { return _mm256_round_pd(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    inline vec ifGreater(vec a, vec b, vec x, vec y) { return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_GT_OQ)); }
+
+#include "GeoDistanceKernel.h"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace Avx512Kernel
+{
+    typedef __m512d vec;
+    const size_t LANES = 8;
+
+    // (sqrtv, minv and roundv use the masked forms, with every lane
+    // selected, since the plain ones trip a spurious uninitialized-variable
+    // warning in some GCCs' headers)
+
+    inline vec broadcast(double x) { return _mm512_set1_pd(x); }
+    inline vec load(const double* p) { return _mm512_loadu_pd(p); }
+    inline void store(double* p, vec v) { _mm512_storeu_pd(p, v); }
+    inline vec add(vec a, vec b) { return _mm512_add_pd(a, b); }
+    inline vec sub(vec a, vec b) { return _mm512_sub_pd(a, b); }
+    inline vec mul(vec a, vec b) { return _mm512_mul_pd(a, b); }
+    inline vec muladd(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+    inline vec sqrtv(vec v) { return _mm512_mask_sqrt_pd(v, 0xff, v); }
+    inline vec minv(vec a, vec b) { return _mm512_mask_min_pd(a, 0xff, a, b); }
+    inline vec roundv(vec v) { return _mm512_mask_roundscale_pd(v, 0xff, v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    inline vec ifGreater(vec a, vec b, vec x, vec y) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_GT_OQ), y, x); }
+
+#include "GeoDistanceKernel.h"
+}
+#pragma GCC pop_options
+
+#endif // GEODISTANCE_X86
+
+namespace
+{
+    bool supported(GeoDistanceKernel kernel)
+    {
+#ifdef GEODISTANCE_X86
+        switch (kernel)
+        {
+          case SCALAR_KERNEL:  return true;
+          case SSE2_KERNEL:    return __builtin_cpu_supports("sse2");
+          case AVX2_KERNEL:    return __builtin_cpu_supports("avx2")  &&  __builtin_cpu_supports("fma");
+          case AVX512_KERNEL:  return __builtin_cpu_supports("avx512f");
+        }
+        return false;
+#else
+        return kernel == SCALAR_KERNEL;
+#endif
+    }
+
+    atomic<int> currentKernel(-1);     // not chosen yet
+}
+
+GeoDistanceKernel geoDistanceKernel()
+{
+    int k = currentKernel.load(memory_order_relaxed);
+    if (k < 0)
+    {
+        k = AVX512_KERNEL;
+        while (!supported(GeoDistanceKernel(k)))
+            k--;
+        currentKernel.store(k, memory_order_relaxed);
+    }
+    return GeoDistanceKernel(k);
+}
+
+bool setGeoDistanceKernel(GeoDistanceKernel kernel)
+{
+    if (!supported(kernel))
+        return false;
+    currentKernel.store(kernel, memory_order_relaxed);
+    return true;
+}
+
+void distancesMiles(double originLat, double originLon,
+                    const double* latitude, const double* longitude, const double* cosLatitude,
+                    size_t count, double* out, GeoDistanceMode mode)
+{
+    double originCosLat = cos(deg2rad(originLat));
+    size_t done = 0;
+    switch (geoDistanceKernel())
+    {
+#ifdef GEODISTANCE_X86
+      case AVX512_KERNEL:
+        done = Avx512Kernel::distances(originLat, originLon, originCosLat, latitude, longitude, cosLatitude,
+                                       count, out, mode);
+        break;
+      case AVX2_KERNEL:
+        done = Avx2Kernel::distances(originLat, originLon, originCosLat, latitude, longitude, cosLatitude,
+                                     count, out, mode);
+        break;
+      case SSE2_KERNEL:
+        done = Sse2Kernel::distances(originLat, originLon, originCosLat, latitude, longitude, cosLatitude,
+                                     count, out, mode);
+        break;
+#endif
+      default:
+        break;
+    }
+    ScalarKernel::distances(originLat, originLon, originCosLat, latitude + done, longitude + done,
+                            cosLatitude + done, count - done, out + done, mode);
+}
@@ -0,0 +1,63 @@
+// GeoDistance.h
+
+// Straight-line distances over the Earth, many at a time.  distancesMiles
+// measures from one point to each of an array of points, computing two, four
+// or eight at once with whichever of SSE2, AVX2 (with FMA) or AVX-512 the
+// processor has, and with polynomials standing in for sin and asin.  Every
+// point's cosine of latitude is passed in precomputed; StreetGraph keeps one
+// for each node.
+//
+// In GREAT_CIRCLE mode the result is the haversine distance, as
+// distanceEarthMiles computes it, with the truncated series adding a relative
+// error of at most 1e-14 for points up to 10,000 miles apart.  (Nearer
+// antipodes the formula itself loses digits, and this tracks
+// distanceEarthMiles to within 1e-12.)  Between points a few meters apart it
+// is in fact nearer the exact distance than distanceEarthMiles, which turns
+// both latitudes to radians before subtracting them.  EQUIRECTANGULAR mode
+// treats the Earth as flat near each pair, which costs no trigonometry at
+// all; across a city it is within a part in ten million of the great circle,
+// but it isn't a lower bound on it, so it mustn't be an A* heuristic.
+
+#ifndef GEODISTANCE_INCLUDED
+#define GEODISTANCE_INCLUDED
+
+#include "provided.h"
+#include <cstddef>
+
+enum GeoDistanceMode
+{
+    GREAT_CIRCLE, EQUIRECTANGULAR
+};
+
+  // out[i] = the distance in miles from (originLat, originLon) to
+  // (latitude[i], longitude[i]), for i in [0, count); cosLatitude[i] must be
+  // cos(deg2rad(latitude[i])).  out may not overlap the inputs.
+void distancesMiles(double originLat, double originLon,
+                    const double* latitude, const double* longitude, const double* cosLatitude,
+                    size_t count, double* out, GeoDistanceMode mode = GREAT_CIRCLE);
+
+  // One distance, exactly as distanceEarthMiles computes it (to the last
+  // bit) but with the cosines of the latitudes given rather than computed.
+inline double distanceMiles(double lat1d, double lon1d, double cosLat1,
+                            double lat2d, double lon2d, double cosLat2)
+{
+    static const double earthRadiusKm = 6371.0;
+    const double milesPerKm = 1 / 1.609344;
+    double u = std::sin((deg2rad(lat2d) - deg2rad(lat1d)) / 2);
+    double v = std::sin((deg2rad(lon2d) - deg2rad(lon1d)) / 2);
+    return 2.0 * earthRadiusKm * std::asin(std::sqrt(u * u + cosLat1 * cosLat2 * v * v)) * milesPerKm;
+}
+
+  // Which code distancesMiles runs.  It picks the widest the processor
+  // supports the first time it's called; tests and benchmarks may choose
+  // another, and setGeoDistanceKernel returns false if the processor (or the
+  // compiler) can't run the one asked for.
+enum GeoDistanceKernel
+{
+    SCALAR_KERNEL, SSE2_KERNEL, AVX2_KERNEL, AVX512_KERNEL
+};
+
+GeoDistanceKernel geoDistanceKernel();
+bool setGeoDistanceKernel(GeoDistanceKernel kernel);
+
+#endif // GEODISTANCE_INCLUDED
@@ -0,0 +1,79 @@
+// GeoDistanceKernel.h
+
+// The loop behind distancesMiles, written once against a few operations on
+// vec, a group of LANES doubles.  GeoDistance.cpp includes this file once for
+// each instruction set, inside a namespace that defines vec and these
+// operations for it:
+//
+//   broadcast(x)            every lane x
+//   load(p), store(p, v)    LANES doubles at p, which needn't be aligned
+//   add, sub, mul           lane by lane
+//   muladd(a, b, c)         a * b + c
+//   sqrtv(v), minv(a, b), roundv(v)   the last to the nearest integer
+//   ifGreater(a, b, x, y)   x in the lanes where a > b, y in the others
+//
+// so unlike the other headers it has no include guard.
+
+  // c[0] + c[1] y + ... + c[n-1] y^(n-1).  Horner's rule makes every step
+  // wait on the one before, so the terms are split four ways by k mod 4 and
+  // each share summed by Horner's rule in y^4; the four sums don't wait on
+  // each other.
+inline vec polynomial(vec y, const double* c, int n)
+{
+    vec sum[4] = { broadcast(0), broadcast(0), broadcast(0), broadcast(0) };
+    vec y2 = mul(y, y), y4 = mul(y2, y2);
+#pragma GCC unroll 32
+    for (int k = n - 1; k >= 0; k--)
+        sum[k % 4] = muladd(sum[k % 4], y4, broadcast(c[k]));
+    return muladd(muladd(sum[3], y, sum[2]), y2, muladd(sum[1], y, sum[0]));
+}
+
+  // sin x for |x| <= pi/2
+inline vec sinQuarterTurn(vec x)
+{
+    return mul(polynomial(mul(x, x), SIN_SERIES, SIN_TERMS), x);
+}
+
+  // asin s for 0 <= s <= 1: the series itself up to 1/2, and above that
+  // pi/2 - 2 asin sqrt((1 - s) / 2), whose argument is at most 1/2
+inline vec asinUnit(vec s)
+{
+    vec half = broadcast(0.5);
+    vec t = ifGreater(s, half, sqrtv(mul(sub(broadcast(1), s), half)), s);
+    vec p = mul(polynomial(mul(t, t), ASIN_SERIES, ASIN_TERMS), t);
+    return ifGreater(s, half, sub(broadcast(PI / 2), add(p, p)), p);
+}
+
+  // Distances from the origin to points [0, count) for as many whole groups
+  // of LANES as there are; returns how many points that covered.
+inline size_t distances(double originLat, double originLon, double originCosLat,
+                        const double* latitude, const double* longitude, const double* cosLatitude,
+                        size_t count, double* out, GeoDistanceMode mode)
+{
+    vec lat0 = broadcast(originLat), lon0 = broadcast(originLon), cos0 = broadcast(originCosLat);
+    vec radiansPerDegree = broadcast(PI / 180);
+    vec half = broadcast(0.5);
+    size_t whole = count - count % LANES;
+    for (size_t i = 0; i < whole; i += LANES)
+    {
+        vec dlat = mul(sub(load(latitude + i), lat0), radiansPerDegree);
+        vec dlon = mul(sub(load(longitude + i), lon0), radiansPerDegree);
+        dlon = sub(dlon, mul(roundv(mul(dlon, broadcast(1 / (2 * PI)))), broadcast(2 * PI)));  // into [-pi, pi]
+        vec cosLat = load(cosLatitude + i);
+        if (mode == EQUIRECTANGULAR)
+        {
+            // east-west distances shrink by the cosine of the latitude,
+            // taken as the mean of the two ends' cosines
+            vec x = mul(mul(add(cos0, cosLat), half), dlon);
+            store(out + i, mul(sqrtv(muladd(x, x, mul(dlat, dlat))), broadcast(EARTH_RADIUS_MILES)));
+        }
+        else
+        {
+            vec u = sinQuarterTurn(mul(dlat, half));
+            vec v = sinQuarterTurn(mul(dlon, half));
+            vec a = minv(muladd(mul(cos0, cosLat), mul(v, v), mul(u, u)), broadcast(1));
+            store(out + i, mul(asinUnit(sqrtv(a)), broadcast(2 * EARTH_RADIUS_MILES)));
+        }
+    }
+    return whole;
+}
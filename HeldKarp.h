@@ -0,0 +1,191 @@
+// HeldKarp.h
+
+// The shortest closed tour through points 0 .. n-1, found exactly by Held
+// and Karp's dynamic program.  With point 0 as the start, C(S, j) is the
+// length of the shortest path from 0 through every point of the set S,
+// ending at j in S; it is the least, over i in S other than j, of
+// C(S - {j}, i) + dist(i, j), so the sets are worked through in order of
+// size, and the sets of one size depend only on those one smaller.  Each
+// size's sets are enumerated in order (Gosper's hack), handed out to threads
+// in chunks, and a chunk's start found by unranking its index.  That is
+// O(n^2 2^n) time and n 2^n table entries: fine for a couple of dozen
+// points at most, and instantaneous below a dozen.
+//
+// The table is floats, half the memory and cache of doubles, with each
+// set's row of entries side by side (infinity for the points not in the
+// set), and a row is read by walking the set's bits.  Float sums can
+// misjudge which of two tours is shorter when they differ by less than
+// about a millionth of their length, so the tour found is optimal to within
+// that; the caller measures it again in full precision.
+
+#ifndef HELDKARP_INCLUDED
+#define HELDKARP_INCLUDED
+
+#include <vector>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+class HeldKarp
+{
+public:
+      // the most points solve() will take: 2^(MAX_POINTS-1) sets of
+      // MAX_POINTS - 1 floats is 80MB
+    static const unsigned int MAX_POINTS = 21;
+
+      // The shortest tour through the n points (at most MAX_POINTS), as read
+      // from point 0, into order.  dist(a, b) is the distance from a to b;
+      // it needn't be symmetric.  The work is shared among threadCount
+      // threads.
+    template <typename Distance>
+    void solve(Distance dist, unsigned int n, unsigned int threadCount, std::vector<unsigned int>& order)
+    {
+        order.clear();
+        if (n == 0)
+            return;
+        order.push_back(0);
+        if (n == 1)
+            return;
+
+        // point p is bit p-1 of a set
+        unsigned int m = n - 1;
+        m_m = m;
+        m_dist.resize(size_t(n) * n);
+        for (unsigned int a = 0; a < n; a++)
+        {
+            for (unsigned int b = 0; b < n; b++)
+                m_dist[size_t(b) * n + a] = float(dist(a, b));   // by destination, for the inner loop
+        }
+        m_table.assign(size_t(m) << m, float(INFINITE));
+        for (unsigned int j = 0; j < m; j++)
+            entry(1u << j, j) = m_dist[size_t(j + 1) * n];
+
+        for (unsigned int size = 2; size <= m; size++)
+            layer(size, threadCount);
+
+        // close the tour, then walk back through the table
+        unsigned int all = (1u << m) - 1;
+        unsigned int last = 0;
+        float best = INFINITE;
+        for (unsigned int j = 0; j < m; j++)
+        {
+            float length = entry(all, j) + m_dist[j + 1];
+            if (length < best)
+            {
+                best = length;
+                last = j;
+            }
+        }
+        std::vector<unsigned int> backwards;
+        for (unsigned int set = all; ; )
+        {
+            backwards.push_back(last + 1);
+            unsigned int rest = set & ~(1u << last);
+            if (rest == 0)
+                break;
+            const float* to = &m_dist[size_t(last + 1) * n];
+            unsigned int before = 0;
+            for (unsigned int i = 0; i < m; i++)
+            {
+                if (entry(rest, i) + to[i + 1] == entry(set, last))
+                {
+                    before = i;
+                    break;
+                }
+            }
+            set = rest;
+            last = before;
+        }
+        order.insert(order.end(), backwards.rbegin(), backwards.rend());
+    }
+
+private:
+    static constexpr float INFINITE = std::numeric_limits<float>::infinity();
+    static const unsigned int CHUNK = 1024;     // sets handed to a thread at a time
+
+    unsigned int m_m;               // points other than 0
+    std::vector<float> m_dist;      // m_dist[b * n + a] is the distance from a to b
+    std::vector<float> m_table;     // C(S, j) for the point j+1 is m_table[S * m_m + j]
+
+    float& entry(unsigned int set, unsigned int j) { return m_table[size_t(set) * m_m + j]; }
+
+      // every set of the given size, in order, split among threads
+    void layer(unsigned int size, unsigned int threadCount)
+    {
+        size_t sets = choose(m_m, size);
+        size_t chunks = (sets + CHUNK - 1) / CHUNK;
+        std::atomic<size_t> nextChunk(0);
+        auto work = [&]()
+        {
+            for (size_t c = nextChunk++; c < chunks; c = nextChunk++)
+            {
+                unsigned int set = unrank(c * CHUNK, size);
+                size_t count = std::min(size_t(CHUNK), sets - c * CHUNK);
+                for (size_t k = 0; k < count; k++)
+                {
+                    relax(set);
+                    // Gosper's hack: the next larger number with as many bits set
+                    unsigned int lowest = set & -set, ripple = set + lowest;
+                    set = ripple | (((set ^ ripple) >> 2) / lowest);
+                }
+            }
+        };
+        threadCount = std::min<size_t>(std::max(1u, threadCount), chunks);
+        std::vector<std::thread> threads;
+        for (unsigned int t = 1; t < threadCount; t++)
+            threads.push_back(std::thread(work));
+        work();
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+    }
+
+      // fill in set's row from the rows of the sets one point smaller
+    void relax(unsigned int set)
+    {
+        unsigned int n = m_m + 1;
+        float* row = &m_table[size_t(set) * m_m];
+        for (unsigned int bits = set; bits != 0; bits &= bits - 1)
+        {
+            unsigned int j = __builtin_ctz(bits);
+            const float* from = &m_table[size_t(set & ~(1u << j)) * m_m];
+            const float* to = &m_dist[size_t(j + 1) * n + 1];
+            float best = INFINITE;
+            for (unsigned int rest = set & ~(1u << j); rest != 0; rest &= rest - 1)
+            {
+                unsigned int i = __builtin_ctz(rest);
+                best = std::min(best, from[i] + to[i]);
+            }
+            row[j] = best;
+        }
+    }
+
+    static size_t choose(unsigned int n, unsigned int k)
+    {
+        if (k > n)
+            return 0;
+        size_t c = 1;
+        for (unsigned int i = 1; i <= k; i++)
+            c = c * (n - k + i) / i;
+        return c;
+    }
+
+      // the index'th smallest set of size points (of m_m)
+    unsigned int unrank(size_t index, unsigned int size) const
+    {
+        // the sets of a size in increasing order are the combinations in
+        // colexicographic order, so take the highest bit first
+        unsigned int set = 0;
+        for (unsigned int k = size; k > 0; k--)
+        {
+            unsigned int bit = k - 1;
+            while (choose(bit + 1, k) <= index)
+                bit++;
+            set |= 1u << bit;
+            index -= choose(bit, k);
+        }
+        return set;
+    }
+};
+
+#endif // HELDKARP_INCLUDED
@@ -0,0 +1,133 @@
+// IndexedHeap.h
+
+// A min-heap of graph node ids ordered by a double key, with decrease-key.
+// The heap is 4-ary (shallower than a binary heap, and a node's children sit
+// next to each other in memory), and each node's position in the heap is kept
+// in a flat array indexed by node id, so finding a node to lower its key
+// costs nothing.
+
+#ifndef INDEXEDHEAP_INCLUDED
+#define INDEXEDHEAP_INCLUDED
+
+#include <vector>
+
+class IndexedHeap
+{
+public:
+      // (NOT_IN_HEAP has no out-of-class definition, so vector's by-reference
+      // fill arguments get a copy)
+    IndexedHeap(unsigned int nodeCount = 0) : m_position(nodeCount, unsigned(NOT_IN_HEAP)) {}
+
+      // make room for node ids up to nodeCount - 1, and empty the heap
+    void resize(unsigned int nodeCount)
+    {
+        clear();
+        m_position.assign(nodeCount, unsigned(NOT_IN_HEAP));
+    }
+
+    bool empty() const { return m_heap.empty(); }
+    size_t size() const { return m_heap.size(); }
+    bool contains(unsigned int node) const { return m_position[node] != NOT_IN_HEAP; }
+
+      // O(size), not O(nodeCount)
+    void clear()
+    {
+        for (size_t i = 0; i < m_heap.size(); i++)
+            m_position[m_heap[i].node] = NOT_IN_HEAP;
+        m_heap.clear();
+    }
+
+    unsigned int top() const { return m_heap[0].node; }
+    double topKey() const { return m_heap[0].key; }
+    double key(unsigned int node) const { return m_heap[m_position[node]].key; }
+
+      // add node with the given key, or if it's already in the heap with a
+      // larger key, lower its key; return false if nothing changed
+    bool pushOrDecrease(unsigned int node, double key)
+    {
+        unsigned int i = m_position[node];
+        if (i == NOT_IN_HEAP)
+        {
+            i = m_heap.size();
+            Entry e = { key, node };
+            m_heap.push_back(e);
+        }
+        else if (key < m_heap[i].key)
+            m_heap[i].key = key;
+        else
+            return false;
+        siftUp(i);
+        return true;
+    }
+
+    unsigned int pop()
+    {
+        unsigned int node = m_heap[0].node;
+        m_position[node] = NOT_IN_HEAP;
+        Entry last = m_heap.back();
+        m_heap.pop_back();
+        if (!m_heap.empty())
+        {
+            m_heap[0] = last;
+            siftDown(0);
+        }
+        return node;
+    }
+
+private:
+    static const unsigned int NOT_IN_HEAP = 0xffffffff;
+    static const unsigned int ARITY = 4;
+
+    struct Entry
+    {
+        double key;
+        unsigned int node;
+    };
+
+    std::vector<Entry> m_heap;
+    std::vector<unsigned int> m_position;   // index in m_heap, or NOT_IN_HEAP
+
+    void siftUp(unsigned int i)
+    {
+        Entry e = m_heap[i];
+        while (i > 0)
+        {
+            unsigned int parent = (i - 1) / ARITY;
+            if (!(e.key < m_heap[parent].key))
+                break;
+            m_heap[i] = m_heap[parent];
+            m_position[m_heap[i].node] = i;
+            i = parent;
+        }
+        m_heap[i] = e;
+        m_position[e.node] = i;
+    }
+
+    void siftDown(unsigned int i)
+    {
+        Entry e = m_heap[i];
+        unsigned int n = m_heap.size();
+        for (;;)
+        {
+            unsigned int first = i * ARITY + 1;
+            if (first >= n)
+                break;
+            unsigned int last = first + ARITY < n ? first + ARITY : n;
+            unsigned int best = first;
+            for (unsigned int c = first + 1; c < last; c++)
+            {
+                if (m_heap[c].key < m_heap[best].key)
+                    best = c;
+            }
+            if (!(m_heap[best].key < e.key))
+                break;
+            m_heap[i] = m_heap[best];
+            m_position[m_heap[i].node] = i;
+            i = best;
+        }
+        m_heap[i] = e;
+        m_position[e.node] = i;
+    }
+};
+
+#endif // INDEXEDHEAP_INCLUDED
@@ -0,0 +1,367 @@
+#include "provided.h"
+#include "IndexedHeap.h"
+#include "GeoDistance.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+using namespace std;
+
+// Landmarks give A* a better lower bound than the straight line (the ALT
+// heuristic).  For a landmark L, the triangle inequality says that no route
+// from v to t is shorter than |d(L,t) - d(L,v)|, since every segment is
+// stored in both directions and so d(L,v) = d(v,L).  The bound is the largest
+// of these over all landmarks, which is tight whenever some landmark lies
+// roughly behind v as seen from t; so landmarks are picked on the outskirts
+// of the map.
+//
+// Each node's distances to the landmarks are stored together, as 16-bit
+// multiples of a step chosen so the farthest distance fits.  A stored value
+// is within half a step of the real distance, so two of them are off by less
+// than a step in all, and the bound subtracts one step to stay a lower bound.
+// The bound is then no longer quite consistent (it can change by up to two
+// steps, about a foot, more than an edge's length), so the router lets A*
+// reopen a node whose distance improves after it was settled.
+
+namespace
+{
+    const uint16_t UNREACHABLE = 0xffff;
+    const unsigned int NO_NODE = 0xffffffff;
+
+      // Dijkstra's algorithm from source over the whole graph.  If wanted,
+      // also records each node's parent in the shortest route tree and the
+      // order nodes were settled in.
+    void shortestDistances(const StreetGraph& graph, unsigned int source, vector<double>& dist,
+                           vector<unsigned int>* parent = nullptr, vector<unsigned int>* order = nullptr)
+    {
+        dist.assign(graph.nodeCount, numeric_limits<double>::infinity());
+        if (parent != nullptr)
+            parent->assign(graph.nodeCount, NO_NODE);
+        if (order != nullptr)
+            order->clear();
+        IndexedHeap heap(graph.nodeCount);
+        dist[source] = 0;
+        heap.pushOrDecrease(source, 0);
+        while (!heap.empty())
+        {
+            unsigned int u = heap.pop();
+            if (order != nullptr)
+                order->push_back(u);
+            StreetEdgeRange edges = graph.edgesFrom(u);
+            for (const StreetEdge* e = edges.begin(); e != edges.end(); e++)
+            {
+                double d = dist[u] + (*e).length;
+                if (d < dist[(*e).end])
+                {
+                    dist[(*e).end] = d;
+                    if (parent != nullptr)
+                        (*parent)[(*e).end] = u;
+                    heap.pushOrDecrease((*e).end, d);
+                }
+            }
+        }
+    }
+
+      // the nodes of the largest connected part of the map; a landmark
+      // anywhere else would bound almost nothing
+    vector<unsigned int> largestComponent(const StreetGraph& graph)
+    {
+        vector<unsigned int> component(graph.nodeCount, NO_NODE);
+        vector<unsigned int> best, current, stack;
+        for (unsigned int n = 0; n < graph.nodeCount; n++)
+        {
+            if (component[n] != NO_NODE)
+                continue;
+            current.clear();
+            stack.push_back(n);
+            component[n] = n;
+            while (!stack.empty())
+            {
+                unsigned int u = stack.back();
+                stack.pop_back();
+                current.push_back(u);
+                StreetEdgeRange edges = graph.edgesFrom(u);
+                for (const StreetEdge* e = edges.begin(); e != edges.end(); e++)
+                {
+                    if (component[(*e).end] == NO_NODE)
+                    {
+                        component[(*e).end] = n;
+                        stack.push_back((*e).end);
+                    }
+                }
+            }
+            if (current.size() > best.size())
+                best.swap(current);
+        }
+        return best;
+    }
+}
+
+class LandmarksImpl
+{
+public:
+    LandmarksImpl();
+    ~LandmarksImpl();
+    bool build(const StreetMap* sm, unsigned int count, Landmarks::Selection how);
+    bool isBuilt() const { return m_count != 0; }
+    bool isBuiltFor(const StreetMap* sm) const
+    {
+        return isBuilt()  &&  m_map == sm  &&  m_generation == sm->generation();
+    }
+    unsigned int count() const { return m_count; }
+    unsigned int landmark(unsigned int i) const { return m_landmarks[i]; }
+    double lowerBound(unsigned int from, unsigned int to) const;
+private:
+    const StreetMap* m_map;             // the map the landmarks were built from
+    unsigned int m_generation;          // and its generation then
+    unsigned int m_count;
+    double m_step;                      // miles per unit of a stored distance
+    vector<unsigned int> m_landmarks;
+    vector<uint16_t> m_distance;        // node n's distances at n * m_count
+
+    void chooseFarthest(const StreetGraph& graph, const vector<unsigned int>& candidates, unsigned int count);
+    void chooseAvoid(const StreetGraph& graph, const vector<unsigned int>& candidates, unsigned int count,
+                     vector<vector<double>>& dist);
+};
+
+LandmarksImpl::LandmarksImpl()
+ : m_map(nullptr), m_generation(0), m_count(0), m_step(0)
+{
+}
+
+LandmarksImpl::~LandmarksImpl()
+{
+}
+
+  // Greedy farthest point selection by straight-line distance: each
+  // landmark is the node farthest from those chosen so far.  Choosing costs
+  // no searches, so the landmarks' searches can all run at once afterwards.
+  // Each round measures from its newest landmark to every node in one batch.
+void LandmarksImpl::chooseFarthest(const StreetGraph& graph, const vector<unsigned int>& candidates, unsigned int count)
+{
+    vector<double> crow(graph.nodeCount);
+    auto measureFrom = [&graph, &crow](unsigned int from)
+    {
+        distancesMiles(graph.latitude[from], graph.longitude[from],
+                       graph.latitude, graph.longitude, graph.cosLatitude, graph.nodeCount, crow.data());
+    };
+
+    // the first landmark is the node farthest from an arbitrary one
+    measureFrom(candidates[0]);
+    unsigned int first = candidates[0];
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (crow[candidates[i]] > crow[first])
+            first = candidates[i];
+    }
+    m_landmarks.push_back(first);
+
+    vector<double> nearest(graph.nodeCount, numeric_limits<double>::infinity());
+    while (m_landmarks.size() < count)
+    {
+        measureFrom(m_landmarks.back());
+        unsigned int chosen = NO_NODE;
+        double farthest = 0;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            unsigned int n = candidates[i];
+            nearest[n] = min(nearest[n], crow[n]);
+            if (nearest[n] > farthest)
+            {
+                farthest = nearest[n];
+                chosen = n;
+            }
+        }
+        if (chosen == NO_NODE)
+            break;      // fewer distinct places than landmarks
+        m_landmarks.push_back(chosen);
+    }
+}
+
+  // Goldberg and Werneck's "avoid" selection.  Grow a shortest route tree
+  // from a random root, weigh each node by how much the landmarks chosen so
+  // far underestimate its distance from the root, and follow the heaviest
+  // landmark-free subtree down to a leaf.  That leaf becomes the next
+  // landmark, covering the routes the others serve worst.  Each choice needs
+  // the distances from the landmarks before it, so this runs in sequence.
+void LandmarksImpl::chooseAvoid(const StreetGraph& graph, const vector<unsigned int>& candidates, unsigned int count,
+                                vector<vector<double>>& dist)
+{
+    mt19937 rng(1);
+    vector<double> rootDist;
+    vector<unsigned int> parent, order;
+    vector<double> size(graph.nodeCount);
+    vector<bool> isLandmark(graph.nodeCount, false);
+    vector<unsigned int> bestChild(graph.nodeCount);
+    while (m_landmarks.size() < count)
+    {
+        unsigned int root = candidates[rng() % candidates.size()];
+        shortestDistances(graph, root, rootDist, &parent, &order);
+
+        // settling order lists parents before children, so walking it
+        // backwards totals each subtree after all of its children
+        fill(size.begin(), size.end(), 0.0);
+        fill(bestChild.begin(), bestChild.end(), NO_NODE);
+        vector<bool> hasLandmark(graph.nodeCount, false);
+        for (size_t i = order.size(); i-- > 0; )
+        {
+            unsigned int v = order[i];
+            double bound = 0;
+            for (size_t l = 0; l < dist.size(); l++)
+                bound = max(bound, abs(dist[l][v] - dist[l][root]));
+            if (isLandmark[v])
+                hasLandmark[v] = true;
+            size[v] = hasLandmark[v] ? 0 : size[v] + rootDist[v] - bound;
+            unsigned int p = parent[v];
+            if (p == NO_NODE)
+                continue;
+            if (hasLandmark[v])
+                hasLandmark[p] = true;
+            size[p] += size[v];
+            if (bestChild[p] == NO_NODE  ||  size[v] > size[bestChild[p]])
+                bestChild[p] = v;
+        }
+        unsigned int v = root;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (size[order[i]] > size[v])
+                v = order[i];
+        }
+        if (size[v] <= 0)
+            break;      // every route is bounded exactly already
+        while (bestChild[v] != NO_NODE  &&  size[bestChild[v]] > 0)
+            v = bestChild[v];
+
+        m_landmarks.push_back(v);
+        isLandmark[v] = true;
+        dist.push_back(vector<double>());
+        shortestDistances(graph, v, dist.back());
+    }
+}
+
+bool LandmarksImpl::build(const StreetMap* sm, unsigned int count, Landmarks::Selection how)
+{
+    m_count = 0;
+    m_landmarks.clear();
+    m_distance.clear();
+    const StreetGraph& graph = sm->graph();
+    if (count == 0  ||  graph.nodeCount == 0)
+        return false;
+    vector<unsigned int> candidates = largestComponent(graph);
+
+    vector<vector<double>> dist;
+    if (how == Landmarks::AVOID)
+        chooseAvoid(graph, candidates, count, dist);
+    else
+    {
+        // with the landmarks known up front, their searches are independent
+        chooseFarthest(graph, candidates, count);
+        dist.resize(m_landmarks.size());
+        unsigned int threadCount = max(1u, min<unsigned int>(thread::hardware_concurrency(), m_landmarks.size()));
+        vector<thread> threads;
+        for (unsigned int t = 0; t < threadCount; t++)
+        {
+            threads.push_back(thread([&, t]()
+            {
+                for (size_t l = t; l < m_landmarks.size(); l += threadCount)
+                    shortestDistances(graph, m_landmarks[l], dist[l]);
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+    }
+    if (m_landmarks.empty())
+        return false;
+
+    // quantize, node by node
+    double farthest = 0;
+    for (size_t l = 0; l < dist.size(); l++)
+    {
+        for (unsigned int n = 0; n < graph.nodeCount; n++)
+        {
+            if (dist[l][n] != numeric_limits<double>::infinity())
+                farthest = max(farthest, dist[l][n]);
+        }
+    }
+    m_map = sm;
+    m_generation = sm->generation();
+    m_count = m_landmarks.size();
+    m_step = farthest > 0 ? farthest / (UNREACHABLE - 1) : 1;
+    m_distance.resize(size_t(graph.nodeCount) * m_count);
+    for (unsigned int n = 0; n < graph.nodeCount; n++)
+    {
+        for (unsigned int l = 0; l < m_count; l++)
+        {
+            double d = dist[l][n];
+            m_distance[size_t(n) * m_count + l] =
+                d == numeric_limits<double>::infinity() ? UNREACHABLE : uint16_t(d / m_step + 0.5);
+        }
+    }
+    return true;
+}
+
+double LandmarksImpl::lowerBound(unsigned int from, unsigned int to) const
+{
+    const uint16_t* a = &m_distance[size_t(from) * m_count];
+    const uint16_t* b = &m_distance[size_t(to) * m_count];
+    int best = 0;
+    for (unsigned int l = 0; l < m_count; l++)
+    {
+        if (a[l] == UNREACHABLE  ||  b[l] == UNREACHABLE)
+        {
+            if (a[l] != b[l])
+                return numeric_limits<double>::infinity();  // one can reach the landmark, one can't
+            continue;
+        }
+        best = max(best, abs(int(a[l]) - int(b[l])));
+    }
+    return best > 1 ? (best - 1) * m_step : 0;
+}
+
+//******************** Landmarks functions ************************************
+
+// These functions simply delegate to LandmarksImpl's functions.
+// You probably don't want to change any of this code.
+
+Landmarks::Landmarks()
+{
+    m_impl = new LandmarksImpl;
+}
+
+Landmarks::~Landmarks()
+{
+    delete m_impl;
+}
+
+bool Landmarks::build(const StreetMap* sm, unsigned int count, Selection how)
+{
+    return m_impl->build(sm, count, how);
+}
+
+bool Landmarks::isBuilt() const
+{
+    return m_impl->isBuilt();
+}
+
+bool Landmarks::isBuiltFor(const StreetMap* sm) const
+{
+    return m_impl->isBuiltFor(sm);
+}
+
+unsigned int Landmarks::count() const
+{
+    return m_impl->count();
+}
+
+unsigned int Landmarks::landmark(unsigned int i) const
+{
+    return m_impl->landmark(i);
+}
+
+double Landmarks::lowerBound(unsigned int fromNode, unsigned int toNode) const
+{
+    return m_impl->lowerBound(fromNode, toNode);
+}
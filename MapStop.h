@@ -0,0 +1,255 @@
+// MapStop.h
+
+// Where a depot or delivery location lies on a StreetMap: at a node, or
+// (when snapping is allowed) partway along the nearest segment.  A route
+// leaves or reaches a stop partway along a segment by one of that segment's
+// two ends, its anchors, so the road distance between two stops is the best
+// over their anchors of the route between them plus the pieces of segment at
+// either end.  DeliveryPlanner routes between stops this way, and a
+// DeliveryOptimizer or FleetPlanner measuring road distances finds the stops
+// the same way so that they agree.  Last are the two distances between
+// points that the optimizers search with: straight lines and a matrix of road
+// distances.
+
+#ifndef MAPSTOP_INCLUDED
+#define MAPSTOP_INCLUDED
+
+#include "provided.h"
+#include "GeoDistance.h"
+#include <vector>
+#include <sstream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+struct MapStop
+{
+    static const unsigned int NOT_AT_NODE = 0xffffffff;
+
+    GeoCoord where;     // the location, or where it was snapped to
+    unsigned int node;  // the node at where, or NOT_AT_NODE if it's partway along a segment
+    SegmentSnap snap;   // if so, which segment
+};
+
+  // A node a route to or from a stop can pass through, and how far the stop
+  // is from it.
+struct Anchor
+{
+    unsigned int node;
+    double offset;      // in miles
+};
+
+  // Find gc on the map: at a node, or failing that (if snapRadius is
+  // positive), on the nearest segment within snapRadius meters.
+inline bool locateStop(const StreetMap* sm, const GeoCoord& gc, double snapRadius, MapStop& stop)
+{
+    if (sm->findNode(gc, stop.node))
+    {
+        stop.where = sm->coordOf(stop.node);
+        return true;
+    }
+    if (snapRadius <= 0  ||  !sm->nearestSegment(gc, snapRadius, stop.snap))
+        return false;
+    if (stop.snap.fraction == 0)
+        stop.node = stop.snap.fromNode;
+    else if (stop.snap.fraction == 1)
+        stop.node = sm->graph().edges[stop.snap.edge].end;
+    else
+    {
+        stop.node = MapStop::NOT_AT_NODE;
+        std::ostringstream lat, lon;
+        lat.setf(std::ios::fixed);
+        lat.precision(7);
+        lon.setf(std::ios::fixed);
+        lon.precision(7);
+        lat << stop.snap.latitude;
+        lon << stop.snap.longitude;
+        stop.where = GeoCoord(lat.str(), lon.str());
+        return true;
+    }
+    stop.where = sm->coordOf(stop.node);
+    return true;
+}
+
+  // the nodes a route can leave or reach stop by: its own node, or the two
+  // ends of the segment it's on
+inline void anchorsOf(const StreetMap* sm, const MapStop& stop, std::vector<Anchor>& anchors)
+{
+    anchors.clear();
+    if (stop.node != MapStop::NOT_AT_NODE)
+    {
+        Anchor a = { stop.node, 0 };
+        anchors.push_back(a);
+        return;
+    }
+    const StreetEdge& edge = sm->graph().edges[stop.snap.edge];
+    Anchor a = { stop.snap.fromNode, stop.snap.fraction * edge.length };
+    Anchor b = { edge.end, (1 - stop.snap.fraction) * edge.length };
+    anchors.push_back(a);
+    anchors.push_back(b);
+}
+
+  // If both stops are partway along the same segment (either way round),
+  // going straight along it is shortest: set dist to that and return true.
+inline bool alongOneSegment(const StreetMap* sm, const MapStop& from, const MapStop& to, double& dist)
+{
+    if (from.node != MapStop::NOT_AT_NODE  ||  to.node != MapStop::NOT_AT_NODE)
+        return false;
+    const StreetGraph& graph = sm->graph();
+    const StreetEdge& a = graph.edges[from.snap.edge];
+    const StreetEdge& b = graph.edges[to.snap.edge];
+    bool same = from.snap.fromNode == to.snap.fromNode  &&  a.end == b.end;
+    bool opposite = from.snap.fromNode == b.end  &&  a.end == to.snap.fromNode;
+    if (!(same || opposite)  ||  a.name != b.name)
+        return false;
+    double toFraction = same ? to.snap.fraction : 1 - to.snap.fraction;
+    dist = std::abs(toFraction - from.snap.fraction) * a.length;
+    return true;
+}
+
+  // Every point located as by locateStop, and its anchors: point p's are
+  // anchors[firstAnchor[p]] up to anchors[firstAnchor[p+1]].  Returns false
+  // if a point can't be found on the map.
+inline bool locateStops(const StreetMap* sm, const std::vector<GeoCoord>& points, double snapRadius,
+                        std::vector<MapStop>& stops, std::vector<Anchor>& anchors,
+                        std::vector<unsigned int>& firstAnchor)
+{
+    unsigned int n = points.size();
+    stops.resize(n);
+    anchors.clear();
+    firstAnchor.assign(n + 1, 0);
+    std::vector<Anchor> some;
+    for (unsigned int p = 0; p < n; p++)
+    {
+        if (!locateStop(sm, points[p], snapRadius, stops[p]))
+            return false;
+        anchorsOf(sm, stops[p], some);
+        anchors.insert(anchors.end(), some.begin(), some.end());
+        firstAnchor[p+1] = anchors.size();
+    }
+    return true;
+}
+
+  // Which points (located as by locateStop) a route can reach from the
+  // first, into reachable.  The map's segments all go both ways, so those
+  // points can reach each other too.  It takes one computeDistanceMatrix
+  // call from the first point's anchors, which only searches the part of the
+  // map they're in.  Returns false if a point can't be found on the map.
+inline bool reachableFrom(const StreetMap* sm, const std::vector<GeoCoord>& points, double snapRadius,
+                          const RouterOptions& routerOptions, std::vector<bool>& reachable)
+{
+    unsigned int n = points.size();
+    std::vector<MapStop> stops;
+    std::vector<Anchor> anchors;
+    std::vector<unsigned int> firstAnchor;
+    if (!locateStops(sm, points, snapRadius, stops, anchors, firstAnchor))
+        return false;
+    reachable.assign(n, false);
+    if (n == 0)
+        return true;
+    std::vector<unsigned int> sources, targets;
+    for (unsigned int a = firstAnchor[0]; a < firstAnchor[1]; a++)
+        sources.push_back(anchors[a].node);
+    for (size_t a = 0; a < anchors.size(); a++)
+        targets.push_back(anchors[a].node);
+    PointToPointRouter router(sm, routerOptions);
+    std::vector<double> between;
+    if (router.computeDistanceMatrix(sources, targets, between) != DELIVERY_SUCCESS)
+        return false;
+    double d;
+    for (unsigned int p = 0; p < n; p++)
+    {
+        reachable[p] = alongOneSegment(sm, stops[0], stops[p], d);
+        for (size_t s = 0; s < sources.size(); s++)
+        {
+            for (unsigned int a = firstAnchor[p]; a < firstAnchor[p+1]; a++)
+            {
+                if (between[s * targets.size() + a] != std::numeric_limits<double>::infinity())
+                    reachable[p] = true;
+            }
+        }
+    }
+    return true;
+}
+
+  // The road distance between every two points (each located as by
+  // locateStop), into the n by n matrix.  Every anchor's routes come from one
+  // call to the router's computeDistanceMatrix.  The map's segments all go
+  // both ways, so a route back is as long as the route there, give or take
+  // rounding; the matrix is made exactly symmetric, as TourSearch needs.
+  // Returns false if a point can't be found on the map; points that can't
+  // reach each other are infinitely far apart.
+inline bool roadDistanceMatrix(const StreetMap* sm, const std::vector<GeoCoord>& points, double snapRadius,
+                               const RouterOptions& routerOptions, std::vector<double>& matrix)
+{
+    unsigned int n = points.size();
+    std::vector<MapStop> stops;
+    std::vector<Anchor> anchors;
+    std::vector<unsigned int> firstAnchor;
+    if (!locateStops(sm, points, snapRadius, stops, anchors, firstAnchor))
+        return false;
+
+    // each distinct anchor node once
+    std::vector<unsigned int> nodes;
+    for (size_t a = 0; a < anchors.size(); a++)
+        nodes.push_back(anchors[a].node);
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    std::vector<unsigned int> column(anchors.size());
+    for (size_t a = 0; a < anchors.size(); a++)
+        column[a] = std::lower_bound(nodes.begin(), nodes.end(), anchors[a].node) - nodes.begin();
+    PointToPointRouter router(sm, routerOptions);
+    std::vector<double> between;
+    if (router.computeDistanceMatrix(nodes, nodes, between) != DELIVERY_SUCCESS)
+        return false;
+
+    size_t columns = nodes.size();
+    matrix.assign(size_t(n) * n, 0);
+    for (unsigned int p = 0; p < n; p++)
+    {
+        for (unsigned int q = p + 1; q < n; q++)
+        {
+            double d;
+            if (!alongOneSegment(sm, stops[p], stops[q], d))
+            {
+                d = std::numeric_limits<double>::infinity();
+                for (unsigned int a = firstAnchor[p]; a < firstAnchor[p+1]; a++)
+                {
+                    for (unsigned int b = firstAnchor[q]; b < firstAnchor[q+1]; b++)
+                        d = std::min(d, anchors[a].offset + between[column[a] * columns + column[b]] + anchors[b].offset);
+                }
+            }
+            matrix[size_t(p) * n + q] = matrix[size_t(q) * n + p] = d;
+        }
+    }
+    return true;
+}
+
+  // Straight-line distance between points, computed exactly as
+  // distanceEarthMiles does but with each point's cosine of latitude worked
+  // out once.
+struct CrowDistance
+{
+    const double* latitude;
+    const double* longitude;
+    const double* cosLatitude;
+
+    double operator()(unsigned int a, unsigned int b) const
+    {
+        return distanceMiles(latitude[a], longitude[a], cosLatitude[a], latitude[b], longitude[b], cosLatitude[b]);
+    }
+};
+
+  // Road distance between points, from an n by n matrix.
+struct RoadDistance
+{
+    const double* matrix;
+    unsigned int n;
+
+    double operator()(unsigned int a, unsigned int b) const
+    {
+        return matrix[size_t(a) * n + b];
+    }
+};
+
+#endif // MAPSTOP_INCLUDED
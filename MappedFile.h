@@ -0,0 +1,105 @@
+// MappedFile.h
+
+// A read-only view of an entire file.  On POSIX systems the file is mapped
+// into memory with mmap, so opening it costs no copying and pages are only
+// brought in as they are touched; elsewhere the file is read into a buffer.
+
+#ifndef MAPPEDFILE_INCLUDED
+#define MAPPEDFILE_INCLUDED
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPEDFILE_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class MappedFile
+{
+public:
+    MappedFile() : m_data(nullptr), m_size(0), m_mapped(false) {}
+    ~MappedFile() { close(); }
+    bool open(const std::string& fileName);
+    void close();
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool isOpen() const { return m_data != nullptr; }
+    void swap(MappedFile& other);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;              // m_data came from mmap rather than m_buffer
+    std::vector<char> m_buffer;
+};
+
+inline bool MappedFile::open(const std::string& fileName)
+{
+    close();
+#ifdef MAPPEDFILE_USE_MMAP
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size > 0)
+    {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        m_data = static_cast<const char*>(p);
+        m_size = st.st_size;
+        m_mapped = true;
+        return true;
+    }
+    ::close(fd);
+    // an empty file can't be mapped; fall through to an empty buffer
+#endif
+    std::ifstream inf(fileName, std::ios::binary);
+    if (!inf)
+        return false;
+    m_buffer.assign(std::istreambuf_iterator<char>(inf), std::istreambuf_iterator<char>());
+    m_buffer.push_back('\0');   // keep data() non-null for an empty file
+    m_data = m_buffer.data();
+    m_size = m_buffer.size() - 1;
+    return true;
+}
+
+inline void MappedFile::close()
+{
+#ifdef MAPPEDFILE_USE_MMAP
+    if (m_mapped)
+        munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+
+inline void MappedFile::swap(MappedFile& other)
+{
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_mapped, other.m_mapped);
+    m_buffer.swap(other.m_buffer);   // data() stays valid: vector swap keeps the storage
+}
+
+#endif // MAPPEDFILE_INCLUDED
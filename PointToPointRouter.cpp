@@ -1,27 +1,97 @@
 #include "provided.h"
-#include "ExpandableHashMap.h"
-#include <utility>
+#include "SearchWorkspace.h"
+#include "GeoDistance.h"
 #include <list>
-#include <set>
 #include <vector>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 using namespace std;
 
+  // the shortest of the segments from one node to another, which are
+  // usually just one; for turning a backward search's steps around
+static const StreetEdge* shortestEdge(const StreetGraph& graph, unsigned int from, unsigned int to)
+{
+    const StreetEdge* used = nullptr;
+    StreetEdgeRange edges = graph.edgesFrom(from);
+    for (auto e = edges.begin(); e != edges.end(); e++)
+    {
+        if ((*e).end == to  &&  (used == nullptr  ||  (*e).length < used->length))
+            used = e;
+    }
+    return used;
+}
+
+  // Every thread keeps its own workspaces and reuses them for each search it
+  // runs, so steady-state searches allocate nothing.  A bidirectional search
+  // needs two.
+static SearchWorkspace& threadWorkspace(unsigned int which)
+{
+    static thread_local SearchWorkspace workspaces[2];
+    return workspaces[which];
+}
+
+  // Which nodes are targets of the distance matrix a thread is computing,
+  // and how many distinct targets each connected part of the map holds (by
+  // the part's StreetGraph::component id).  Kept by each thread and reused,
+  // like its workspaces, and left all clear after each matrix.
+struct TargetMarks
+{
+    vector<bool> isTarget;
+    vector<unsigned int> targetsIn;
+};
+
+static TargetMarks& threadTargetMarks()
+{
+    static thread_local TargetMarks marks;
+    return marks;
+}
+
+  // How many nodes the last route this thread asked for settled.  Per
+  // thread, like the workspaces, so threads sharing a router don't race.
+static thread_local unsigned int lastNodesSettled = 0;
+
 class PointToPointRouterImpl
 {
 public:
-    PointToPointRouterImpl(const StreetMap* sm);
+    PointToPointRouterImpl(const StreetMap* sm, const RouterOptions& options);
     ~PointToPointRouterImpl();
     DeliveryResult generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+    DeliveryResult generatePointToPointRoute(
+        unsigned int start,
+        unsigned int end,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled) const;
+    DeliveryResult generatePointToPointRoute(
+        unsigned int start,
+        unsigned int end,
+        CompactRoute& route) const;
+    DeliveryResult computeDistanceMatrix(
+        const vector<unsigned int>& sources,
+        const vector<unsigned int>& targets,
+        vector<double>& distances,
+        vector<CompactRoute>* paths) const;
+    unsigned int nodesSettled() const { return lastNodesSettled; }
     
 private:
     const StreetMap* m_stmap;
+    RouterOptions m_options;
+    DeliveryResult search(unsigned int start, unsigned int end, CompactRoute& path, unsigned int& settled) const;
+    DeliveryResult aStarRoute(unsigned int start, unsigned int end, CompactRoute& path, unsigned int& settled) const;
+    DeliveryResult bidirectionalRoute(unsigned int start, unsigned int end, CompactRoute& path,
+                                      unsigned int& settled) const;
+    DeliveryResult hierarchyRoute(unsigned int start, unsigned int end, CompactRoute& path,
+                                  unsigned int& settled) const;
+    void expand(unsigned int start, const CompactRoute& path, list<StreetSegment>& route) const;
 };
 
-PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm): m_stmap(sm)
+PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm, const RouterOptions& options)
+ : m_stmap(sm), m_options(options)
 {
 }
 
@@ -37,120 +107,364 @@ DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
 {
     route.clear();
     totalDistanceTravelled = 0;
+    lastNodesSettled = 0;
     if (start == end)
     {
         return DELIVERY_SUCCESS;
     }
     
     // Check if the beginning and ending coordinate are in the map:
-    vector<StreetSegment> test1,test2;
-    m_stmap->getSegmentsThatStartWith(start,test1);
-    m_stmap->getSegmentsThatStartWith(end,test2);
-    if (test1.empty() || test2.empty())
+    unsigned int startNode, endNode;
+    if (!m_stmap->findNode(start, startNode) || !m_stmap->findNode(end, endNode))
         return BAD_COORD;
-        
-    ExpandableHashMap<GeoCoord,GeoCoord> closed_list;
-    set<pair<double,pair<GeoCoord,GeoCoord>>> open_list;
+    return generatePointToPointRoute(startNode, endNode, route, totalDistanceTravelled);
+}
+
+DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
+        unsigned int start,
+        unsigned int end,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled) const
+{
+    route.clear();
+    totalDistanceTravelled = 0;
+    CompactRoute path;
+    DeliveryResult result = generatePointToPointRoute(start, end, path);
+    if (result != DELIVERY_SUCCESS)
+        return result;
+    expand(start, path, route);
+    totalDistanceTravelled = path.length;
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
+        unsigned int start,
+        unsigned int end,
+        CompactRoute& route) const
+{
+    route.edges.clear();
+    route.length = 0;
+    lastNodesSettled = 0;
+    const StreetGraph& graph = m_stmap->graph();
+    if (start >= graph.nodeCount || end >= graph.nodeCount)
+        return BAD_COORD;
+    if (start == end)
+    {
+        return DELIVERY_SUCCESS;
+    }
     
-    open_list.insert(make_pair(0.0,make_pair(start,start)));
+    RouteCache* cache = m_options.cache;
+    unsigned int generation = m_stmap->generation();
+    if (cache != nullptr  &&  cache->find(start, end, generation, route))
+        return DELIVERY_SUCCESS;
+    unsigned int settled = 0;
+    DeliveryResult result = search(start, end, route, settled);
+    lastNodesSettled = settled;
+    if (result == DELIVERY_SUCCESS  &&  cache != nullptr)
+        cache->insert(start, end, generation, route);
+    return result;
+}
+
+DeliveryResult PointToPointRouterImpl::search(unsigned int start, unsigned int end, CompactRoute& path,
+                                              unsigned int& settled) const
+{
+    path.edges.clear();
+    path.length = 0;
+    if (m_options.hierarchy != nullptr  &&  m_options.hierarchy->isBuiltFor(m_stmap))
+        return hierarchyRoute(start, end, path, settled);
+    if (m_options.bidirectional)
+        return bidirectionalRoute(start, end, path, settled);
+    return aStarRoute(start, end, path, settled);
+}
+
+  // the StreetSegments along path, which leaves from start
+void PointToPointRouterImpl::expand(unsigned int start, const CompactRoute& path, list<StreetSegment>& route) const
+{
+    const StreetGraph& graph = m_stmap->graph();
+    unsigned int from = start;
+    for (size_t i = 0; i < path.edges.size(); i++)
+    {
+        const StreetEdge& e = graph.edges[path.edges[i]];
+        route.push_back(StreetSegment(m_stmap->coordOf(from), m_stmap->coordOf(e.end),
+                                      m_stmap->streetName(e.name), e.name));
+        from = e.end;
+    }
+}
+
+// A* search.  g[n] is the length of the best route found so far from start to
+// n, and the open list is a heap of nodes keyed by f = g + h, where h is a
+// lower bound on the distance left to end: the straight line, or what the
+// landmarks give if that's more.  Since h never overestimates, the first time
+// end comes off the heap its route is the shortest.  The straight line alone
+// never drops by more than a segment's length, so a settled node is never
+// improved on; the landmarks' rounded bound can, by a hair, so a node whose g
+// improves simply goes back on the heap.
+DeliveryResult PointToPointRouterImpl::aStarRoute(unsigned int start, unsigned int end, CompactRoute& path,
+                                                  unsigned int& settled) const
+{
+    const StreetGraph& graph = m_stmap->graph();
+    double endLat = graph.latitude[end];
+    double endLon = graph.longitude[end];
+    double endCos = graph.cosLatitude[end];
+    const Landmarks* landmarks = m_options.landmarks != nullptr  &&  m_options.landmarks->isBuiltFor(m_stmap) ?
+                                 m_options.landmarks : nullptr;
+    auto h = [&](unsigned int n)
+    {
+        double crow = distanceMiles(graph.latitude[n], graph.longitude[n], graph.cosLatitude[n], endLat, endLon, endCos);
+        return landmarks == nullptr ? crow : max(crow, landmarks->lowerBound(n, end));
+    };
     
-    GeoCoord parent = start;
-    double current_f = 0.0;
+    // g and each node's parent live in the workspace
+    SearchWorkspace& ws = threadWorkspace(0);
+    ws.start(graph.nodeCount);
+    IndexedHeap& open_list = ws.heap();
+    
+    double startH = h(start);
+    if (startH == numeric_limits<double>::infinity())
+        return NO_ROUTE;
+    ws.reach(start, 0, SearchWorkspace::NONE);
+    open_list.pushOrDecrease(start, startH);
     
     while (!open_list.empty())
     {
-        pair<double,pair<GeoCoord,GeoCoord>> top = *open_list.begin();
-        open_list.erase(open_list.begin());
-        
-        parent = top.second.second;  // set parent to the second geocoord
-        current_f = top.first;  // set the current f-value to be added to the f-value of the parent
+        unsigned int current = open_list.pop();
+        settled++;
         
-        closed_list.associate(parent,top.second.first);
-        /*
-        if (parent != start)
+        if (current == end)
         {
-            //add the top of the priority queue into the route
-            route.push_back(top.second);
-            totalDistanceTravelled += distanceEarthMiles(top.second.start,top.second.end);
+            // walk the parents back from end, then put the edges in order
+            for (unsigned int n = end; n != start; n = ws.parent(n))
+                path.edges.push_back(ws.parentEdge(n));
+            reverse(path.edges.begin(), path.edges.end());
+            path.length = ws.distance(end);
+            return DELIVERY_SUCCESS;
         }
-        */
         
-        if (parent == end)
+        StreetEdgeRange edges = graph.edgesFrom(current);
+        for (auto e = edges.begin(); e != edges.end(); e++)
         {
-            GeoCoord current_geo = end;
-            GeoCoord next_geo = *closed_list.find(end);
-            
-            while (current_geo != start)
+            unsigned int next = (*e).end;
+            double newG = ws.distance(current) + (*e).length;
+            if (newG < ws.distance(next))
             {
-                totalDistanceTravelled += distanceEarthMiles(next_geo,current_geo);
-                vector<StreetSegment> find_seg;
-                m_stmap->getSegmentsThatStartWith(next_geo, find_seg);
-                for (auto p = find_seg.begin(); p != find_seg.end(); p++)
-                {
-                    if ((*p).end == current_geo)
-                    {
-                        route.push_front((*p));
-                    }
-                }
-                current_geo = next_geo;
-                next_geo = *closed_list.find(current_geo);
+                ws.reach(next, newG, current, e - graph.edges);
+                open_list.pushOrDecrease(next, newG + h(next));
             }
-            // go through every geocoord and its parent
-            // have to use find in hash map to find geocoord partner & streetsegment appropriate, then push front onto the list
-            // add up everything
-            
-            return DELIVERY_SUCCESS;
         }
+    }
+    
+    return NO_ROUTE; // the open list ran dry without reaching end
+}
+
+// Bidirectional A*: a forward search from start and a backward search from
+// end, each step advancing whichever has the smaller open list.  Every
+// segment is stored in both directions with the same length, so the backward
+// search walks the same edges.  The searches share one potential, half the
+// difference of the straight-line distances to end and from start: the
+// forward search orders nodes by g + p, the backward one by g - p.  Like
+// A*'s h, p never drops along an edge by more than the edge's length, so
+// each search is Dijkstra's on the same reduced edge lengths, and once the
+// two smallest keys together reach the best route through a node reached by
+// both, no shorter route remains.
+DeliveryResult PointToPointRouterImpl::bidirectionalRoute(unsigned int start, unsigned int end, CompactRoute& path,
+                                                          unsigned int& settled) const
+{
+    const StreetGraph& graph = m_stmap->graph();
+    const double INF = numeric_limits<double>::infinity();
+    double startLat = graph.latitude[start], startLon = graph.longitude[start], startCos = graph.cosLatitude[start];
+    double endLat = graph.latitude[end], endLon = graph.longitude[end], endCos = graph.cosLatitude[end];
+    auto potential = [&](unsigned int n)
+    {
+        double lat = graph.latitude[n], lon = graph.longitude[n], cosLat = graph.cosLatitude[n];
+        double toEnd = distanceMiles(lat, lon, cosLat, endLat, endLon, endCos);
+        double fromStart = distanceMiles(startLat, startLon, startCos, lat, lon, cosLat);
+        return (toEnd - fromStart) / 2;
+    };
+    
+    // side 0 searches forward from start, side 1 backward from end
+    SearchWorkspace* ws[2] = { &threadWorkspace(0), &threadWorkspace(1) };
+    IndexedHeap* open_list[2] = { &ws[0]->heap(), &ws[1]->heap() };
+    const double sign[2] = { 1, -1 };
+    
+    ws[0]->start(graph.nodeCount);
+    ws[1]->start(graph.nodeCount);
+    ws[0]->reach(start, 0, SearchWorkspace::NONE);
+    ws[1]->reach(end, 0, SearchWorkspace::NONE);
+    open_list[0]->pushOrDecrease(start, potential(start));
+    open_list[1]->pushOrDecrease(end, -potential(end));
+    double best = INF;          // the shortest route through a node both sides reached
+    unsigned int meeting = SearchWorkspace::NONE;
+    
+    unsigned int side = 0;
+    while (!open_list[0]->empty()  &&  !open_list[1]->empty()  &&
+           open_list[0]->topKey() + open_list[1]->topKey() < best)
+    {
+        SearchWorkspace& here = *ws[side];
+        const SearchWorkspace& there = *ws[1-side];
+        unsigned int current = open_list[side]->pop();
+        settled++;
         
-        vector<StreetSegment> possible_segs;
-        m_stmap->getSegmentsThatStartWith(parent,possible_segs);
-        for (auto p = possible_segs.begin(); p != possible_segs.end(); p++)
+        StreetEdgeRange edges = graph.edgesFrom(current);
+        for (auto e = edges.begin(); e != edges.end(); e++)
+        {
+            unsigned int next = (*e).end;
+            double newG = here.distance(current) + (*e).length;
+            if (newG < here.distance(next))
+            {
+                here.reach(next, newG, current, e - graph.edges);
+                open_list[side]->pushOrDecrease(next, newG + sign[side] * potential(next));
+            }
+            if (here.distance(next) + there.distance(next) < best)
+            {
+                best = here.distance(next) + there.distance(next);
+                meeting = next;
+            }
+        }
+        side = open_list[0]->size() <= open_list[1]->size() ? 0 : 1;
+    }
+    
+    if (meeting == SearchWorkspace::NONE)
+        return NO_ROUTE;
+    
+    // start .. meeting from the forward parents' edges; meeting .. end from
+    // the backward ones, whose edges point the other way
+    for (unsigned int n = meeting; n != start; n = ws[0]->parent(n))
+        path.edges.push_back(ws[0]->parentEdge(n));
+    reverse(path.edges.begin(), path.edges.end());
+    for (unsigned int n = meeting; n != end; n = ws[1]->parent(n))
+        path.edges.push_back(shortestEdge(graph, n, ws[1]->parent(n)) - graph.edges);
+    path.length = best;
+    return DELIVERY_SUCCESS;
+}
+
+DeliveryResult PointToPointRouterImpl::hierarchyRoute(unsigned int start, unsigned int end, CompactRoute& path,
+                                                      unsigned int& settled) const
+{
+    if (!m_options.hierarchy->route(start, end, path.edges, path.length, settled))
+        return NO_ROUTE;
+    return DELIVERY_SUCCESS;
+}
+
+// One Dijkstra search per source, stopping once every target has been
+// settled.  Targets are usually close together (a depot and its deliveries),
+// so each search covers little more than the area around them.  A few
+// sources are searched from on the calling thread; more are handed out one
+// at a time to it and to helper threads, each reusing its own search
+// workspace.  (Without paths to record, a hierarchy answers instead.)
+DeliveryResult PointToPointRouterImpl::computeDistanceMatrix(
+        const vector<unsigned int>& sources,
+        const vector<unsigned int>& targets,
+        vector<double>& distances,
+        vector<CompactRoute>* paths) const
+{
+    const StreetGraph& graph = m_stmap->graph();
+    const double INF = numeric_limits<double>::infinity();
+    const size_t SOURCES_PER_THREAD = 4;    // fewer aren't worth starting a thread for
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (sources[i] >= graph.nodeCount)
+            return BAD_COORD;
+    }
+    for (size_t j = 0; j < targets.size(); j++)
+    {
+        if (targets[j] >= graph.nodeCount)
+            return BAD_COORD;
+    }
+    
+    if (paths == nullptr  &&  m_options.hierarchy != nullptr  &&  m_options.hierarchy->isBuiltFor(m_stmap))
+    {
+        m_options.hierarchy->distanceMatrix(sources, targets, distances);
+        return DELIVERY_SUCCESS;
+    }
+    
+    // A search can only settle the targets in its source's connected part
+    // of the map; waiting for any other target would make it search the
+    // whole part.
+    TargetMarks& marks = threadTargetMarks();
+    if (marks.isTarget.size() != graph.nodeCount)
+    {
+        marks.isTarget.assign(graph.nodeCount, false);
+        marks.targetsIn.assign(graph.nodeCount, 0);
+    }
+    vector<bool>& isTarget = marks.isTarget;
+    vector<unsigned int>& targetsIn = marks.targetsIn;
+    for (size_t j = 0; j < targets.size(); j++)
+    {
+        if (!isTarget[targets[j]])
+        {
+            isTarget[targets[j]] = true;
+            targetsIn[graph.component[targets[j]]]++;
+        }
+    }
+    
+    size_t columns = targets.size();
+    distances.assign(sources.size() * columns, INF);
+    if (paths != nullptr)
+    {
+        paths->clear();
+        paths->resize(sources.size() * columns);
+    }
+    
+    atomic<size_t> nextSource(0);
+    auto work = [&]()
+    {
+        SearchWorkspace& ws = threadWorkspace(0);
+        IndexedHeap& heap = ws.heap();
+        for (size_t i = nextSource++; i < sources.size(); i = nextSource++)
         {
-            GeoCoord possible_geo = (*p).end;
-            if (!closed_list.find(possible_geo)) // check if already in closed list
+            unsigned int source = sources[i];
+            unsigned int targetsLeft = targetsIn[graph.component[source]];
+            ws.start(graph.nodeCount);
+            ws.reach(source, 0, SearchWorkspace::NONE);
+            heap.pushOrDecrease(source, 0);
+            while (!heap.empty()  &&  targetsLeft > 0)
             {
-                // calculate f-value
-                double g = distanceEarthMiles(possible_geo,end);
-                double f = g + current_f;
-                // check if already in open list (change f-value and parent if f-value is less)
-                bool no_change = false;
-                for (auto p = open_list.begin(); p != open_list.end(); p++)
+                unsigned int current = heap.pop();
+                if (isTarget[current])
+                    targetsLeft--;
+                StreetEdgeRange edges = graph.edgesFrom(current);
+                for (auto e = edges.begin(); e != edges.end(); e++)
                 {
-                    if (possible_geo == (*p).second.second)
+                    unsigned int next = (*e).end;
+                    double d = ws.distance(current) + (*e).length;
+                    if (d < ws.distance(next))
                     {
-                        if (f < (*p).first)
-                        {
-                            open_list.erase(p);
-                            break;
-                        }
-                        else
-                        {
-                            no_change = true;
-                            break;
-                        }
+                        ws.reach(next, d, current, e - graph.edges);
+                        heap.pushOrDecrease(next, d);
                     }
                 }
-                if (!no_change)
-                {
-                open_list.insert(make_pair(f,make_pair((*p).start,(*p).end)));
-                }
             }
             
+            // every target is now settled or out of reach
+            for (size_t j = 0; j < columns; j++)
+            {
+                unsigned int target = targets[j];
+                distances[i * columns + j] = ws.distance(target);
+                if (paths == nullptr  ||  !ws.reached(target))
+                    continue;
+                CompactRoute& path = (*paths)[i * columns + j];
+                path.length = ws.distance(target);
+                for (unsigned int n = target; n != source; n = ws.parent(n))
+                    path.edges.push_back(ws.parentEdge(n));
+                reverse(path.edges.begin(), path.edges.end());
+            }
         }
-    }
-    /*
-     First: create an "open list" to store potential values (make a list of pairs of geocoords and f-values),
-     Second: create a pair for the starting point, and assign f-value of 0; make this equal to "previous geocoord"
-     third: loop while the open list is empty
-     fourth: pop off the first item on the list (highest priority), make this one the parent point now (keep its f-value as well), add this to the expandable hash map,check if this is the destination
-     fifth: find all valid street segments from that point and add to the priority queue with their f-value (probably need a for loop), as well as their parent geocoord; if already in priority queue, then change its f-value and parent point (assuming f-value is less)
-     sixth: pair of geocoords
-     
-     reconstruct the route using the map points
-     
-     */
+    };
     
-    return DELIVERY_SUCCESS; // route could not be found
+    size_t threadCount = min<size_t>(thread::hardware_concurrency(), sources.size() / SOURCES_PER_THREAD);
+    vector<thread> helpers;
+    for (size_t t = 1; t < threadCount; t++)
+        helpers.push_back(thread(work));
+    work();
+    for (size_t t = 0; t < helpers.size(); t++)
+        helpers[t].join();
+    
+    for (size_t j = 0; j < targets.size(); j++)
+    {
+        isTarget[targets[j]] = false;
+        targetsIn[graph.component[targets[j]]] = 0;
+    }
+    return DELIVERY_SUCCESS;
 }
 
 //******************** PointToPointRouter functions ***************************
@@ -160,7 +474,12 @@ DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
 
 PointToPointRouter::PointToPointRouter(const StreetMap* sm)
 {
-    m_impl = new PointToPointRouterImpl(sm);
+    m_impl = new PointToPointRouterImpl(sm, RouterOptions());
+}
+
+PointToPointRouter::PointToPointRouter(const StreetMap* sm, const RouterOptions& options)
+{
+    m_impl = new PointToPointRouterImpl(sm, options);
 }
 
 PointToPointRouter::~PointToPointRouter()
@@ -176,3 +495,34 @@ DeliveryResult PointToPointRouter::generatePointToPointRoute(
 {
     return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled);
 }
+
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+        unsigned int startNode,
+        unsigned int endNode,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled) const
+{
+    return m_impl->generatePointToPointRoute(startNode, endNode, route, totalDistanceTravelled);
+}
+
+DeliveryResult PointToPointRouter::computeDistanceMatrix(
+        const vector<unsigned int>& sources,
+        const vector<unsigned int>& targets,
+        vector<double>& distances,
+        vector<CompactRoute>* paths) const
+{
+    return m_impl->computeDistanceMatrix(sources, targets, distances, paths);
+}
+
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+        unsigned int startNode,
+        unsigned int endNode,
+        CompactRoute& route) const
+{
+    return m_impl->generatePointToPointRoute(startNode, endNode, route);
+}
+
+unsigned int PointToPointRouter::nodesSettled() const
+{
+    return m_impl->nodesSettled();
+}
@@ -0,0 +1,266 @@
+#include "provided.h"
+#include "ExpandableHashMap.h"
+#include <vector>
+#include <mutex>
+using namespace std;
+
+unsigned int hasher(const unsigned long long& k);   // in StreetMap.cpp
+
+// The cache is split into shards, each with its own lock, so threads looking
+// up different routes rarely wait for each other.  A shard finds its entries
+// through an open-addressed table keyed on the start and end nodes packed
+// into 64 bits, and keeps them on a doubly-linked list from most to least
+// recently used.  The entries live in one vector and the list links are
+// indexes into it, so a full shard reuses its least recently used entry (and
+// that route's storage) in place.
+
+namespace
+{
+    const unsigned int NO_ENTRY = 0xffffffff;
+
+    struct CacheEntry
+    {
+        unsigned long long key;
+        unsigned int generation;
+        unsigned int newer;     // neighbours in the recently used list
+        unsigned int older;
+        CompactRoute route;
+    };
+
+    struct CacheShard
+    {
+        CacheShard()
+         : newest(NO_ENTRY), oldest(NO_ENTRY), hits(0), misses(0), evictions(0)
+        {}
+
+        mutex lock;
+        ExpandableHashMap<unsigned long long,unsigned int,OpenAddressing> index;
+        vector<CacheEntry> entries;
+        vector<unsigned int> unused;    // entries dropped as stale, ready for reuse
+        unsigned int newest;
+        unsigned int oldest;
+        unsigned long long hits;
+        unsigned long long misses;
+        unsigned long long evictions;
+
+        void unlink(unsigned int e);
+        void pushNewest(unsigned int e);
+    };
+
+    void CacheShard::unlink(unsigned int e)
+    {
+        CacheEntry& entry = entries[e];
+        if (entry.newer != NO_ENTRY)
+            entries[entry.newer].older = entry.older;
+        else
+            newest = entry.older;
+        if (entry.older != NO_ENTRY)
+            entries[entry.older].newer = entry.newer;
+        else
+            oldest = entry.newer;
+    }
+
+    void CacheShard::pushNewest(unsigned int e)
+    {
+        CacheEntry& entry = entries[e];
+        entry.newer = NO_ENTRY;
+        entry.older = newest;
+        if (newest != NO_ENTRY)
+            entries[newest].newer = e;
+        newest = e;
+        if (oldest == NO_ENTRY)
+            oldest = e;
+    }
+
+    unsigned long long routeKey(unsigned int startNode, unsigned int endNode)
+    {
+        return (static_cast<unsigned long long>(startNode) << 32) | endNode;
+    }
+}
+
+class RouteCacheImpl
+{
+public:
+    RouteCacheImpl(unsigned int capacity, unsigned int shards);
+    ~RouteCacheImpl();
+    bool find(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, CompactRoute& route);
+    void insert(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, const CompactRoute& route);
+    void invalidate();
+    unsigned int size() const;
+    unsigned long long hits() const { return total(&CacheShard::hits); }
+    unsigned long long misses() const { return total(&CacheShard::misses); }
+    unsigned long long evictions() const { return total(&CacheShard::evictions); }
+private:
+    CacheShard* m_shards;
+    unsigned int m_shardCount;
+    unsigned int m_shardCapacity;
+
+    CacheShard& shardFor(unsigned long long key) const { return m_shards[hasher(key) % m_shardCount]; }
+    unsigned long long total(unsigned long long CacheShard::*counter) const;
+};
+
+RouteCacheImpl::RouteCacheImpl(unsigned int capacity, unsigned int shards)
+{
+    m_shardCount = shards == 0 ? 1 : shards;
+    m_shardCapacity = (capacity + m_shardCount - 1) / m_shardCount;
+    if (m_shardCapacity == 0)
+        m_shardCapacity = 1;
+    m_shards = new CacheShard[m_shardCount];
+}
+
+RouteCacheImpl::~RouteCacheImpl()
+{
+    delete [] m_shards;
+}
+
+bool RouteCacheImpl::find(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, CompactRoute& route)
+{
+    unsigned long long key = routeKey(startNode, endNode);
+    CacheShard& shard = shardFor(key);
+    lock_guard<mutex> guard(shard.lock);
+    const unsigned int* e = shard.index.find(key);
+    if (e == nullptr)
+    {
+        shard.misses++;
+        return false;
+    }
+    unsigned int entry = *e;
+    shard.unlink(entry);
+    if (shard.entries[entry].generation != mapGeneration)
+    {
+        // a route on a map that has been reloaded since
+        shard.index.erase(key);
+        shard.unused.push_back(entry);
+        shard.evictions++;
+        shard.misses++;
+        return false;
+    }
+    shard.pushNewest(entry);
+    shard.hits++;
+    route = shard.entries[entry].route;
+    return true;
+}
+
+void RouteCacheImpl::insert(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, const CompactRoute& route)
+{
+    unsigned long long key = routeKey(startNode, endNode);
+    CacheShard& shard = shardFor(key);
+    lock_guard<mutex> guard(shard.lock);
+    unsigned int entry;
+    const unsigned int* e = shard.index.find(key);
+    if (e != nullptr)
+    {
+        entry = *e;
+        shard.unlink(entry);
+    }
+    else if (!shard.unused.empty())
+    {
+        entry = shard.unused.back();
+        shard.unused.pop_back();
+    }
+    else if (shard.entries.size() < m_shardCapacity)
+    {
+        entry = shard.entries.size();
+        shard.entries.push_back(CacheEntry());
+    }
+    else
+    {
+        entry = shard.oldest;
+        shard.unlink(entry);
+        shard.index.erase(shard.entries[entry].key);
+        shard.evictions++;
+    }
+    if (e == nullptr)
+        shard.index.associate(key, entry);
+    CacheEntry& c = shard.entries[entry];
+    c.key = key;
+    c.generation = mapGeneration;
+    c.route.edges.assign(route.edges.begin(), route.edges.end());
+    c.route.length = route.length;
+    shard.pushNewest(entry);
+}
+
+void RouteCacheImpl::invalidate()
+{
+    for (unsigned int i = 0; i < m_shardCount; i++)
+    {
+        CacheShard& shard = m_shards[i];
+        lock_guard<mutex> guard(shard.lock);
+        shard.index.reset();
+        shard.entries.clear();
+        shard.unused.clear();
+        shard.newest = shard.oldest = NO_ENTRY;
+    }
+}
+
+unsigned int RouteCacheImpl::size() const
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < m_shardCount; i++)
+    {
+        lock_guard<mutex> guard(m_shards[i].lock);
+        n += m_shards[i].index.size();
+    }
+    return n;
+}
+
+unsigned long long RouteCacheImpl::total(unsigned long long CacheShard::*counter) const
+{
+    unsigned long long n = 0;
+    for (unsigned int i = 0; i < m_shardCount; i++)
+    {
+        lock_guard<mutex> guard(m_shards[i].lock);
+        n += m_shards[i].*counter;
+    }
+    return n;
+}
+
+//******************** RouteCache functions ***********************************
+
+// These functions simply delegate to RouteCacheImpl's functions.
+// You probably don't want to change any of this code.
+
+RouteCache::RouteCache(unsigned int capacity, unsigned int shards)
+{
+    m_impl = new RouteCacheImpl(capacity, shards);
+}
+
+RouteCache::~RouteCache()
+{
+    delete m_impl;
+}
+
+bool RouteCache::find(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, CompactRoute& route)
+{
+    return m_impl->find(startNode, endNode, mapGeneration, route);
+}
+
+void RouteCache::insert(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, const CompactRoute& route)
+{
+    m_impl->insert(startNode, endNode, mapGeneration, route);
+}
+
+void RouteCache::invalidate()
+{
+    m_impl->invalidate();
+}
+
+unsigned int RouteCache::size() const
+{
+    return m_impl->size();
+}
+
+unsigned long long RouteCache::hits() const
+{
+    return m_impl->hits();
+}
+
+unsigned long long RouteCache::misses() const
+{
+    return m_impl->misses();
+}
+
+unsigned long long RouteCache::evictions() const
+{
+    return m_impl->evictions();
+}
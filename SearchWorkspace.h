@@ -0,0 +1,80 @@
+// SearchWorkspace.h
+
+// Scratch space for a search over a StreetMap's graph, meant to be kept and
+// reused from one search to the next.  Each node's distance and parent sit
+// in flat arrays indexed by node id, along with the number of the search that
+// last reached it; a node whose number isn't the current search's hasn't been
+// reached yet.  So starting a search only bumps the number and empties the
+// heap (which keeps its storage), and once the arrays have grown to fit the
+// graph a search allocates nothing at all.
+
+#ifndef SEARCHWORKSPACE_INCLUDED
+#define SEARCHWORKSPACE_INCLUDED
+
+#include "IndexedHeap.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+class SearchWorkspace
+{
+public:
+    static const unsigned int NONE = 0xffffffff;
+
+    SearchWorkspace() : m_search(0) {}
+
+      // begin a new search over a graph with nodeCount nodes
+    void start(unsigned int nodeCount)
+    {
+        if (m_reachedBy.size() != nodeCount)
+        {
+            m_reachedBy.assign(nodeCount, 0);
+            m_distance.resize(nodeCount);
+            m_parent.resize(nodeCount);
+            m_parentEdge.resize(nodeCount);
+            m_heap.resize(nodeCount);
+            m_search = 0;
+        }
+        else
+            m_heap.clear();
+        if (++m_search == 0)
+        {
+            // the counter wrapped around, so old marks could look current
+            std::fill(m_reachedBy.begin(), m_reachedBy.end(), 0);
+            m_search = 1;
+        }
+    }
+
+    bool reached(unsigned int node) const { return m_reachedBy[node] == m_search; }
+
+    double distance(unsigned int node) const
+    {
+        return reached(node) ? m_distance[node] : std::numeric_limits<double>::infinity();
+    }
+
+      // the node before node on the best route found to it, and the edge
+      // from there, or NONE for the search's source (or if not recorded)
+    unsigned int parent(unsigned int node) const { return m_parent[node]; }
+    unsigned int parentEdge(unsigned int node) const { return m_parentEdge[node]; }
+
+      // record a (better) route to node
+    void reach(unsigned int node, double distance, unsigned int parent, unsigned int parentEdge = NONE)
+    {
+        m_reachedBy[node] = m_search;
+        m_distance[node] = distance;
+        m_parent[node] = parent;
+        m_parentEdge[node] = parentEdge;
+    }
+
+    IndexedHeap& heap() { return m_heap; }
+
+private:
+    unsigned int m_search;                  // number of the current search
+    std::vector<unsigned int> m_reachedBy;  // number of the search that last reached each node
+    std::vector<double> m_distance;
+    std::vector<unsigned int> m_parent;
+    std::vector<unsigned int> m_parentEdge;
+    IndexedHeap m_heap;
+};
+
+#endif // SEARCHWORKSPACE_INCLUDED
@@ -0,0 +1,254 @@
+// SpatialGrid.h
+
+// A uniform grid over a StreetGraph's nodes and segments, for finding the
+// ones nearest a point.  Coordinates are projected onto a flat plane, in
+// meters, scaled for the map's middle latitude; over a city-sized map that is
+// within about a tenth of a percent of the distance on the Earth.  The plane
+// is cut into square cells sized so an average cell holds a couple of nodes,
+// and each cell lists the nodes in it and the segments crossing it.  A query
+// visits the cells in rings around the point's own cell, stopping once a ring
+// is too far away to hold anything nearer than the best found so far (or
+// than the search radius).
+
+#ifndef SPATIALGRID_INCLUDED
+#define SPATIALGRID_INCLUDED
+
+#include "provided.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+class SpatialGrid
+{
+public:
+    SpatialGrid() : m_columns(0), m_rows(0) {}
+
+      // index graph, whose arrays must outlive the grid's use
+    void build(const StreetGraph& graph)
+    {
+        clear();
+        m_graph = graph;
+        if (graph.nodeCount == 0)
+            return;
+
+        double minLat = graph.latitude[0], maxLat = minLat;
+        double minLon = graph.longitude[0], maxLon = minLon;
+        for (unsigned int n = 1; n < graph.nodeCount; n++)
+        {
+            minLat = std::min(minLat, graph.latitude[n]);
+            maxLat = std::max(maxLat, graph.latitude[n]);
+            minLon = std::min(minLon, graph.longitude[n]);
+            maxLon = std::max(maxLon, graph.longitude[n]);
+        }
+        m_originLat = minLat;
+        m_originLon = minLon;
+        m_metersPerLat = deg2rad(1) * EARTH_RADIUS_METERS;
+        m_metersPerLon = m_metersPerLat * std::cos(deg2rad((minLat + maxLat) / 2));
+        double width = (maxLon - minLon) * m_metersPerLon;
+        double height = (maxLat - minLat) * m_metersPerLat;
+        m_cellSize = std::max(std::sqrt(width * height * 2 / graph.nodeCount), 1.0);
+        m_columns = static_cast<unsigned int>(width / m_cellSize) + 1;
+        m_rows = static_cast<unsigned int>(height / m_cellSize) + 1;
+
+        std::vector<std::pair<unsigned int,unsigned int>> nodes;   // (cell, node)
+        for (unsigned int n = 0; n < graph.nodeCount; n++)
+            nodes.push_back(std::make_pair(cellOf(x(n), y(n)), n));
+        group(nodes, m_nodeFirst, m_nodes);
+
+        // Each segment (taking one direction of each) goes in every cell it
+        // crosses: those whose middle is within half a diagonal of it.
+        std::vector<std::pair<unsigned int,Segment>> segments;
+        double reach = m_cellSize * std::sqrt(0.5);
+        for (unsigned int n = 0; n < graph.nodeCount; n++)
+        {
+            for (unsigned int e = graph.firstEdge[n]; e < graph.firstEdge[n+1]; e++)
+            {
+                unsigned int m = graph.edges[e].end;
+                if (m <= n)
+                    continue;
+                unsigned int first = cellOf(std::min(x(n), x(m)), std::min(y(n), y(m)));
+                unsigned int last = cellOf(std::max(x(n), x(m)), std::max(y(n), y(m)));
+                for (unsigned int row = first / m_columns; row <= last / m_columns; row++)
+                {
+                    for (unsigned int column = first % m_columns; column <= last % m_columns; column++)
+                    {
+                        double t;
+                        if (pointToSegment((column + 0.5) * m_cellSize, (row + 0.5) * m_cellSize, n, m, t) <= reach)
+                        {
+                            Segment s = { n, e };
+                            segments.push_back(std::make_pair(row * m_columns + column, s));
+                        }
+                    }
+                }
+            }
+        }
+        group(segments, m_segmentFirst, m_segments);
+    }
+
+    void clear()
+    {
+        m_columns = m_rows = 0;
+        m_nodeFirst.clear();
+        m_nodes.clear();
+        m_segmentFirst.clear();
+        m_segments.clear();
+    }
+
+      // the node nearest (lat, lon) no more than radius meters away, and its
+      // distance; false if there's none
+    bool nearestNode(double lat, double lon, double radius, unsigned int& node, double& distance) const
+    {
+        double px = (lon - m_originLon) * m_metersPerLon;
+        double py = (lat - m_originLat) * m_metersPerLat;
+        bool found = false;
+        distance = radius;
+        search(px, py, distance, [&](unsigned int cell)
+        {
+            for (unsigned int i = m_nodeFirst[cell]; i < m_nodeFirst[cell+1]; i++)
+            {
+                unsigned int n = m_nodes[i];
+                double dx = x(n) - px, dy = y(n) - py;
+                double d = std::sqrt(dx * dx + dy * dy);
+                if (d < distance  ||  (!found  &&  d <= distance))
+                {
+                    node = n;
+                    distance = d;
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+
+      // the point nearest (lat, lon) on any segment, no more than radius
+      // meters away: the edge it's on, that edge's start node, how far
+      // along the edge it lies (from 0 at fromNode to 1 at the far end), and
+      // its distance; false if there's none
+    bool nearestSegment(double lat, double lon, double radius, unsigned int& fromNode, unsigned int& edge,
+                        double& fraction, double& distance) const
+    {
+        double px = (lon - m_originLon) * m_metersPerLon;
+        double py = (lat - m_originLat) * m_metersPerLat;
+        bool found = false;
+        distance = radius;
+        search(px, py, distance, [&](unsigned int cell)
+        {
+            for (unsigned int i = m_segmentFirst[cell]; i < m_segmentFirst[cell+1]; i++)
+            {
+                const Segment& s = m_segments[i];
+                double t;
+                double d = pointToSegment(px, py, s.from, m_graph.edges[s.edge].end, t);
+                if (d < distance  ||  (!found  &&  d <= distance))
+                {
+                    fromNode = s.from;
+                    edge = s.edge;
+                    fraction = t;
+                    distance = d;
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+
+private:
+    static constexpr double EARTH_RADIUS_METERS = 6371000;   // as distanceEarthKM has it
+
+    struct Segment
+    {
+        unsigned int from;
+        unsigned int edge;      // index into the graph's edges
+    };
+
+    StreetGraph m_graph;
+    double m_originLat;         // the grid's southwest corner
+    double m_originLon;
+    double m_metersPerLat;
+    double m_metersPerLon;
+    double m_cellSize;          // in meters
+    unsigned int m_columns;
+    unsigned int m_rows;
+    std::vector<unsigned int> m_nodeFirst;      // cell c's nodes are m_nodes[m_nodeFirst[c] .. m_nodeFirst[c+1])
+    std::vector<unsigned int> m_nodes;
+    std::vector<unsigned int> m_segmentFirst;   // likewise
+    std::vector<Segment> m_segments;
+
+    double x(unsigned int node) const { return (m_graph.longitude[node] - m_originLon) * m_metersPerLon; }
+    double y(unsigned int node) const { return (m_graph.latitude[node] - m_originLat) * m_metersPerLat; }
+
+    unsigned int cellOf(double px, double py) const
+    {
+        unsigned int column = std::min(static_cast<unsigned int>(px / m_cellSize), m_columns - 1);
+        unsigned int row = std::min(static_cast<unsigned int>(py / m_cellSize), m_rows - 1);
+        return row * m_columns + column;
+    }
+
+      // distance from (px, py) to the segment from node a to node b, and in
+      // t how far along it the nearest point lies
+    double pointToSegment(double px, double py, unsigned int a, unsigned int b, double& t) const
+    {
+        double ax = x(a), ay = y(a);
+        double dx = x(b) - ax, dy = y(b) - ay;
+        double length2 = dx * dx + dy * dy;
+        t = length2 > 0 ? ((px - ax) * dx + (py - ay) * dy) / length2 : 0;
+        t = std::max(0.0, std::min(1.0, t));
+        double ex = ax + t * dx - px, ey = ay + t * dy - py;
+        return std::sqrt(ex * ex + ey * ey);
+    }
+
+      // sort (cell, item) pairs into per-cell lists
+    template <typename Item>
+    void group(const std::vector<std::pair<unsigned int,Item>>& items,
+               std::vector<unsigned int>& first, std::vector<Item>& list) const
+    {
+        first.assign(size_t(m_columns) * m_rows + 1, 0);
+        for (size_t i = 0; i < items.size(); i++)
+            first[items[i].first + 1]++;
+        for (size_t c = 1; c < first.size(); c++)
+            first[c] += first[c-1];
+        std::vector<unsigned int> next(first.begin(), first.end() - 1);
+        list.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+            list[next[items[i].first]++] = items[i].second;
+    }
+
+      // Call visit on the grid's cells in rings of growing distance around
+      // (px, py), while a ring might hold something within limit meters;
+      // visit may lower limit as it goes.  Everything in ring k is at least
+      // k - 1 cells away.
+    template <typename Visit>
+    void search(double px, double py, const double& limit, Visit visit) const
+    {
+        if (m_columns == 0)
+            return;
+        long cx = static_cast<long>(std::floor(px / m_cellSize));
+        long cy = static_cast<long>(std::floor(py / m_cellSize));
+        long lastRing = std::max(std::max(cx, long(m_columns) - 1 - cx), std::max(cy, long(m_rows) - 1 - cy));
+        for (long k = std::max(0L, std::max(std::max(-cx, cx - long(m_columns) + 1),
+                                            std::max(-cy, cy - long(m_rows) + 1)));
+             k <= lastRing; k++)
+        {
+            if (k > 0  &&  (k - 1) * m_cellSize > limit)
+                break;
+            // the ring's top and bottom rows, then the rest of its sides
+            long left = std::max(cx - k, 0L), right = std::min(cx + k, long(m_columns) - 1);
+            long bottom = std::max(cy - k + 1, 0L), top = std::min(cy + k - 1, long(m_rows) - 1);
+            for (long row = cy - k; row <= cy + k; row += (k > 0 ? 2 * k : 1))
+            {
+                if (row < 0  ||  row >= long(m_rows))
+                    continue;
+                for (long column = left; column <= right; column++)
+                    visit(static_cast<unsigned int>(row * m_columns + column));
+            }
+            for (long column = cx - k; k > 0  &&  column <= cx + k; column += 2 * k)
+            {
+                if (column < 0  ||  column >= long(m_columns))
+                    continue;
+                for (long row = bottom; row <= top; row++)
+                    visit(static_cast<unsigned int>(row * m_columns + column));
+            }
+        }
+    }
+};
+
+#endif // SPATIALGRID_INCLUDED
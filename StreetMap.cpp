@@ -1,16 +1,275 @@
 #include "provided.h"
 #include "ExpandableHashMap.h"
+#include "MappedFile.h"
+#include "SpatialGrid.h"
 #include <string>
 #include <vector>
 #include <functional>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <cmath>
 #include <iostream> // needed for any I/O
 #include <fstream>  // needed in addition to <iostream> for file I/O
 #include <sstream>  // needed in addition to <iostream> for string stream I/O
 using namespace std;
 
+// Inside the map a coordinate is a packed 64-bit key: latitude and longitude
+// in units of 1e-7 degree (about a centimeter) as two 32-bit integers.  The
+// map data gives every coordinate to 7 decimal places, and for such text two
+// coordinates have the same key exactly when their text is the same; keys
+// are far cheaper to hash and compare than strings.  Coordinates written
+// otherwise (with more digits, or trailing zeros, as "34.0547" and
+// "34.0547000") that round to the same key are one node, the first one's
+// text kept; loading reports each such merge.
+static unsigned long long coordKey(double latitude, double longitude)
+{
+    uint32_t lat = static_cast<uint32_t>(static_cast<int32_t>(llround(latitude * 1e7)));
+    uint32_t lon = static_cast<uint32_t>(static_cast<int32_t>(llround(longitude * 1e7)));
+    return (static_cast<unsigned long long>(lat) << 32) | lon;
+}
+
+static unsigned long long coordKey(const GeoCoord& g)
+{
+    return coordKey(g.latitude, g.longitude);
+}
+
+unsigned int hasher(const unsigned long long& k)
+{
+    // the mixing step of splitmix64, folded to 32 bits
+    unsigned long long h = k;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<unsigned int>(h ^ (h >> 31));
+}
+
 unsigned int hasher(const GeoCoord& g)
 {
-    return std::hash<string>()(g.latitudeText + g.longitudeText);
+    return hasher(coordKey(g));
+}
+
+unsigned int hasher(const string& s)
+{
+    return std::hash<string>()(s);
+}
+
+// Layout of a compiled map snapshot.  The file starts with a SnapshotHeader,
+// followed by these sections, each padded to an 8-byte boundary:
+//
+//   double     latitude[nodeCount], longitude[nodeCount], cosLatitude[nodeCount]
+//   uint64_t   key[nodeCount]            see coordKey
+//   uint32_t   firstEdge[nodeCount + 1]
+//   StreetEdge edges[edgeCount]
+//   float      angle[edgeCount]
+//   uint32_t   coordTextOffset[2 * nodeCount + 1]   node n's latitude text is
+//                                                   string 2n, longitude 2n+1
+//   uint32_t   nameOffset[nameCount + 1]
+//   uint32_t   slots[slotCount]      open-addressed key lookup, node id + 1 (0 = empty)
+//   char       coordText[coordTextBytes]
+//   char       names[nameBytes]
+//
+// These are exactly the arrays StreetMapImpl works from, so a loaded snapshot
+// is used in place.  The checksum covers every byte after the header.
+// Snapshots are written in the machine's byte order; byteOrder lets a reader
+// on another machine refuse.
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[8] = { 'G', 'O', 'O', 'B', 'M', 'A', 'P', '\0' };
+    const uint32_t SNAPSHOT_VERSION = 5;
+    const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+    struct SnapshotHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t nodeCount;
+        uint32_t edgeCount;
+        uint32_t nameCount;
+        uint32_t slotCount;
+        uint64_t coordTextBytes;
+        uint64_t nameBytes;
+        uint64_t checksum;
+    };
+
+    static_assert(sizeof(unsigned int) == sizeof(uint32_t), "node ids are stored as 32 bits");
+    static_assert(sizeof(StreetEdge) == 16, "snapshots store StreetEdges directly");
+    static_assert(sizeof(float) == 4, "edge angles are stored as 32 bits");
+    static_assert(sizeof(unsigned long long) == sizeof(uint64_t), "coordinate keys are stored as 64 bits");
+
+    uint64_t fnv1a(const char* p, size_t n, uint64_t h = 14695981039346656037ULL)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            h ^= static_cast<unsigned char>(p[i]);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    size_t padTo8(size_t n)
+    {
+        return (n + 7) & ~size_t(7);
+    }
+
+    // Pieces of a map data file, as found by StreetMapImpl::load.  Everything
+    // points into the file's buffer; nothing is copied until the map is built.
+    struct MapStreet
+    {
+        const char* name;
+        size_t nameLength;
+        size_t firstLine;   // index of the street's first coordinate line
+    };
+
+    struct MapLine
+    {
+        const char* begin;
+        const char* end;
+        unsigned int number;
+        size_t street;
+    };
+
+    struct MapProblem
+    {
+        MapProblem(unsigned int l, const char* m) : line(l), message(m) {}
+        unsigned int line;
+        const char* message;
+        bool operator<(const MapProblem& other) const { return line < other.line; }
+    };
+
+    struct MapParsedSegment
+    {
+        MapParsedSegment() : valid(false) {}
+        const char* text[4];    // start lat, start lon, end lat, end lon
+        size_t length[4];
+        double value[4];
+        bool valid;
+    };
+
+    // the characters istream's >> treats as separators
+    inline bool isSpace(char c)
+    {
+        return c == ' '  ||  (c >= '\t'  &&  c <= '\r');
+    }
+
+    // Count the whitespace-separated tokens in [p, end), stopping at limit.
+    int countTokens(const char* p, const char* end, int limit)
+    {
+        int n = 0;
+        while (n < limit)
+        {
+            while (p != end  &&  isSpace(*p))
+                p++;
+            if (p == end)
+                break;
+            n++;
+            while (p != end  &&  !isSpace(*p))
+                p++;
+        }
+        return n;
+    }
+
+    // Read a count the way "iss >> amt" does: leading whitespace, an optional
+    // sign, then digits, ignoring anything after them.  On failure amt is 0.
+    bool parseCount(const char* p, const char* end, int& amt)
+    {
+        amt = 0;
+        while (p != end  &&  isSpace(*p))
+            p++;
+        bool negative = false;
+        if (p != end  &&  (*p == '-'  ||  *p == '+'))
+            negative = (*p++ == '-');
+        if (p == end  ||  *p < '0'  ||  *p > '9')
+            return false;
+        long long n = 0;
+        while (p != end  &&  *p >= '0'  &&  *p <= '9'  &&  n <= INT_MAX)
+            n = n * 10 + (*p++ - '0');
+        if (n > INT_MAX)
+            return false;
+        amt = static_cast<int>(negative ? -n : n);
+        return true;
+    }
+
+    // Convert a token to a double, giving the same result as std::stod.
+    // Tokens of the form [sign]digits[.digits] with at most 15 significant
+    // digits are converted exactly by one division (both operands are exact
+    // doubles, so the quotient is correctly rounded, as strtod's is).
+    // Anything else is handed to strtod.
+    bool parseCoordinate(const char* p, size_t n, double& value)
+    {
+        static const double powersOf10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        const char* q = p;
+        const char* end = p + n;
+        bool negative = false;
+        if (q != end  &&  (*q == '-'  ||  *q == '+'))
+            negative = (*q++ == '-');
+        unsigned long long mantissa = 0;
+        int digits = 0;
+        int fractionDigits = 0;
+        bool sawPoint = false;
+        for ( ; q != end; q++)
+        {
+            if (*q >= '0'  &&  *q <= '9')
+            {
+                mantissa = mantissa * 10 + (*q - '0');
+                if (mantissa != 0)
+                    digits++;
+                if (sawPoint)
+                    fractionDigits++;
+            }
+            else if (*q == '.'  &&  !sawPoint)
+                sawPoint = true;
+            else
+                break;
+        }
+        if (q == end  &&  digits <= 15  &&  fractionDigits <= 22  &&  q - p > (negative || *p == '+') + sawPoint)
+        {
+            value = static_cast<double>(mantissa) / powersOf10[fractionDigits];
+            if (negative)
+                value = -value;
+            return true;
+        }
+        
+        // slow path: exponents, hex, inf/nan, long mantissas, trailing junk
+        char buffer[64];
+        if (n >= sizeof(buffer))
+            return false;
+        memcpy(buffer, p, n);
+        buffer[n] = '\0';
+        char* stop;
+        errno = 0;
+        value = strtod(buffer, &stop);
+        return stop != buffer  &&  errno != ERANGE;
+    }
+
+    // Split a coordinate line into its first four tokens and convert them.
+    bool parseSegmentLine(const MapLine& line, MapParsedSegment& seg)
+    {
+        const char* p = line.begin;
+        for (int k = 0; k < 4; k++)
+        {
+            while (p != line.end  &&  isSpace(*p))
+                p++;
+            const char* tokenStart = p;
+            while (p != line.end  &&  !isSpace(*p))
+                p++;
+            seg.text[k] = tokenStart;
+            seg.length[k] = p - tokenStart;
+            if (!parseCoordinate(tokenStart, p - tokenStart, seg.value[k]))
+                return false;
+        }
+        seg.valid = true;
+        return true;
+    }
 }
 
 class StreetMapImpl
@@ -19,105 +278,579 @@ public:
     StreetMapImpl();
     ~StreetMapImpl();
     bool load(string mapFile);
+    bool loadSnapshot(string snapshotFile);
+    bool saveSnapshot(string snapshotFile) const;
     bool getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const;
+    StreetEdgeRange segmentsThatStartWith(const GeoCoord& gc) const;
+    const StreetGraph& graph() const { return m_graph; }
+    unsigned int generation() const { return m_generation; }
+    bool findNode(const GeoCoord& gc, unsigned int& node) const;
+    bool nearestNode(const GeoCoord& gc, double radiusMeters, unsigned int& node) const
+    {
+        double distance;
+        return m_grid.nearestNode(gc.latitude, gc.longitude, radiusMeters, node, distance);
+    }
+    bool nearestSegment(const GeoCoord& gc, double radiusMeters, SegmentSnap& snap) const;
+    void coordOf(unsigned int node, GeoCoord& gc) const;
+    void streetName(unsigned int name, string& s) const
+    {
+        s.assign(m_names + m_nameOffset[name], m_nameOffset[name+1] - m_nameOffset[name]);
+    }
     
 private:
-    ExpandableHashMap<GeoCoord,vector<StreetSegment>>* m_hashmap;// add in hash table
-    // add in reverse function
+    // The map as a graph.  These point either into the vectors below (for a
+    // map loaded from text) or into m_snapshot.
+    StreetGraph m_graph;
+    const unsigned int* m_coordTextOffset;
+    const char* m_coordText;
+    unsigned int m_nameCount;
+    const unsigned int* m_nameOffset;
+    const char* m_names;
+    const unsigned long long* m_keys;
+    unsigned int m_slotCount;       // snapshot lookup table; 0 for a text map
+    const unsigned int* m_slots;
+    
+    // storage for a map loaded from text
+    ExpandableHashMap<unsigned long long,unsigned int,OpenAddressing>* m_nodeIds;
+    vector<unsigned long long> m_keyStore;
+    vector<double> m_latitudeStore;
+    vector<double> m_longitudeStore;
+    vector<double> m_cosLatitudeStore;
+    vector<unsigned int> m_firstEdgeStore;
+    vector<StreetEdge> m_edgeStore;
+    vector<float> m_angleStore;
+    vector<unsigned int> m_coordTextOffsetStore;
+    string m_coordTextStore;
+    vector<unsigned int> m_nameOffsetStore;
+    string m_nameStore;
+    
+    MappedFile m_snapshot;
+    
+    // worked out from whichever of the above is in use when it's loaded
+    vector<unsigned int> m_componentStore;
+    SpatialGrid m_grid;
+    
+    unsigned int m_generation;      // changes whenever the map's contents do
+    
+    void clear();
+    void labelComponents();
+    unsigned int addNode(const MapParsedSegment& seg, int which, bool& merged);
+    void coordText(unsigned int node, int which, const char*& text, size_t& length) const
+    {
+        unsigned int k = 2 * node + which;
+        text = m_coordText + m_coordTextOffset[k];
+        length = m_coordTextOffset[k+1] - m_coordTextOffset[k];
+    }
 };
 
 StreetMapImpl::StreetMapImpl()
 {
-    m_hashmap = new ExpandableHashMap<GeoCoord,vector<StreetSegment>>;
+    m_nodeIds = new ExpandableHashMap<unsigned long long,unsigned int,OpenAddressing>;
+    clear();
 }
 
 StreetMapImpl::~StreetMapImpl()
 {
-    delete m_hashmap;
+    delete m_nodeIds;
+}
+
+void StreetMapImpl::clear()
+{
+    // generations are unique across all maps, so a route cached for one map
+    // can never be mistaken for a route on another
+    static atomic<unsigned int> nextGeneration(1);
+    m_generation = nextGeneration++;
+    
+    m_snapshot.close();
+    m_componentStore.clear();
+    m_grid.clear();
+    m_nodeIds->reset();
+    m_keyStore.clear();
+    m_latitudeStore.clear();
+    m_longitudeStore.clear();
+    m_cosLatitudeStore.clear();
+    m_firstEdgeStore.assign(1, 0);
+    m_edgeStore.clear();
+    m_angleStore.clear();
+    m_coordTextOffsetStore.assign(1, 0);
+    m_coordTextStore.clear();
+    m_nameOffsetStore.assign(1, 0);
+    m_nameStore.clear();
+    
+    m_graph.nodeCount = 0;
+    m_keys = m_keyStore.data();
+    m_graph.latitude = m_latitudeStore.data();
+    m_graph.longitude = m_longitudeStore.data();
+    m_graph.cosLatitude = m_cosLatitudeStore.data();
+    m_graph.firstEdge = m_firstEdgeStore.data();
+    m_graph.edges = m_edgeStore.data();
+    m_graph.angle = m_angleStore.data();
+    m_graph.component = m_componentStore.data();
+    m_coordTextOffset = m_coordTextOffsetStore.data();
+    m_coordText = m_coordTextStore.data();
+    m_nameCount = 0;
+    m_nameOffset = m_nameOffsetStore.data();
+    m_names = m_nameStore.data();
+    m_slotCount = 0;
+    m_slots = nullptr;
 }
 
 bool StreetMapImpl::load(string mapFile)
 {
-    ifstream inf(mapFile);
-    if (!inf)
+    MappedFile f;
+    if (!f.open(mapFile))
         return false;
+    m_snapshot.close();
+    
+    // First pass: split the file into lines and run the street name / count /
+    // coordinates state machine.  This is cheap (no numbers are converted
+    // except the counts) and tells us which lines hold segments of which street.
+    vector<MapStreet> streets;
+    vector<MapLine> coordLines;
+    vector<MapProblem> problems;
+    const char* p = f.data();
+    const char* fileEnd = p + f.size();
+    unsigned int lineNumber = 0;
     int i = 0;
-    string streetName;
-    string line;
     bool justTurnedZero = true;
     bool justReadStreet = false;
-    while (getline(inf, line))
+    while (p != fileEnd)
     {
-        istringstream iss(line);
-        string nameOrCoord;
-        string startLat,startLong,endLat,endLong;
-        string name;
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', fileEnd - p));
+        if (!lineEnd)
+            lineEnd = fileEnd;
+        lineNumber++;
         if (justTurnedZero) // would imply that the line is a street name
         {
-            streetName = line;// then change the street name to be this line
+            MapStreet street;
+            street.name = p;
+            street.nameLength = lineEnd - p;
+            street.firstLine = coordLines.size();
+            streets.push_back(street);
             justTurnedZero = false;
             justReadStreet = true;
         }
-        
-        else if (justReadStreet)// if the line is a number indicating how many street segments
+        else if (justReadStreet) // if the line is a number indicating how many street segments
         {
             int amt;
-            iss >> amt;
+            if (!parseCount(p, lineEnd, amt))
+                problems.push_back(MapProblem(lineNumber, "expected a segment count"));
             i += amt;
             justReadStreet = false;
         }
-        
-        else if (iss >> startLat >> startLong >> endLat >> endLong)
+        else if (countTokens(p, lineEnd, 4) == 4)
         {
-            // coordinates
-            GeoCoord start(startLat,startLong);
-            GeoCoord end(endLat,endLong);
-            StreetSegment forward(start,end,streetName); // forward
-            StreetSegment reverse(end,start,streetName); // reverse
-            
-            vector<StreetSegment>* toChange = m_hashmap->find(start);
-            if (toChange)
-            {
-                toChange->push_back(forward);
-            }
+            MapLine line;
+            line.begin = p;
+            line.end = lineEnd;
+            line.number = lineNumber;
+            line.street = streets.size() - 1;
+            coordLines.push_back(line);
+            i--;
+            if (i == 0)
+                justTurnedZero = true;
+        }
+        else
+            problems.push_back(MapProblem(lineNumber, "expected four coordinates"));
+        p = (lineEnd == fileEnd ? fileEnd : lineEnd + 1);
+    }
+    
+    // Second pass: convert the coordinates.  The lines are split into chunks
+    // at street boundaries and each chunk is parsed on its own thread.
+    vector<MapParsedSegment> segments(coordLines.size());
+    unsigned int nThreads = thread::hardware_concurrency();
+    if (nThreads == 0  ||  coordLines.size() < 4096)
+        nThreads = 1;
+    vector<size_t> chunkStart;
+    for (size_t s = 0; s < streets.size(); s++)
+    {
+        size_t first = streets[s].firstLine;
+        if (chunkStart.empty()  ||
+            (first >= chunkStart.back() + coordLines.size() / nThreads  &&  first < coordLines.size()))
+            chunkStart.push_back(first);
+    }
+    if (chunkStart.empty())
+        chunkStart.push_back(0);
+    chunkStart[0] = 0;
+    chunkStart.push_back(coordLines.size());
+    
+    size_t nChunks = chunkStart.size() - 1;
+    vector<vector<MapProblem>> chunkProblems(nChunks);
+    auto parseChunk = [&](size_t c)
+    {
+        for (size_t k = chunkStart[c]; k < chunkStart[c+1]; k++)
+        {
+            if (!parseSegmentLine(coordLines[k], segments[k]))
+                chunkProblems[c].push_back(MapProblem(coordLines[k].number, "malformed coordinate"));
+        }
+    };
+    vector<thread> workers;
+    for (size_t c = 1; c < nChunks; c++)
+        workers.push_back(thread(parseChunk, c));
+    if (nChunks > 0)
+        parseChunk(0);
+    for (size_t w = 0; w < workers.size(); w++)
+        workers[w].join();
+    
+    // Merge, in file order, so the map comes out exactly as if it had been
+    // read one line at a time.
+    for (size_t c = 0; c < nChunks; c++)
+        problems.insert(problems.end(), chunkProblems[c].begin(), chunkProblems[c].end());
+    stable_sort(problems.begin(), problems.end());
+    for (size_t k = 0; k < problems.size(); k++)
+        cerr << mapFile << ":" << problems[k].line << ": " << problems[k].message << endl;
+    
+    clear();
+    m_nodeIds->reserve(coordLines.size());  // most nodes start one segment and end another
+    ExpandableHashMap<string,unsigned int,OpenAddressing> nameIds;
+    string streetName;
+    unsigned int nameId = 0;
+    size_t currentStreet = streets.size();
+    vector<unsigned int> edgeStart;
+    vector<StreetEdge> edges;
+    for (size_t k = 0; k < segments.size(); k++)
+    {
+        const MapParsedSegment& seg = segments[k];
+        if (!seg.valid)
+            continue;
+        if (coordLines[k].street != currentStreet)
+        {
+            currentStreet = coordLines[k].street;
+            streetName.assign(streets[currentStreet].name, streets[currentStreet].nameLength);
+            const unsigned int* id = nameIds.find(streetName);
+            if (id)
+                nameId = *id;
             else
             {
-                vector<StreetSegment> toAdd;
-                toAdd.push_back(forward);
-                m_hashmap->associate(start,toAdd);
-            }
-            
-            toChange = m_hashmap->find(end);
-            if (toChange)
-            {
-                toChange->push_back(reverse);
+                nameId = m_nameOffsetStore.size() - 1;
+                nameIds.associate(streetName, nameId);
+                m_nameStore += streetName;
+                m_nameOffsetStore.push_back(m_nameStore.size());
             }
-            else
+        }
+        bool mergedFrom, mergedTo;
+        unsigned int from = addNode(seg, 0, mergedFrom);
+        unsigned int to = addNode(seg, 1, mergedTo);
+        if (mergedFrom  ||  mergedTo)
+            cerr << mapFile << ":" << coordLines[k].number
+                 << ": coordinate written differently from an earlier one at the same point; they are one node" << endl;
+        GeoCoord start, end;
+        start.latitude = seg.value[0];
+        start.longitude = seg.value[1];
+        end.latitude = seg.value[2];
+        end.longitude = seg.value[3];
+        double length = distanceEarthMiles(start, end);
+        StreetEdge forward = { to, nameId, length };
+        StreetEdge reverse = { from, nameId, length };
+        edgeStart.push_back(from);
+        edges.push_back(forward);
+        edgeStart.push_back(to);
+        edges.push_back(reverse);
+    }
+    
+    // Group the edges by start node.  The sort is stable, so each node's
+    // segments keep the order they appeared in the file.
+    unsigned int nodeCount = m_latitudeStore.size();
+    m_firstEdgeStore.assign(nodeCount + 1, 0);
+    for (size_t e = 0; e < edges.size(); e++)
+        m_firstEdgeStore[edgeStart[e] + 1]++;
+    for (unsigned int n = 0; n < nodeCount; n++)
+        m_firstEdgeStore[n+1] += m_firstEdgeStore[n];
+    vector<unsigned int> next(m_firstEdgeStore.begin(), m_firstEdgeStore.end() - 1);
+    m_edgeStore.resize(edges.size());
+    for (size_t e = 0; e < edges.size(); e++)
+        m_edgeStore[next[edgeStart[e]]++] = edges[e];
+    
+    // each edge's heading, for the directions a DeliveryPlanner gives
+    m_angleStore.resize(m_edgeStore.size());
+    for (unsigned int n = 0; n < nodeCount; n++)
+    {
+        for (unsigned int e = m_firstEdgeStore[n]; e < m_firstEdgeStore[n+1]; e++)
+        {
+            unsigned int to = m_edgeStore[e].end;
+            double angle = rad2deg(atan2(m_latitudeStore[to] - m_latitudeStore[n],
+                                         m_longitudeStore[to] - m_longitudeStore[n]));
+            m_angleStore[e] = static_cast<float>(angle < 0 ? angle + 360 : angle);
+        }
+    }
+    
+    m_graph.nodeCount = nodeCount;
+    m_keys = m_keyStore.data();
+    m_graph.latitude = m_latitudeStore.data();
+    m_graph.longitude = m_longitudeStore.data();
+    m_graph.cosLatitude = m_cosLatitudeStore.data();
+    m_graph.firstEdge = m_firstEdgeStore.data();
+    m_graph.edges = m_edgeStore.data();
+    m_graph.angle = m_angleStore.data();
+    m_coordTextOffset = m_coordTextOffsetStore.data();
+    m_coordText = m_coordTextStore.data();
+    m_nameCount = m_nameOffsetStore.size() - 1;
+    m_nameOffset = m_nameOffsetStore.data();
+    m_names = m_nameStore.data();
+    labelComponents();
+    m_grid.build(m_graph);
+    return true;
+}
+
+  // the node at one end of seg (0 = start, 1 = end), added if it's new;
+  // merged is set if it isn't, but the node's text differs from seg's
+unsigned int StreetMapImpl::addNode(const MapParsedSegment& seg, int which, bool& merged)
+{
+    double lat = seg.value[2*which];
+    double lon = seg.value[2*which+1];
+    unsigned long long key = coordKey(lat, lon);
+    const unsigned int* id = m_nodeIds->find(key);
+    merged = false;
+    if (id)
+    {
+        for (int c = 0; c < 2  &&  !merged; c++)
+        {
+            size_t begin = m_coordTextOffsetStore[2 * *id + c];
+            size_t length = m_coordTextOffsetStore[2 * *id + c + 1] - begin;
+            merged = m_coordTextStore.compare(begin, length, seg.text[2*which+c], seg.length[2*which+c]) != 0;
+        }
+        return *id;
+    }
+    unsigned int newId = m_latitudeStore.size();
+    m_nodeIds->associate(key, newId);
+    m_keyStore.push_back(key);
+    m_latitudeStore.push_back(lat);
+    m_longitudeStore.push_back(lon);
+    m_cosLatitudeStore.push_back(cos(deg2rad(lat)));
+    m_coordTextStore.append(seg.text[2*which], seg.length[2*which]);
+    m_coordTextOffsetStore.push_back(m_coordTextStore.size());
+    m_coordTextStore.append(seg.text[2*which+1], seg.length[2*which+1]);
+    m_coordTextOffsetStore.push_back(m_coordTextStore.size());
+    return newId;
+}
+
+bool StreetMapImpl::saveSnapshot(string snapshotFile) const
+{
+    unsigned int nodeCount = m_graph.nodeCount;
+    unsigned int edgeCount = m_graph.firstEdge[nodeCount];
+    
+    // lookup slots at a load factor of at most one half
+    unsigned int slotCount = 8;
+    while (slotCount < 2 * nodeCount)
+        slotCount *= 2;
+    vector<unsigned int> slots(slotCount, 0);
+    for (unsigned int n = 0; n < nodeCount; n++)
+    {
+        unsigned int slot = hasher(m_keys[n]) & (slotCount - 1);
+        while (slots[slot] != 0)
+            slot = (slot + 1) & (slotCount - 1);
+        slots[slot] = n + 1;
+    }
+    
+    // lay out the body, then checksum it
+    string body;
+    auto append = [&](const void* p, size_t n)
+    {
+        body.append(static_cast<const char*>(p), n);
+        body.resize(padTo8(body.size()), '\0');
+    };
+    size_t coordTextBytes = m_coordTextOffset[2 * nodeCount];
+    size_t nameBytes = m_nameOffset[m_nameCount];
+    append(m_graph.latitude, nodeCount * sizeof(double));
+    append(m_graph.longitude, nodeCount * sizeof(double));
+    append(m_graph.cosLatitude, nodeCount * sizeof(double));
+    append(m_keys, nodeCount * sizeof(unsigned long long));
+    append(m_graph.firstEdge, (nodeCount + 1) * sizeof(unsigned int));
+    append(m_graph.edges, edgeCount * sizeof(StreetEdge));
+    append(m_graph.angle, edgeCount * sizeof(float));
+    append(m_coordTextOffset, (2 * nodeCount + 1) * sizeof(unsigned int));
+    append(m_nameOffset, (m_nameCount + 1) * sizeof(unsigned int));
+    append(slots.data(), slotCount * sizeof(unsigned int));
+    append(m_coordText, coordTextBytes);
+    append(m_names, nameBytes);
+    
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.nodeCount = nodeCount;
+    header.edgeCount = edgeCount;
+    header.nameCount = m_nameCount;
+    header.slotCount = slotCount;
+    header.coordTextBytes = coordTextBytes;
+    header.nameBytes = nameBytes;
+    header.checksum = fnv1a(body.data(), body.size());
+    
+    ofstream outf(snapshotFile, ios::binary);
+    if (!outf)
+        return false;
+    outf.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outf.write(body.data(), body.size());
+    return bool(outf);
+}
+
+bool StreetMapImpl::loadSnapshot(string snapshotFile)
+{
+    MappedFile f;
+    if (!f.open(snapshotFile))
+        return false;
+    
+    SnapshotHeader header;
+    if (f.size() < sizeof(header))
+        return false;
+    memcpy(&header, f.data(), sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0  ||
+        header.version != SNAPSHOT_VERSION  ||  header.byteOrder != SNAPSHOT_BYTE_ORDER)
+        return false;
+    
+    // check that the sections described by the header fit in the file
+    size_t n = header.nodeCount;
+    size_t expected = sizeof(header) + 3 * padTo8(n * sizeof(double)) + padTo8(n * sizeof(unsigned long long)) +
+        padTo8((n + 1) * sizeof(unsigned int)) + padTo8(header.edgeCount * sizeof(StreetEdge)) +
+        padTo8(header.edgeCount * sizeof(float)) +
+        padTo8((2 * n + 1) * sizeof(unsigned int)) + padTo8((header.nameCount + 1) * sizeof(unsigned int)) +
+        padTo8(header.slotCount * sizeof(unsigned int)) +
+        padTo8(header.coordTextBytes) + padTo8(header.nameBytes);
+    if (f.size() != expected  ||
+        fnv1a(f.data() + sizeof(header), f.size() - sizeof(header)) != header.checksum)
+        return false;
+    
+    // the snapshot replaces whatever map was loaded before
+    clear();
+    m_snapshot.swap(f);
+    
+    const char* p = m_snapshot.data() + sizeof(header);
+    auto take = [&p](size_t bytes) -> const char*
+    {
+        const char* section = p;
+        p += padTo8(bytes);
+        return section;
+    };
+    m_graph.nodeCount = header.nodeCount;
+    m_graph.latitude = reinterpret_cast<const double*>(take(n * sizeof(double)));
+    m_graph.longitude = reinterpret_cast<const double*>(take(n * sizeof(double)));
+    m_graph.cosLatitude = reinterpret_cast<const double*>(take(n * sizeof(double)));
+    m_keys = reinterpret_cast<const unsigned long long*>(take(n * sizeof(unsigned long long)));
+    m_graph.firstEdge = reinterpret_cast<const unsigned int*>(take((n + 1) * sizeof(unsigned int)));
+    m_graph.edges = reinterpret_cast<const StreetEdge*>(take(header.edgeCount * sizeof(StreetEdge)));
+    m_graph.angle = reinterpret_cast<const float*>(take(header.edgeCount * sizeof(float)));
+    m_coordTextOffset = reinterpret_cast<const unsigned int*>(take((2 * n + 1) * sizeof(unsigned int)));
+    m_nameOffset = reinterpret_cast<const unsigned int*>(take((header.nameCount + 1) * sizeof(unsigned int)));
+    m_slots = reinterpret_cast<const unsigned int*>(take(header.slotCount * sizeof(unsigned int)));
+    m_coordText = take(header.coordTextBytes);
+    m_names = take(header.nameBytes);
+    m_nameCount = header.nameCount;
+    m_slotCount = header.slotCount;
+    labelComponents();
+    m_grid.build(m_graph);
+    return true;
+}
+
+  // each node's connected part of the map, by a depth-first search from
+  // every node not yet labeled, in order of id
+void StreetMapImpl::labelComponents()
+{
+    const unsigned int UNLABELED = 0xffffffff;
+    m_componentStore.assign(m_graph.nodeCount, UNLABELED);
+    vector<unsigned int> stack;
+    for (unsigned int n = 0; n < m_graph.nodeCount; n++)
+    {
+        if (m_componentStore[n] != UNLABELED)
+            continue;
+        m_componentStore[n] = n;
+        stack.push_back(n);
+        while (!stack.empty())
+        {
+            StreetEdgeRange edges = m_graph.edgesFrom(stack.back());
+            stack.pop_back();
+            for (auto e = edges.begin(); e != edges.end(); e++)
             {
-                vector<StreetSegment> toAdd;
-                toAdd.push_back(reverse);
-                m_hashmap->associate(end,toAdd);
+                if (m_componentStore[(*e).end] == UNLABELED)
+                {
+                    m_componentStore[(*e).end] = n;
+                    stack.push_back((*e).end);
+                }
             }
-            i--;
-            if (i == 0)
-                justTurnedZero = true;
-            
         }
+    }
+    m_graph.component = m_componentStore.data();
+}
+
+bool StreetMapImpl::findNode(const GeoCoord& gc, unsigned int& node) const
+{
+    unsigned long long key = coordKey(gc);
+    if (m_slotCount == 0)
+    {
+        const unsigned int* id = m_nodeIds->find(key);
+        if (!id)
+            return false;
+        node = *id;
+        return true;
+    }
     
+    unsigned int slot = hasher(key) & (m_slotCount - 1);
+    while (m_slots[slot] != 0)
+    {
+        unsigned int n = m_slots[slot] - 1;
+        if (m_keys[n] == key)
+        {
+            node = n;
+            return true;
+        }
+        slot = (slot + 1) & (m_slotCount - 1);
     }
+    return false;
+}
+
+bool StreetMapImpl::nearestSegment(const GeoCoord& gc, double radiusMeters, SegmentSnap& snap) const
+{
+    if (!m_grid.nearestSegment(gc.latitude, gc.longitude, radiusMeters, snap.fromNode, snap.edge,
+                               snap.fraction, snap.distance))
+        return false;
+    unsigned int to = m_graph.edges[snap.edge].end;
+    snap.latitude = m_graph.latitude[snap.fromNode] +
+        snap.fraction * (m_graph.latitude[to] - m_graph.latitude[snap.fromNode]);
+    snap.longitude = m_graph.longitude[snap.fromNode] +
+        snap.fraction * (m_graph.longitude[to] - m_graph.longitude[snap.fromNode]);
     return true;
 }
 
+void StreetMapImpl::coordOf(unsigned int node, GeoCoord& gc) const
+{
+    // fill in the fields directly; the GeoCoord constructor would re-parse the text
+    const char* text;
+    size_t length;
+    coordText(node, 0, text, length);
+    gc.latitudeText.assign(text, length);
+    coordText(node, 1, text, length);
+    gc.longitudeText.assign(text, length);
+    gc.latitude = m_graph.latitude[node];
+    gc.longitude = m_graph.longitude[node];
+}
+
+StreetEdgeRange StreetMapImpl::segmentsThatStartWith(const GeoCoord& gc) const
+{
+    unsigned int node;
+    if (!findNode(gc, node))
+    {
+        StreetEdgeRange none = { nullptr, nullptr };
+        return none;
+    }
+    return m_graph.edgesFrom(node);
+}
+
+// kept for callers that want StreetSegments; copies out of segmentsThatStartWith
 bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
     segs.clear();
-    vector<StreetSegment>* toCopy = m_hashmap->find(gc);
-    if (!toCopy)
+    unsigned int node;
+    if (!findNode(gc, node))
         return false;
-    for (auto p = (*toCopy).begin(); p != (*toCopy).end(); p++)
+    StreetEdgeRange edges = m_graph.edgesFrom(node);
+    segs.resize(edges.size());
+    for (size_t k = 0; k < edges.size(); k++)
     {
-        StreetSegment segmentToAdd = (*p);
-        segs.push_back(segmentToAdd);
+        StreetSegment& seg = segs[k];
+        seg.start = gc;
+        coordOf(edges.first[k].end, seg.end);
+        streetName(edges.first[k].name, seg.name);
+        seg.nameId = edges.first[k].name;
     }
     return true;
 }
@@ -142,7 +875,61 @@ bool StreetMap::load(string mapFile)
     return m_impl->load(mapFile);
 }
 
+bool StreetMap::loadSnapshot(string snapshotFile)
+{
+    return m_impl->loadSnapshot(snapshotFile);
+}
+
+bool StreetMap::saveSnapshot(string snapshotFile) const
+{
+    return m_impl->saveSnapshot(snapshotFile);
+}
+
 bool StreetMap::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
    return m_impl->getSegmentsThatStartWith(gc, segs);
 }
+
+StreetEdgeRange StreetMap::segmentsThatStartWith(const GeoCoord& gc) const
+{
+    return m_impl->segmentsThatStartWith(gc);
+}
+
+unsigned int StreetMap::generation() const
+{
+    return m_impl->generation();
+}
+
+const StreetGraph& StreetMap::graph() const
+{
+    return m_impl->graph();
+}
+
+bool StreetMap::findNode(const GeoCoord& gc, unsigned int& node) const
+{
+    return m_impl->findNode(gc, node);
+}
+
+bool StreetMap::nearestNode(const GeoCoord& gc, double radiusMeters, unsigned int& node) const
+{
+    return m_impl->nearestNode(gc, radiusMeters, node);
+}
+
+bool StreetMap::nearestSegment(const GeoCoord& gc, double radiusMeters, SegmentSnap& snap) const
+{
+    return m_impl->nearestSegment(gc, radiusMeters, snap);
+}
+
+GeoCoord StreetMap::coordOf(unsigned int node) const
+{
+    GeoCoord gc;
+    m_impl->coordOf(node, gc);
+    return gc;
+}
+
+string StreetMap::streetName(unsigned int name) const
+{
+    string s;
+    m_impl->streetName(name, s);
+    return s;
+}
@@ -0,0 +1,420 @@
+// TourSearch.h
+
+// Local search for a short closed tour through points 0 .. n-1 (for a
+// DeliveryOptimizer, the depot and the delivery locations), under any
+// symmetric distance, given as a function object dist(a, b).
+//
+// A tour starts as the nearest neighbor tour and is improved by 2-opt moves
+// (swap two of its edges for the two that join their ends the other way)
+// and Or-opt moves (take out a run of one to three points and put it back,
+// either way round, between two others).  Two ideas keep this fast at
+// hundreds of points.  Each point only tries moves that would give it an
+// edge to one of its nearest few others (its neighbor list), since a move
+// that shortens the tour nearly always does that.  And each point has a
+// "don't look" bit, set once it has no improving move, and cleared only
+// when a move changes one of its edges; the points whose bits are clear
+// wait in a queue.  The tour is an array, with each point's place in it
+// alongside, and a 2-opt move reverses whichever side of the tour is shorter.
+//
+// Once no move helps, kick() breaks the tour out of its local optimum with a
+// double bridge: two short stretches of the tour next to each other swap
+// places, which no 2-opt or Or-opt move undoes, and the search runs again
+// from the points whose edges that changed.  Repeating that, keeping the
+// result only when it's shorter, is iterated local search.
+
+#ifndef TOURSEARCH_INCLUDED
+#define TOURSEARCH_INCLUDED
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+  // Each of a set of points' k nearest others, nearest first.
+class NeighborLists
+{
+public:
+    NeighborLists() : m_count(0), m_k(0) {}
+
+      // row(p, out) must fill out[q] with the distance from p to each point q
+    template <typename Row>
+    void build(unsigned int count, unsigned int k, Row row)
+    {
+        m_count = count;
+        m_k = count > 0 ? std::min(k, count - 1) : 0;
+        m_list.resize(size_t(count) * m_k);
+        std::vector<double> d(count);
+        std::vector<unsigned int> others(count);
+        for (unsigned int p = 0; p < count; p++)
+        {
+            row(p, d.data());
+            d[p] = std::numeric_limits<double>::infinity();
+            for (unsigned int q = 0; q < count; q++)
+                others[q] = q;
+            auto nearer = [&d](unsigned int a, unsigned int b) { return d[a] < d[b]  ||  (d[a] == d[b]  &&  a < b); };
+            std::nth_element(others.begin(), others.begin() + m_k, others.end(), nearer);
+            std::sort(others.begin(), others.begin() + m_k, nearer);
+            std::copy(others.begin(), others.begin() + m_k, m_list.begin() + size_t(p) * m_k);
+        }
+    }
+
+    unsigned int pointCount() const { return m_count; }
+    unsigned int k() const { return m_k; }
+    const unsigned int* begin(unsigned int p) const { return m_list.data() + size_t(p) * m_k; }
+    const unsigned int* end(unsigned int p) const { return begin(p) + m_k; }
+
+private:
+    unsigned int m_count;
+    unsigned int m_k;
+    std::vector<unsigned int> m_list;   // point p's list is m_list[p*m_k .. (p+1)*m_k)
+};
+
+template <typename Distance>
+class TourSearch
+{
+public:
+      // neighbors must cover the same points as dist, and outlive the search
+    TourSearch(Distance dist, const NeighborLists& neighbors)
+     : m_dist(dist), m_neighbors(&neighbors), m_length(0)
+    {}
+
+      // start from the given order of all the points
+    void setOrder(const std::vector<unsigned int>& order)
+    {
+        m_tour = order;
+        m_position.resize(order.size());
+        m_length = 0;
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            m_position[order[i]] = i;
+            m_length += m_dist(order[i], order[(i + 1) % order.size()]);
+        }
+    }
+
+      // Start from the nearest neighbor tour from start: on each step, go to
+      // the nearest point not yet visited, the first such on the current
+      // point's neighbor list, or if they've all been visited, the nearest of
+      // all the rest.
+    void nearestNeighbor(unsigned int start)
+    {
+        unsigned int n = m_neighbors->pointCount();
+        std::vector<unsigned int> order;
+        order.reserve(n);
+        std::vector<unsigned int> left(n), place(n);    // unvisited points, and where each is in left
+        for (unsigned int p = 0; p < n; p++)
+            left[p] = place[p] = p;
+        auto visit = [&](unsigned int p)
+        {
+            order.push_back(p);
+            unsigned int last = left.back();
+            left[place[p]] = last;
+            place[last] = place[p];
+            left.pop_back();
+            place[p] = NONE;
+        };
+        visit(start);
+        while (!left.empty())
+        {
+            unsigned int current = order.back();
+            unsigned int next = NONE;
+            for (const unsigned int* q = m_neighbors->begin(current); q != m_neighbors->end(current); q++)
+            {
+                if (place[*q] != NONE)
+                {
+                    next = *q;
+                    break;
+                }
+            }
+            if (next == NONE)
+            {
+                double best = std::numeric_limits<double>::infinity();
+                for (size_t i = 0; i < left.size(); i++)
+                {
+                    double d = m_dist(current, left[i]);
+                    if (d < best)
+                    {
+                        best = d;
+                        next = left[i];
+                    }
+                }
+            }
+            visit(next);
+        }
+        setOrder(order);
+    }
+
+      // Apply improving moves until none is left; return whether there was
+      // any.  (With three points or fewer every tour is the same length.)
+    bool improve()
+    {
+        unsigned int n = m_tour.size();
+        if (n < 4)
+            return false;
+        startQueue();
+        for (unsigned int i = 0; i < n; i++)
+            activate(m_tour[i]);
+        return runQueue();
+    }
+
+      // Swap two neighboring stretches of the tour, each of at most
+      // MAX_KICK_STRETCH points, chosen with rng, then improve the tour from
+      // the points whose edges changed.  The tour may come out longer.
+    template <typename Random>
+    void kick(Random& rng)
+    {
+        unsigned int n = m_tour.size();
+        if (n < 8)
+            return;
+        unsigned int longest = std::min(unsigned(MAX_KICK_STRETCH), n / 4);
+        unsigned int first = 1 + rng() % longest, second = 1 + rng() % longest;
+        unsigned int i = rng() % (n - first - second + 1);     // the stretches are m_tour[i..i+first+second)
+        unsigned int j = i + first, k = j + second;
+        unsigned int before = m_tour[i == 0 ? n - 1 : i - 1], after = m_tour[k == n ? 0 : k];
+        unsigned int a = m_tour[i], b = m_tour[j - 1], c = m_tour[j], d = m_tour[k - 1];
+        // before a..b c..d after  becomes  before c..d a..b after
+        m_length += m_dist(before, c) + m_dist(d, a) + m_dist(b, after)
+                  - m_dist(before, a) - m_dist(b, c) - m_dist(d, after);
+        std::rotate(m_tour.begin() + i, m_tour.begin() + j, m_tour.begin() + k);
+        for (unsigned int x = i; x < k; x++)
+            m_position[m_tour[x]] = x;
+        startQueue();
+        unsigned int changed[6] = { before, a, b, c, d, after };
+        for (int x = 0; x < 6; x++)
+            activate(changed[x]);
+        runQueue();
+    }
+
+    const std::vector<unsigned int>& order() const { return m_tour; }
+
+      // kept up to date move by move, so it may differ from a fresh sum in
+      // the last few bits
+    double length() const { return m_length; }
+
+private:
+    static const unsigned int NONE = 0xffffffff;
+    static constexpr double EPSILON = 1e-10;    // smaller gains are rounding, and could cycle
+    static const unsigned int MAX_KICK_STRETCH = 50;
+
+    Distance m_dist;
+    const NeighborLists* m_neighbors;
+    std::vector<unsigned int> m_tour;       // the points in tour order
+    std::vector<unsigned int> m_position;   // each point's index in m_tour
+    std::vector<unsigned int> m_queue;      // points to look at: a ring of m_queueSize from m_queueHead
+    unsigned int m_queueHead;
+    unsigned int m_queueSize;
+    std::vector<bool> m_queued;             // the negation of each point's don't-look bit
+    double m_length;
+
+    unsigned int next(unsigned int p) const
+    {
+        unsigned int i = m_position[p] + 1;
+        return m_tour[i == m_tour.size() ? 0 : i];
+    }
+
+    unsigned int prev(unsigned int p) const
+    {
+        unsigned int i = m_position[p];
+        return m_tour[i == 0 ? m_tour.size() - 1 : i - 1];
+    }
+
+      // an empty queue, with every don't-look bit set (as runQueue always
+      // leaves them, so they only need setting for a new size of tour)
+    void startQueue()
+    {
+        unsigned int n = m_tour.size();
+        if (m_queue.size() != n)
+        {
+            m_queued.assign(n, false);
+            m_queue.resize(n);
+        }
+        m_queueHead = 0;
+        m_queueSize = 0;
+    }
+
+      // look at the queued points until there are none left; return whether
+      // any move was made
+    bool runQueue()
+    {
+        bool improved = false;
+        while (m_queueSize > 0)
+        {
+            unsigned int a = m_queue[m_queueHead];
+            m_queueHead = (m_queueHead + 1) % m_queue.size();
+            m_queueSize--;
+            m_queued[a] = false;
+            if (twoOpt(a)  ||  orOpt(a))
+                improved = true;
+        }
+        return improved;
+    }
+
+    void activate(unsigned int p)
+    {
+        if (!m_queued[p])
+        {
+            m_queued[p] = true;
+            m_queue[(m_queueHead + m_queueSize) % m_queue.size()] = p;
+            m_queueSize++;
+        }
+    }
+
+      // reverse the stretch of the tour from index i forward to index j
+      // (wrapping past the end), or else the rest of the tour, which gives
+      // the same tour backwards, if that's shorter
+    void reverse(unsigned int i, unsigned int j)
+    {
+        unsigned int n = m_tour.size();
+        unsigned int inner = (j + n - i) % n + 1;
+        if (2 * inner > n)
+        {
+            unsigned int newI = (j + 1) % n;
+            j = (i + n - 1) % n;
+            i = newI;
+            inner = n - inner;
+        }
+        for (unsigned int k = 0; k < inner / 2; k++)
+        {
+            std::swap(m_tour[i], m_tour[j]);
+            m_position[m_tour[i]] = i;
+            m_position[m_tour[j]] = j;
+            i = (i + 1 == n ? 0 : i + 1);
+            j = (j == 0 ? n - 1 : j - 1);
+        }
+    }
+
+      // Try replacing an edge at a, (a,b), and another, (c,d), with (a,c)
+      // and (b,d), for c on a's neighbor list.  Since the list is in order
+      // of distance, once (a,c) is no shorter than (a,b) the rest won't help.
+    bool twoOpt(unsigned int a)
+    {
+        for (int forward = 1; forward >= 0; forward--)
+        {
+            unsigned int b = forward ? next(a) : prev(a);
+            double ab = m_dist(a, b);
+            for (const unsigned int* q = m_neighbors->begin(a); q != m_neighbors->end(a); q++)
+            {
+                unsigned int c = *q;
+                double ac = m_dist(a, c);
+                if (ac >= ab)
+                    break;
+                unsigned int d = forward ? next(c) : prev(c);
+                if (c == b  ||  d == a)
+                    continue;
+                double delta = ac + m_dist(b, d) - ab - m_dist(c, d);
+                if (delta < -EPSILON)
+                {
+                    m_length += delta;
+                    // forward:  a b ... c d  becomes  a c ... b d
+                    // backward: b a ... d c  becomes  b d ... a c
+                    if (forward)
+                        reverse(m_position[b], m_position[c]);
+                    else
+                        reverse(m_position[a], m_position[d]);
+                    activate(a);
+                    activate(b);
+                    activate(c);
+                    activate(d);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+      // Try moving a run of up to three points that begins or ends at a to
+      // between x and y, two points next to each other elsewhere, with one
+      // end of the run joined to its neighbor c, on that end's neighbor
+      // list.  Runs that would wrap past the end of the array are skipped.
+    bool orOpt(unsigned int a)
+    {
+        unsigned int n = m_tour.size();
+        for (unsigned int length = 1; length <= 3  &&  length + 2 < n; length++)
+        {
+            for (int startsAtA = 1; startsAtA >= 0; startsAtA--)
+            {
+                if (length == 1  &&  !startsAtA)
+                    break;
+                unsigned int first = m_position[a];
+                if (!startsAtA)
+                {
+                    if (first < length - 1)
+                        continue;
+                    first -= length - 1;
+                }
+                if (first + length > n)
+                    continue;
+                unsigned int s = m_tour[first], e = m_tour[first + length - 1];
+                unsigned int p = prev(s), r = next(e);
+                double removed = m_dist(p, s) + m_dist(e, r) - m_dist(p, r);
+                if (removed <= EPSILON)
+                    continue;
+                auto inRun = [&](unsigned int x)
+                {
+                    return m_position[x] >= first  &&  m_position[x] < first + length;
+                };
+                for (int end = 0; end < 2; end++)
+                {
+                    unsigned int u = (end == 0 ? s : e), other = (end == 0 ? e : s);
+                    for (const unsigned int* q = m_neighbors->begin(u); q != m_neighbors->end(u); q++)
+                    {
+                        unsigned int c = *q;
+                        double uc = m_dist(u, c);
+                        if (uc >= removed)
+                            break;
+                        if (inRun(c))
+                            continue;
+                        for (int after = 1; after >= 0; after--)
+                        {
+                            // the run goes between x and y, u next to c
+                            unsigned int x = after ? c : prev(c), y = after ? next(c) : c;
+                            if (inRun(x)  ||  inRun(y))
+                                continue;
+                            double added = uc + m_dist(other, after ? y : x) - m_dist(x, y);
+                            if (added - removed < -EPSILON)
+                            {
+                                m_length += added - removed;
+                                bool reversed = (after ? u == e : u == s);
+                                moveRun(first, length, x, reversed);
+                                activate(p);
+                                activate(r);
+                                activate(s);
+                                activate(e);
+                                activate(x);
+                                activate(y);
+                                return true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+      // move the length points at m_tour[first..] to just after point x,
+      // turning them around if reversed
+    void moveRun(unsigned int first, unsigned int length, unsigned int x, bool reversed)
+    {
+        unsigned int at = m_position[x];
+        unsigned int low, high, newFirst;   // m_tour[low..high] is what moves
+        if (at > first)
+        {
+            std::rotate(m_tour.begin() + first, m_tour.begin() + first + length, m_tour.begin() + at + 1);
+            low = first;
+            high = at;
+            newFirst = at + 1 - length;
+        }
+        else
+        {
+            std::rotate(m_tour.begin() + at + 1, m_tour.begin() + first, m_tour.begin() + first + length);
+            low = at + 1;
+            high = first + length - 1;
+            newFirst = at + 1;
+        }
+        if (reversed)
+            std::reverse(m_tour.begin() + newFirst, m_tour.begin() + newFirst + length);
+        for (unsigned int i = low; i <= high; i++)
+            m_position[m_tour[i]] = i;
+    }
+};
+
+#endif // TOURSEARCH_INCLUDED
@@ -0,0 +1,88 @@
+// anytime_bench.cpp
+
+// Tour length against time budget for DeliveryOptimizer's iterated local
+// search, with 1, 2, 4 and 8 threads, for one random set of 200 stops and
+// one of 1,000 from the map's nodes.  Budget 0 is the plain local search.
+// First, two runs of 5 rounds with no budget must give identical orders,
+// with 1 and with 4 threads.  The whole run takes about half a minute.
+
+#include "provided.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+using namespace std;
+
+static double optimize(const StreetMap& sm, const OptimizerOptions& options, const GeoCoord& depot,
+                       vector<DeliveryRequest>& deliveries)
+{
+    double oldLength, newLength;
+    DeliveryOptimizer optimizer(&sm, options);
+    optimizer.optimizeDeliveryOrder(depot, deliveries, oldLength, newLength);
+    return newLength;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+
+    int differ = 0;
+    const unsigned int sizes[] = { 200, 1000 };
+    const double budgets[] = { 0, 0.05, 0.1, 0.25, 0.5, 1, 2 };
+    for (int z = 0; z < 2; z++)
+    {
+        unsigned int n = sizes[z];
+        mt19937 rng(n);
+        uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+        GeoCoord depot = sm.coordOf(node(rng));
+        vector<DeliveryRequest> given;
+        for (unsigned int i = 0; i < n; i++)
+            given.push_back(DeliveryRequest("item", sm.coordOf(node(rng))));
+
+        for (unsigned int threads = 1; threads <= 4; threads *= 4)
+        {
+            OptimizerOptions options;
+            options.rounds = 5;
+            options.threads = threads;
+            options.seed = 42;
+            vector<DeliveryRequest> first = given, second = given;
+            optimize(sm, options, depot, first);
+            optimize(sm, options, depot, second);
+            for (unsigned int i = 0; i < n; i++)
+            {
+                if (!(first[i].location == second[i].location))
+                {
+                    differ++;
+                    break;
+                }
+            }
+        }
+
+        printf("%5u stops", n);
+        for (int b = 0; b < 7; b++)
+            printf("  %5.2f s", budgets[b]);
+        printf("\n");
+        for (unsigned int threads = 1; threads <= 8; threads *= 2)
+        {
+            printf("%u thread%s  ", threads, threads == 1 ? " " : "s");
+            for (int b = 0; b < 7; b++)
+            {
+                OptimizerOptions options;
+                options.timeBudget = budgets[b];
+                options.threads = threads;
+                options.seed = 7;
+                vector<DeliveryRequest> deliveries = given;
+                printf(" %8.3f", optimize(sm, options, depot, deliveries));
+                fflush(stdout);
+            }
+            printf("\n");
+        }
+    }
+    printf("%d pairs of repeated runs gave different orders\n", differ);
+    return differ == 0 ? 0 : 1;
+}
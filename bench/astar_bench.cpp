@@ -0,0 +1,97 @@
+// astar_bench.cpp
+
+// Queries per second and nodes settled per query for PointToPointRouter's
+// A* over 2,000 random pairs of the map's nodes, then a check of the first
+// 200 lengths against a plain Dijkstra search.
+
+#include "provided.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <list>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+static double dijkstra(const StreetGraph& graph, unsigned int from, unsigned int to)
+{
+    typedef pair<double, unsigned int> Entry;
+    vector<double> dist(graph.nodeCount, numeric_limits<double>::infinity());
+    priority_queue<Entry, vector<Entry>, greater<Entry> > open;
+    dist[from] = 0;
+    open.push(Entry(0, from));
+    while (!open.empty())
+    {
+        Entry top = open.top();
+        open.pop();
+        if (top.second == to)
+            return top.first;
+        if (top.first > dist[top.second])
+            continue;
+        StreetEdgeRange edges = graph.edgesFrom(top.second);
+        for (const StreetEdge* e = edges.begin(); e != edges.end(); e++)
+        {
+            double d = top.first + e->length;
+            if (d < dist[e->end])
+            {
+                dist[e->end] = d;
+                open.push(Entry(d, e->end));
+            }
+        }
+    }
+    return numeric_limits<double>::infinity();
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    PointToPointRouter router(&sm);
+
+    const int QUERIES = 2000;
+    mt19937 rng(1);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+    vector<pair<unsigned int, unsigned int> > pairs;
+    for (int i = 0; i < QUERIES; i++)
+    {
+        unsigned int from = node(rng);
+        pairs.push_back(make_pair(from, node(rng)));
+    }
+
+    vector<double> lengths(QUERIES, numeric_limits<double>::infinity());
+    list<StreetSegment> route;
+    double distance;
+    unsigned long long settled = 0;
+    int unreachable = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < QUERIES; i++)
+    {
+        if (router.generatePointToPointRoute(pairs[i].first, pairs[i].second, route, distance) == DELIVERY_SUCCESS)
+            lengths[i] = distance;
+        else
+            unreachable++;
+        settled += router.nodesSettled();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("A*: %d queries (%d unreachable) in %.3f s, %.0f queries/s, %.0f of %u nodes settled per query\n",
+           QUERIES, unreachable, seconds, QUERIES / seconds, double(settled) / QUERIES, graph.nodeCount);
+
+    int mismatches = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        double want = dijkstra(graph, pairs[i].first, pairs[i].second);
+        if (!(want == lengths[i] || fabs(want - lengths[i]) < 1e-9))
+            mismatches++;
+    }
+    printf("%d of 200 lengths differ from Dijkstra's\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
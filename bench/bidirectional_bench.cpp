@@ -0,0 +1,84 @@
+// bidirectional_bench.cpp
+
+// Nodes settled and time per query for A* and bidirectional A* on 6,000
+// random pairs of nodes, grouped by the straight-line distance between
+// them.  Averages are over the pairs with a route.  Every length must
+// match A*'s.
+
+#include "provided.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <list>
+#include <random>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    RouterOptions options;
+    options.bidirectional = true;
+    PointToPointRouter astar(&sm);
+    PointToPointRouter bidirectional(&sm, options);
+
+    const int BUCKETS = 5;
+    const double limits[BUCKETS] = { 0.5, 1, 2, 3, INFINITY };
+    const char* names[BUCKETS] = { "< 0.5 mi", "0.5 - 1 mi", "1 - 2 mi", "2 - 3 mi", "> 3 mi" };
+    double astarSettled[BUCKETS] = { 0 }, bidirectionalSettled[BUCKETS] = { 0 };
+    double astarTime[BUCKETS] = { 0 }, bidirectionalTime[BUCKETS] = { 0 };
+    int routes[BUCKETS] = { 0 };
+    int mismatches = 0;
+
+    mt19937 rng(7);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+    list<StreetSegment> route;
+    for (int i = 0; i < 6000; i++)
+    {
+        unsigned int from = node(rng);
+        unsigned int to = node(rng);
+        double crow = distanceEarthMiles(graph.latitude[from], graph.longitude[from],
+                                         graph.latitude[to], graph.longitude[to]);
+        int b = 0;
+        while (crow >= limits[b])
+            b++;
+
+        double astarLength, bidirectionalLength;
+        Clock::time_point start = Clock::now();
+        DeliveryResult astarResult = astar.generatePointToPointRoute(from, to, route, astarLength);
+        Clock::time_point middle = Clock::now();
+        unsigned int settled = astar.nodesSettled();
+        DeliveryResult bidirectionalResult = bidirectional.generatePointToPointRoute(from, to, route,
+                                                                                     bidirectionalLength);
+        Clock::time_point end = Clock::now();
+        if (astarResult != bidirectionalResult || fabs(astarLength - bidirectionalLength) > 1e-9)
+            mismatches++;
+        if (astarResult != DELIVERY_SUCCESS)
+            continue;
+        routes[b]++;
+        astarSettled[b] += settled;
+        bidirectionalSettled[b] += bidirectional.nodesSettled();
+        astarTime[b] += chrono::duration<double, micro>(middle - start).count();
+        bidirectionalTime[b] += chrono::duration<double, micro>(end - middle).count();
+    }
+
+    printf("distance     routes  A* settled / time    bidirectional settled / time   settled saved\n");
+    for (int b = 0; b < BUCKETS; b++)
+    {
+        if (routes[b] == 0)
+            continue;
+        printf("%-12s %6d  %6.0f / %5.0f us      %6.0f / %5.0f us              %4.0f%%\n", names[b], routes[b],
+               astarSettled[b] / routes[b], astarTime[b] / routes[b],
+               bidirectionalSettled[b] / routes[b], bidirectionalTime[b] / routes[b],
+               100 * (1 - bidirectionalSettled[b] / astarSettled[b]));
+    }
+    printf("%d routes differ from A*'s\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
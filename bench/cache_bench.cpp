@@ -0,0 +1,121 @@
+// cache_bench.cpp
+
+// Hit rate and time per request of a PointToPointRouter with a RouteCache
+// of 100, 1,000 and 10,000 routes, against no cache, replaying 20,000
+// synthetic requests: from the depot of deliveries.txt to one of 300
+// places within 1.5 miles of it, between two places, or back to the depot,
+// with places chosen by a Zipf distribution.  Then the time of a request
+// that hits, and of the cache lookup alone.  Every length must match the
+// uncached router's.
+
+#include "provided.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+const int REQUESTS = 20000;
+
+static double since(Clock::time_point start)
+{
+    return chrono::duration<double, micro>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    GeoCoord depotCoord("34.0625329", "-118.4470263");
+    unsigned int depot;
+    if (!sm.findNode(depotCoord, depot))
+    {
+        fprintf(stderr, "The depot isn't a node of this map\n");
+        return 1;
+    }
+    vector<unsigned int> near;
+    for (unsigned int n = 0; n < graph.nodeCount; n++)
+        if (distanceEarthMiles(depotCoord.latitude, depotCoord.longitude, graph.latitude[n], graph.longitude[n]) < 1.5)
+            near.push_back(n);
+
+    mt19937 rng(11);
+    vector<unsigned int> places(300);
+    vector<double> popularity(places.size());
+    for (size_t i = 0; i < places.size(); i++)
+    {
+        places[i] = near[rng() % near.size()];
+        popularity[i] = 1.0 / (i + 1);
+    }
+    discrete_distribution<int> zipf(popularity.begin(), popularity.end());
+    vector<pair<unsigned int, unsigned int> > requests;
+    for (int i = 0; i < REQUESTS; i++)
+    {
+        int kind = rng() % 3;
+        unsigned int a = places[zipf(rng)];
+        unsigned int b = places[zipf(rng)];
+        if (kind == 0)
+            requests.push_back(make_pair(depot, a));
+        else if (kind == 1)
+            requests.push_back(make_pair(a, b));
+        else
+            requests.push_back(make_pair(a, depot));
+    }
+
+    list<StreetSegment> route;
+    vector<double> lengths(REQUESTS);
+    PointToPointRouter plain(&sm);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < REQUESTS; i++)
+        plain.generatePointToPointRoute(requests[i].first, requests[i].second, route, lengths[i]);
+    printf("capacity  hit rate  time per request\n");
+    printf("no cache         -  %6.0f us\n", since(start) / REQUESTS);
+
+    int mismatches = 0;
+    double length;
+    for (unsigned int capacity = 100; capacity <= 10000; capacity *= 10)
+    {
+        RouteCache cache(capacity);
+        RouterOptions options;
+        options.cache = &cache;
+        PointToPointRouter router(&sm, options);
+        start = Clock::now();
+        for (int i = 0; i < REQUESTS; i++)
+        {
+            router.generatePointToPointRoute(requests[i].first, requests[i].second, route, length);
+            if (fabs(length - lengths[i]) > 1e-9)
+                mismatches++;
+        }
+        double time = since(start) / REQUESTS;
+        printf("%8u  %7.0f%%  %6.0f us\n", capacity, 100.0 * cache.hits() / REQUESTS, time);
+    }
+
+    // a cache big enough for every route, filled by a first pass
+    RouteCache cache(REQUESTS);
+    RouterOptions options;
+    options.cache = &cache;
+    PointToPointRouter router(&sm, options);
+    for (int i = 0; i < REQUESTS; i++)
+        router.generatePointToPointRoute(requests[i].first, requests[i].second, route, length);
+    start = Clock::now();
+    for (int i = 0; i < REQUESTS; i++)
+        router.generatePointToPointRoute(requests[i].first, requests[i].second, route, length);
+    printf("a request that hits: %.0f us\n", since(start) / REQUESTS);
+    CompactRoute found;
+    start = Clock::now();
+    for (int i = 0; i < REQUESTS; i++)
+        cache.find(requests[i].first, requests[i].second, sm.generation(), found);
+    printf("the lookup alone: %.2f us\n", since(start) / REQUESTS);
+
+    printf("%d lengths differ from the uncached router's\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+// concurrent_reads_bench.cpp
+
+// Lookups per second in total for 1, 2, 4, ... reader threads (up to the
+// number given, 4 by default) sharing a ConcurrentReads ExpandableHashMap
+// of 100,000 keys, while a writer updates a value every millisecond.  Each
+// count runs for half a second.  Readers only scale with the machine's
+// cores.
+
+#include "ExpandableHashMap.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace std;
+
+unsigned int hasher(const unsigned int& n)
+{
+    return n * 2654435761u;
+}
+
+const unsigned int KEYS = 100000;
+
+int main(int argc, char* argv[])
+{
+    int maxReaders = argc > 1 ? atoi(argv[1]) : 4;
+    ExpandableHashMap<unsigned int, unsigned int, ConcurrentReads> m;
+    for (unsigned int k = 0; k < KEYS; k++)
+        m.associate(k, k);
+
+    for (int readers = 1; readers <= maxReaders; readers *= 2)
+    {
+        atomic<bool> stop(false);
+        atomic<long> lookups(0);
+        vector<thread> threads;
+        for (int r = 0; r < readers; r++)
+        {
+            threads.push_back(thread([&, r]
+            {
+                mt19937 rng(r);
+                long n = 0;
+                unsigned int v;
+                while (!stop)
+                {
+                    for (int i = 0; i < 1000; i++)
+                        m.find(rng() % KEYS, v);
+                    n += 1000;
+                }
+                lookups += n;
+            }));
+        }
+        thread writer([&]
+        {
+            for (unsigned int i = 0; !stop; i++)
+            {
+                m.associate(i % KEYS, i);
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        });
+        this_thread::sleep_for(chrono::milliseconds(500));
+        stop = true;
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+        writer.join();
+        printf("%d reader threads: %.1f million lookups/s\n", readers, lookups / 0.5 / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+// fleet_bench.cpp
+
+// Time for FleetPlanner to plan 3,000 deliveries on 50 vehicles, from the
+// nodes one depot can reach, without time windows (planned by straight
+// line) and with them (planned by road), routing through a hierarchy built
+// first, with one thread and with as many as the machine has.  Each plan's
+// road miles, routes and unassigned deliveries are printed, and each is
+// checked: every delivery made once or left unassigned, no vehicle over
+// capacity or late, and the same routes for any number of threads.
+
+#include "provided.h"
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static double since(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Whether every delivery is made once or left unassigned, and no vehicle
+// carries more than capacity or arrives after a window has closed.
+static bool valid(const vector<FleetDelivery>& deliveries, double capacity, const vector<VehiclePlan>& vehicles,
+                  const vector<unsigned int>& unassigned)
+{
+    vector<int> seen(deliveries.size(), 0);
+    for (size_t v = 0; v < vehicles.size(); v++)
+    {
+        double load = 0;
+        for (size_t i = 0; i < vehicles[v].deliveries.size(); i++)
+        {
+            const FleetDelivery& d = deliveries[vehicles[v].deliveries[i]];
+            seen[vehicles[v].deliveries[i]]++;
+            load += d.load;
+            if (vehicles[v].arrival[i] > d.latest + 1e-9)
+                return false;
+        }
+        if (load > capacity + 1e-9)
+            return false;
+    }
+    for (size_t k = 0; k < unassigned.size(); k++)
+        seen[unassigned[k]]++;
+    for (size_t d = 0; d < seen.size(); d++)
+        if (seen[d] != 1)
+            return false;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    Clock::time_point start = Clock::now();
+    ContractionHierarchy hierarchy;
+    if (!hierarchy.build(&sm))
+    {
+        fprintf(stderr, "Couldn't build the hierarchy\n");
+        return 1;
+    }
+    printf("hierarchy built in %.2f s\n", since(start));
+
+    mt19937 rng(11);
+    unsigned int depotNode = rng() % graph.nodeCount;
+    vector<unsigned int> all(graph.nodeCount);
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        all[i] = i;
+    PointToPointRouter router(&sm);
+    vector<double> fromDepot;
+    router.computeDistanceMatrix(vector<unsigned int>(1, depotNode), all, fromDepot);
+    vector<unsigned int> reachable;
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        if (fromDepot[i] != numeric_limits<double>::infinity())
+            reachable.push_back(i);
+    GeoCoord depot = sm.coordOf(depotNode);
+
+    const unsigned int n = 3000, vehicleCount = 50;
+    int failures = 0;
+    printf("windows  threads  plan (s)  road miles  routes  unassigned\n");
+    for (int windows = 0; windows < 2; windows++)
+    {
+        vector<FleetDelivery> deliveries;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            DeliveryRequest request("item", sm.coordOf(reachable[rng() % reachable.size()]));
+            double load = 1 + rng() % 3;
+            if (windows)
+            {
+                double earliest = uniform_real_distribution<double>(0, 3)(rng);
+                double latest = earliest + uniform_real_distribution<double>(0.5, 1.5)(rng);
+                deliveries.push_back(FleetDelivery(request, load, earliest, latest));
+            }
+            else
+                deliveries.push_back(FleetDelivery(request, load));
+        }
+
+        vector<VehiclePlan> first;
+        const unsigned int threadCounts[] = { 1, 0 };   // 0 for as many as the machine has
+        for (int t = 0; t < 2; t++)
+        {
+            unsigned int threads = threadCounts[t];
+            FleetOptions options;
+            options.vehicleCount = vehicleCount;
+            options.capacity = 2.0 * n / vehicleCount * 1.25;
+            options.serviceTime = 0.02;
+            options.threads = threads;
+            options.router.hierarchy = &hierarchy;
+            FleetPlanner planner(&sm, options);
+            vector<VehiclePlan> vehicles;
+            vector<unsigned int> unassigned;
+            double total;
+            start = Clock::now();
+            DeliveryResult result = planner.generateFleetPlan(depot, deliveries, vehicles, unassigned, total);
+            double time = since(start);
+            unsigned int routes = 0;
+            for (size_t v = 0; v < vehicles.size(); v++)
+                if (!vehicles[v].deliveries.empty())
+                    routes++;
+            bool ok = result == DELIVERY_SUCCESS && valid(deliveries, options.capacity, vehicles, unassigned);
+            if (threads == 0)
+            {
+                for (size_t v = 0; v < vehicles.size(); v++)
+                    if (vehicles[v].deliveries != first[v].deliveries)
+                        ok = false;
+            }
+            else
+                first = vehicles;
+            if (!ok)
+                failures++;
+            printf("%-7s  %-7s  %8.3f  %10.1f  %6u  %10zu%s\n", windows ? "yes" : "no", threads ? "1" : "all",
+                   time, total, routes, unassigned.size(), ok ? "" : "  WRONG");
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
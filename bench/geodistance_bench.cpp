@@ -0,0 +1,77 @@
+// geodistance_bench.cpp
+
+// Straight-line distances per second, from one node of the map to all of
+// its nodes: distanceEarthMiles in a loop, distanceMiles with the cached
+// cosines, and distancesMiles in both modes with each kernel the processor
+// can run.
+
+#include "provided.h"
+#include "GeoDistance.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static void report(const char* what, Clock::time_point start, double pairs)
+{
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    printf("%-40s %6.1f million pairs/s\n", what, pairs / seconds / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    size_t nodes = graph.nodeCount;
+    const int ORIGINS = 300;
+    vector<double> out(nodes);
+    double sink = 0;    // so the loops can't be dropped
+
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < ORIGINS; r++)
+    {
+        for (size_t i = 0; i < nodes; i++)
+            out[i] = distanceEarthMiles(graph.latitude[r], graph.longitude[r], graph.latitude[i], graph.longitude[i]);
+        sink += out[nodes - 1 - r];
+    }
+    report("distanceEarthMiles in a loop", start, double(ORIGINS) * nodes);
+
+    start = Clock::now();
+    for (int r = 0; r < ORIGINS; r++)
+    {
+        for (size_t i = 0; i < nodes; i++)
+            out[i] = distanceMiles(graph.latitude[r], graph.longitude[r], graph.cosLatitude[r],
+                                   graph.latitude[i], graph.longitude[i], graph.cosLatitude[i]);
+        sink += out[nodes - 1 - r];
+    }
+    report("distanceMiles (cached cosines)", start, double(ORIGINS) * nodes);
+
+    const char* kernels[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+    const char* modes[] = { "great circle", "equirectangular" };
+    for (int k = SCALAR_KERNEL; k <= AVX512_KERNEL; k++)
+    {
+        if (!setGeoDistanceKernel(GeoDistanceKernel(k)))
+            continue;
+        for (int mode = GREAT_CIRCLE; mode <= EQUIRECTANGULAR; mode++)
+        {
+            start = Clock::now();
+            for (int r = 0; r < 3 * ORIGINS; r++)
+            {
+                distancesMiles(graph.latitude[r], graph.longitude[r], graph.latitude, graph.longitude,
+                               graph.cosLatitude, nodes, &out[0], GeoDistanceMode(mode));
+                sink += out[nodes - 1 - r];
+            }
+            char what[60];
+            snprintf(what, sizeof(what), "distancesMiles %s, %s", kernels[k], modes[mode]);
+            report(what, start, 3.0 * ORIGINS * nodes);
+        }
+    }
+    return sink < 0;
+}
@@ -0,0 +1,66 @@
+// hashmap_bench.cpp
+
+// Insert and lookup time per key for ExpandableHashMap's two layouts, with
+// 10,000, 100,000 and 1,000,000 random unsigned keys.  Inserting starts
+// from an empty table, so it includes growing it; lookups are half hits,
+// half misses.
+
+#include "ExpandableHashMap.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+using namespace std;
+
+unsigned int hasher(const unsigned int& n)
+{
+    return n * 2654435761u;
+}
+
+template<typename Map>
+bool run(const char* layout, const vector<unsigned int>& keys, const vector<unsigned int>& misses)
+{
+    typedef chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    Map m;
+    for (size_t i = 0; i < keys.size(); i++)
+        m.associate(keys[i], unsigned(i));
+    Clock::time_point inserted = Clock::now();
+    size_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        found += m.find(keys[i]) != nullptr;
+        found += m.find(misses[i]) != nullptr;
+    }
+    Clock::time_point looked = Clock::now();
+    printf("    %-8s insert %6.0f ns/key    lookup %5.0f ns\n", layout,
+           chrono::duration<double, nano>(inserted - start).count() / keys.size(),
+           chrono::duration<double, nano>(looked - inserted).count() / (2 * keys.size()));
+    return found == keys.size();
+}
+
+int main()
+{
+    bool ok = true;
+    for (size_t n : { 10000, 100000, 1000000 })
+    {
+        // odd keys are inserted and even ones missed, so no miss is a hit
+        mt19937 rng(static_cast<unsigned int>(n));
+        vector<unsigned int> keys(n);
+        vector<unsigned int> misses(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            keys[i] = rng() | 1;
+            misses[i] = rng() & ~1u;
+        }
+        printf("%zu keys\n", n);
+        ok &= run<ExpandableHashMap<unsigned int, unsigned int, ChainedBuckets> >("chained", keys, misses);
+        ok &= run<ExpandableHashMap<unsigned int, unsigned int, OpenAddressing> >("open", keys, misses);
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "A lookup found the wrong number of keys\n");
+        return 1;
+    }
+    return 0;
+}
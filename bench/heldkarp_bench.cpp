@@ -0,0 +1,82 @@
+// heldkarp_bench.cpp
+
+// Where exact ordering stops paying: the time of a whole
+// optimizeDeliveryOrder call ordering 8 to 20 deliveries exactly
+// (exactLimit 20) and by the local search alone (exactLimit 0), and how
+// far above the exact tour the local search's lands.  Stops are random
+// nodes the depot can reach; tours are straight lines; one thread.
+
+#include "provided.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static double optimize(const DeliveryOptimizer& optimizer, const GeoCoord& depot,
+                       vector<DeliveryRequest> deliveries, double& ms)
+{
+    double oldLength, newLength;
+    Clock::time_point start = Clock::now();
+    optimizer.optimizeDeliveryOrder(depot, deliveries, oldLength, newLength);
+    ms += chrono::duration<double, milli>(Clock::now() - start).count();
+    return newLength;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    mt19937 rng(9);
+    unsigned int depotNode = uniform_int_distribution<unsigned int>(0, graph.nodeCount - 1)(rng);
+    vector<unsigned int> all(graph.nodeCount);
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        all[i] = i;
+    PointToPointRouter router(&sm);
+    vector<double> fromDepot;
+    router.computeDistanceMatrix(vector<unsigned int>(1, depotNode), all, fromDepot);
+    vector<unsigned int> reachable;
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        if (fromDepot[i] != numeric_limits<double>::infinity())
+            reachable.push_back(i);
+    GeoCoord depot = sm.coordOf(depotNode);
+
+    OptimizerOptions options;
+    options.exactLimit = 20;
+    DeliveryOptimizer exact(&sm, options);
+    options.exactLimit = 0;
+    DeliveryOptimizer local(&sm, options);
+
+    int beaten = 0;
+    printf("deliveries       exact  local search  local search above exact (mean, worst)\n");
+    for (unsigned int m = 8; m <= 20; m++)
+    {
+        int sets = m <= 15 ? 20 : (m <= 18 ? 5 : 3);
+        double exactTime = 0, localTime = 0, above = 0, worst = 0;
+        for (int s = 0; s < sets; s++)
+        {
+            vector<DeliveryRequest> deliveries;
+            for (unsigned int i = 0; i < m; i++)
+                deliveries.push_back(DeliveryRequest("item", sm.coordOf(reachable[rng() % reachable.size()])));
+            double shortest = optimize(exact, depot, deliveries, exactTime);
+            double found = optimize(local, depot, deliveries, localTime);
+            if (found < shortest - 1e-9)
+                beaten++;
+            above += found / shortest - 1;
+            worst = max(worst, found / shortest - 1);
+        }
+        printf("%10u  %7.3f ms    %7.3f ms          %5.2f%%  %5.2f%%\n", m, exactTime / sets, localTime / sets,
+               100 * above / sets, 100 * worst);
+    }
+    printf("the local search beat the exact order %d times\n", beaten);
+    return beaten == 0 ? 0 : 1;
+}
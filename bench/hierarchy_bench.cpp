@@ -0,0 +1,111 @@
+// hierarchy_bench.cpp
+
+// Building, saving and loading a ContractionHierarchy for the map, then
+// time per query and nodes settled on 2,000 random pairs of nodes with A*
+// and with the hierarchy, both through PointToPointRouter, and the time of
+// the hierarchy's own search without building StreetSegments.  Every
+// length must match A*'s.  The hierarchy is saved to a scratch file in the
+// current directory, which is removed again.
+
+#include "provided.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static double since(Clock::time_point start)
+{
+    return chrono::duration<double, micro>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+
+    const char* scratch = "hierarchy_bench.ch";
+    Clock::time_point start = Clock::now();
+    ContractionHierarchy built;
+    if (!built.build(&sm) || !built.save(scratch))
+    {
+        fprintf(stderr, "Couldn't build and save the hierarchy\n");
+        return 1;
+    }
+    printf("build %.2f s, %u shortcuts for %u edges\n", since(start) / 1e6, built.shortcutCount(),
+           graph.firstEdge[graph.nodeCount]);
+    ContractionHierarchy ch;
+    start = Clock::now();
+    bool loaded = ch.load(scratch, &sm);
+    printf("load %.1f ms\n", since(start) / 1e3);
+    remove(scratch);
+    if (!loaded)
+    {
+        fprintf(stderr, "Couldn't load the saved hierarchy\n");
+        return 1;
+    }
+
+    const int QUERIES = 2000;
+    mt19937 rng(1);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+    vector<pair<unsigned int, unsigned int> > pairs;
+    for (int i = 0; i < QUERIES; i++)
+    {
+        unsigned int from = node(rng);
+        pairs.push_back(make_pair(from, node(rng)));
+    }
+
+    RouterOptions options;
+    options.hierarchy = &ch;
+    PointToPointRouter astar(&sm);
+    PointToPointRouter hierarchy(&sm, options);
+    vector<DeliveryResult> astarResult(QUERIES), hierarchyResult(QUERIES);
+    vector<double> astarLength(QUERIES), hierarchyLength(QUERIES);
+    list<StreetSegment> route;
+    unsigned long long astarSettled = 0, hierarchySettled = 0;
+
+    start = Clock::now();
+    for (int i = 0; i < QUERIES; i++)
+    {
+        astarResult[i] = astar.generatePointToPointRoute(pairs[i].first, pairs[i].second, route, astarLength[i]);
+        astarSettled += astar.nodesSettled();
+    }
+    double astarTime = since(start) / QUERIES;
+    start = Clock::now();
+    for (int i = 0; i < QUERIES; i++)
+    {
+        hierarchyResult[i] = hierarchy.generatePointToPointRoute(pairs[i].first, pairs[i].second,
+                                                                 route, hierarchyLength[i]);
+        hierarchySettled += hierarchy.nodesSettled();
+    }
+    double hierarchyTime = since(start) / QUERIES;
+
+    vector<unsigned int> edges;
+    double length;
+    unsigned int settled;
+    start = Clock::now();
+    for (int i = 0; i < QUERIES; i++)
+        ch.route(pairs[i].first, pairs[i].second, edges, length, settled);
+    double searchTime = since(start) / QUERIES;
+
+    printf("A*          %6.0f us/query  %5.0f nodes settled\n", astarTime, double(astarSettled) / QUERIES);
+    printf("hierarchy   %6.0f us/query  %5.0f nodes settled\n", hierarchyTime, double(hierarchySettled) / QUERIES);
+    printf("hierarchy search alone %.0f us/query\n", searchTime);
+
+    int mismatches = 0;
+    for (int i = 0; i < QUERIES; i++)
+        if (astarResult[i] != hierarchyResult[i] || fabs(astarLength[i] - hierarchyLength[i]) > 1e-9)
+            mismatches++;
+    printf("%d of %d routes differ from A*'s\n", mismatches, QUERIES);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// landmarks_bench.cpp
+
+// Build time, nodes settled and time per query for A* with 1, 2, 4, 8 and
+// 16 landmarks chosen each way, against the straight line alone, on 2,000
+// random pairs of nodes.  Nodes settled and time are averaged over the
+// reachable pairs.  Every length must match plain A*'s.
+
+#include "provided.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+const int QUERIES = 2000;
+
+// Route every pair, printing the averages over the reachable ones.  If
+// lengths is empty, fill it; otherwise return how many lengths differ.
+static int run(const char* heuristic, const PointToPointRouter& router,
+               const vector<pair<unsigned int, unsigned int> >& pairs, vector<double>& lengths)
+{
+    bool fill = lengths.empty();
+    list<StreetSegment> route;
+    unsigned long long settled = 0;
+    double time = 0;
+    int reachable = 0;
+    int mismatches = 0;
+    for (int i = 0; i < QUERIES; i++)
+    {
+        double length = 0;
+        Clock::time_point start = Clock::now();
+        DeliveryResult result = router.generatePointToPointRoute(pairs[i].first, pairs[i].second, route, length);
+        double us = chrono::duration<double, micro>(Clock::now() - start).count();
+        if (result == DELIVERY_SUCCESS)
+        {
+            settled += router.nodesSettled();
+            time += us;
+            reachable++;
+        }
+        if (fill)
+            lengths.push_back(length);
+        else if (fabs(length - lengths[i]) > 1e-9)
+            mismatches++;
+    }
+    printf("%-20s %6.0f settled  %5.0f us per query\n", heuristic, double(settled) / reachable, time / reachable);
+    return mismatches;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    mt19937 rng(1);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+    vector<pair<unsigned int, unsigned int> > pairs;
+    for (int i = 0; i < QUERIES; i++)
+    {
+        unsigned int from = node(rng);
+        pairs.push_back(make_pair(from, node(rng)));
+    }
+
+    vector<double> lengths;
+    PointToPointRouter plain(&sm);
+    run("straight line only", plain, pairs, lengths);
+
+    int mismatches = 0;
+    const char* names[] = { "farthest", "avoid" };
+    const Landmarks::Selection selections[] = { Landmarks::FARTHEST, Landmarks::AVOID };
+    for (int s = 0; s < 2; s++)
+    {
+        for (unsigned int count = 1; count <= 16; count *= 2)
+        {
+            Landmarks landmarks;
+            Clock::time_point start = Clock::now();
+            if (!landmarks.build(&sm, count, selections[s]))
+            {
+                fprintf(stderr, "Couldn't build %u landmarks\n", count);
+                return 1;
+            }
+            double ms = chrono::duration<double, milli>(Clock::now() - start).count();
+            RouterOptions options;
+            options.landmarks = &landmarks;
+            PointToPointRouter router(&sm, options);
+            char heuristic[40];
+            snprintf(heuristic, sizeof(heuristic), "%s, %u (%.0f ms)", names[s], count, ms);
+            mismatches += run(heuristic, router, pairs, lengths);
+        }
+    }
+    printf("%d routes differ from plain A*'s\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// matrix_bench.cpp
+
+// Time for PointToPointRouter::computeDistanceMatrix to fill a k x k matrix
+// for 10, 100 and 1,000 stops, spread over the whole map and within a mile
+// of the sample depot, with and without the paths, against an estimate of
+// k*k separate A* routes (timed on 200 of them).  Those 200 entries of the
+// spread matrices, and their paths, are checked against A*.
+
+#include "provided.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <list>
+#include <random>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static double since(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Whether path follows the graph's edges from one node to the other, and
+// adds up to the length distance says.
+static bool follows(const StreetGraph& graph, const CompactRoute& path, unsigned int from, unsigned int to,
+                    double distance)
+{
+    unsigned int at = from;
+    double length = 0;
+    for (size_t i = 0; i < path.edges.size(); i++)
+    {
+        unsigned int e = path.edges[i];
+        if (e < graph.firstEdge[at] || e >= graph.firstEdge[at + 1])
+            return false;
+        length += graph.edges[e].length;
+        at = graph.edges[e].end;
+    }
+    return at == to && fabs(length - distance) < 1e-9;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    PointToPointRouter router(&sm);
+    mt19937 rng(3);
+
+    // the depot of deliveries.txt
+    const double depotLatitude = 34.0625329;
+    const double depotLongitude = -118.4470263;
+    vector<unsigned int> near;
+    for (unsigned int n = 0; n < graph.nodeCount; n++)
+        if (distanceEarthMiles(depotLatitude, depotLongitude, graph.latitude[n], graph.longitude[n]) < 1.0)
+            near.push_back(n);
+
+    int mismatches = 0;
+    printf("stops  spread     with paths  near depot  separate A* routes (estimated)\n");
+    for (int k = 10; k <= 1000; k *= 10)
+    {
+        vector<unsigned int> spread(k), clustered(k);
+        for (int i = 0; i < k; i++)
+        {
+            spread[i] = rng() % graph.nodeCount;
+            clustered[i] = near[rng() % near.size()];
+        }
+
+        vector<double> distances, clusteredDistances;
+        vector<CompactRoute> paths;
+        Clock::time_point start = Clock::now();
+        router.computeDistanceMatrix(spread, spread, distances);
+        double spreadTime = since(start);
+        start = Clock::now();
+        router.computeDistanceMatrix(spread, spread, distances, &paths);
+        double pathsTime = since(start);
+        start = Clock::now();
+        router.computeDistanceMatrix(clustered, clustered, clusteredDistances);
+        double clusteredTime = since(start);
+
+        list<StreetSegment> route;
+        double separateTime = 0;
+        for (int t = 0; t < 200; t++)
+        {
+            int i = rng() % k;
+            int j = rng() % k;
+            double length;
+            start = Clock::now();
+            DeliveryResult result = router.generatePointToPointRoute(spread[i], spread[j], route, length);
+            separateTime += since(start);
+            double want = result == DELIVERY_SUCCESS ? length : numeric_limits<double>::infinity();
+            double got = distances[i * k + j];
+            if (!(want == got || fabs(want - got) < 1e-9))
+                mismatches++;
+            else if (result == DELIVERY_SUCCESS && !follows(graph, paths[i * k + j], spread[i], spread[j], got))
+                mismatches++;
+        }
+        printf("%5d  %7.0f ms %8.0f ms %8.0f ms  %10.0f ms\n", k, spreadTime, pathsTime, clusteredTime,
+               separateTime / 200 * k * k);
+    }
+    printf("%d sampled entries differ from A*\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+// rehash_bench.cpp
+
+// Latency of each of 1,000,000 associate() calls with random keys into the
+// chained ExpandableHashMap, growing by full rehash, growing incrementally,
+// and reserved up front so that it never grows.  Prints percentiles and a
+// histogram of the latencies for each.
+
+#include "ExpandableHashMap.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+using namespace std;
+
+unsigned int hasher(const unsigned int& n)
+{
+    return n * 2654435761u;
+}
+
+const int CALLS = 1000000;
+
+bool run(const char* mode, ExpandableHashMap<unsigned int, unsigned int>& m)
+{
+    typedef chrono::steady_clock Clock;
+    mt19937 rng(7);
+    vector<double> latency;
+    latency.reserve(CALLS);
+    for (int i = 0; i < CALLS; i++)
+    {
+        unsigned int key = rng();
+        Clock::time_point start = Clock::now();
+        m.associate(key, i);
+        latency.push_back(chrono::duration<double, nano>(Clock::now() - start).count());
+    }
+
+    const double limits[] = { 250, 1000, 4000, 16000, 64000, 256000, 1e6 };
+    const char* labels[] = { "<250ns", "<1us", "<4us", "<16us", "<64us", "<256us", "<1ms", ">=1ms" };
+    int counts[8] = { 0 };
+    for (size_t i = 0; i < latency.size(); i++)
+        counts[upper_bound(limits, limits + 7, latency[i]) - limits]++;
+
+    sort(latency.begin(), latency.end());
+    printf("%-14s p50 %5.0f ns  p99 %5.0f ns  p99.99 %7.0f ns  max %9.0f ns\n", mode,
+           latency[CALLS / 2], latency[CALLS / 100 * 99], latency[CALLS / 10000 * 9999], latency.back());
+    printf("   ");
+    for (int b = 0; b < 8; b++)
+        printf(" %s %d", labels[b], counts[b]);
+    printf("\n");
+
+    // every key must still be there
+    mt19937 again(7);
+    for (int i = 0; i < CALLS; i++)
+        if (m.find(again()) == nullptr)
+            return false;
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+    {
+        ExpandableHashMap<unsigned int, unsigned int> m;
+        ok &= run("full rehash", m);
+    }
+    {
+        ExpandableHashMap<unsigned int, unsigned int> m(0.5, true);
+        ok &= run("incremental", m);
+    }
+    {
+        ExpandableHashMap<unsigned int, unsigned int> m;
+        m.reserve(CALLS);
+        ok &= run("reserved", m);
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "A key went missing\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+// segments_bench.cpp
+
+// Allocations and time per call of the ways to get the segments leaving a
+// point: the copying getSegmentsThatStartWith, the non-copying
+// segmentsThatStartWith, and the graph's edgesFrom by node id, over every
+// node of the map.  Then allocations per node A* settles, over random
+// routes.  Allocations are counted by replacing operator new.
+
+#include "provided.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+using namespace std;
+
+static unsigned long long allocations = 0;
+
+void* operator new(size_t n)
+{
+    allocations++;
+    void* p = malloc(n == 0 ? 1 : n);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    vector<GeoCoord> coords;
+    for (unsigned int n = 0; n < graph.nodeCount; n++)
+        coords.push_back(sm.coordOf(n));
+
+    typedef chrono::steady_clock Clock;
+    size_t total = 0;
+    auto report = [&](const char* what, unsigned long long before, Clock::time_point start)
+    {
+        double ns = chrono::duration<double, nano>(Clock::now() - start).count();
+        printf("%-26s %6.2f allocations/call  %6.0f ns/call\n", what,
+               double(allocations - before) / coords.size(), ns / coords.size());
+    };
+
+    vector<StreetSegment> segs;
+    sm.getSegmentsThatStartWith(coords[0], segs);   // so segs has grown once already
+    unsigned long long before = allocations;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < coords.size(); i++)
+    {
+        sm.getSegmentsThatStartWith(coords[i], segs);
+        total += segs.size();
+    }
+    report("getSegmentsThatStartWith", before, start);
+
+    before = allocations;
+    start = Clock::now();
+    for (size_t i = 0; i < coords.size(); i++)
+        total += sm.segmentsThatStartWith(coords[i]).size();
+    report("segmentsThatStartWith", before, start);
+
+    before = allocations;
+    start = Clock::now();
+    for (unsigned int n = 0; n < graph.nodeCount; n++)
+        total += graph.edgesFrom(n).size();
+    report("edgesFrom", before, start);
+
+    // A*, after a few routes to warm up its workspace
+    PointToPointRouter router(&sm);
+    mt19937 rng(1);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+    CompactRoute route;
+    for (int i = 0; i < 20; i++)
+        router.generatePointToPointRoute(node(rng), node(rng), route);
+    unsigned long long settled = 0;
+    before = allocations;
+    for (int i = 0; i < 500; i++)
+    {
+        router.generatePointToPointRoute(node(rng), node(rng), route);
+        settled += router.nodesSettled();
+    }
+    printf("A*: %.4f allocations per node settled (%llu nodes over 500 routes)\n",
+           double(allocations - before) / settled, settled);
+    return total == 0;
+}
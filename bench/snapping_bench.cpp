@@ -0,0 +1,143 @@
+// snapping_bench.cpp
+
+// Time per query and share found for StreetMap::nearestNode and
+// nearestSegment over a million random points in the map's bounding box,
+// with radii of 25, 100 and 500 m and no limit, and the time to build the
+// spatial grid.  The first 2,000 points are then checked against a scan of
+// every node and segment: the distances found may exceed the scan's by no
+// more than the grid's flat projection allows.
+
+#include "provided.h"
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static double since(Clock::time_point start)
+{
+    return chrono::duration<double, micro>(Clock::now() - start).count();
+}
+
+static double meters(double lat1, double lon1, double lat2, double lon2)
+{
+    return distanceEarthKM(lat1, lon1, lat2, lon2) * 1000;
+}
+
+// The distance from p to the nearest point of any segment, projecting
+// onto each segment with longitude scaled by the cosine of p's latitude.
+static double scanSegments(const StreetGraph& graph, const GeoCoord& p)
+{
+    double c = cos(deg2rad(p.latitude));
+    double best = numeric_limits<double>::infinity();
+    for (unsigned int n = 0; n < graph.nodeCount; n++)
+    {
+        for (unsigned int e = graph.firstEdge[n]; e < graph.firstEdge[n + 1]; e++)
+        {
+            unsigned int m = graph.edges[e].end;
+            double dx = (graph.longitude[m] - graph.longitude[n]) * c;
+            double dy = graph.latitude[m] - graph.latitude[n];
+            double length2 = dx * dx + dy * dy;
+            double t = 0;
+            if (length2 > 0)
+                t = ((p.longitude - graph.longitude[n]) * c * dx + (p.latitude - graph.latitude[n]) * dy) / length2;
+            t = max(0.0, min(1.0, t));
+            best = min(best, meters(p.latitude, p.longitude,
+                                    graph.latitude[n] + t * (graph.latitude[m] - graph.latitude[n]),
+                                    graph.longitude[n] + t * (graph.longitude[m] - graph.longitude[n])));
+        }
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+
+    SpatialGrid grid;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < 20; i++)
+        grid.build(graph);
+    printf("building the grid: %.2f ms\n", since(start) / 20 / 1000);
+
+    double minLat = graph.latitude[0], maxLat = minLat;
+    double minLon = graph.longitude[0], maxLon = minLon;
+    for (unsigned int n = 1; n < graph.nodeCount; n++)
+    {
+        minLat = min(minLat, graph.latitude[n]);
+        maxLat = max(maxLat, graph.latitude[n]);
+        minLon = min(minLon, graph.longitude[n]);
+        maxLon = max(maxLon, graph.longitude[n]);
+    }
+    const int POINTS = 1000000;
+    mt19937 rng(7);
+    uniform_real_distribution<double> latitude(minLat, maxLat);
+    uniform_real_distribution<double> longitude(minLon, maxLon);
+    vector<GeoCoord> points(POINTS);
+    for (int i = 0; i < POINTS; i++)
+    {
+        points[i].latitude = latitude(rng);
+        points[i].longitude = longitude(rng);
+    }
+
+    printf("radius      nearest node         nearest segment\n");
+    const double radii[] = { 25, 100, 500, numeric_limits<double>::infinity() };
+    for (int r = 0; r < 4; r++)
+    {
+        unsigned int node;
+        int nodes = 0;
+        start = Clock::now();
+        for (int i = 0; i < POINTS; i++)
+            nodes += sm.nearestNode(points[i], radii[r], node);
+        double nodeTime = since(start) / POINTS;
+        SegmentSnap snap;
+        int segments = 0;
+        start = Clock::now();
+        for (int i = 0; i < POINTS; i++)
+            segments += sm.nearestSegment(points[i], radii[r], snap);
+        double segmentTime = since(start) / POINTS;
+        if (r < 3)
+            printf("%5.0f m  ", radii[r]);
+        else
+            printf("unlimited");
+        printf("  %.2f us  %3.0f%%       %.2f us  %3.0f%%\n", nodeTime, 100.0 * nodes / POINTS,
+               segmentTime, 100.0 * segments / POINTS);
+    }
+
+    int mismatches = 0;
+    double worst = 0;
+    start = Clock::now();
+    for (int i = 0; i < 2000; i++)
+    {
+        const GeoCoord& p = points[i];
+        double best = numeric_limits<double>::infinity();
+        for (unsigned int n = 0; n < graph.nodeCount; n++)
+            best = min(best, meters(p.latitude, p.longitude, graph.latitude[n], graph.longitude[n]));
+        unsigned int node;
+        sm.nearestNode(p, numeric_limits<double>::infinity(), node);
+        double found = meters(p.latitude, p.longitude, graph.latitude[node], graph.longitude[node]);
+        worst = max(worst, found / best - 1);
+        if (found > best * 1.002 + 1e-6)
+            mismatches++;
+
+        SegmentSnap snap;
+        sm.nearestSegment(p, numeric_limits<double>::infinity(), snap);
+        if (meters(p.latitude, p.longitude, snap.latitude, snap.longitude) > scanSegments(graph, p) * 1.002 + 1e-3)
+            mismatches++;
+    }
+    printf("against a scan of everything (%.1f ms a point): %d of 2,000 points differ, nearest nodes at most %.3f%% farther\n",
+           since(start) / 2000 / 1000, mismatches, worst * 100);
+    return mismatches == 0 ? 0 : 1;
+}
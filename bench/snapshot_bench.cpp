@@ -0,0 +1,57 @@
+// snapshot_bench.cpp
+
+// Startup time: loading a map's text with StreetMap::load against mapping a
+// compiled snapshot of it with StreetMap::loadSnapshot.  The snapshot is
+// written to a temporary file first.  Each load is timed five times, and
+// the snapshot's map is used once so that it is known to work.
+
+#include "provided.h"
+#include <chrono>
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <algorithm>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    string mapFile = argc > 1 ? argv[1] : "mapdata.txt";
+    string snapshotFile = "snapshot_bench.snap";
+    {
+        StreetMap sm;
+        if (!sm.load(mapFile)  ||  !sm.saveSnapshot(snapshotFile))
+        {
+            cerr << "Couldn't load " << mapFile << " or write " << snapshotFile << endl;
+            return 1;
+        }
+    }
+
+    typedef chrono::steady_clock Clock;
+    double bestText = 1e300, bestSnapshot = 1e300;
+    for (int run = 0; run < 5; run++)
+    {
+        Clock::time_point t0 = Clock::now();
+        {
+            StreetMap sm;
+            sm.load(mapFile);
+        }
+        Clock::time_point t1 = Clock::now();
+        {
+            StreetMap sm;
+            if (!sm.loadSnapshot(snapshotFile)  ||  sm.graph().nodeCount == 0)
+            {
+                cerr << "Couldn't load the snapshot" << endl;
+                return 1;
+            }
+        }
+        Clock::time_point t2 = Clock::now();
+        double text = chrono::duration<double, milli>(t1 - t0).count();
+        double snapshot = chrono::duration<double, milli>(t2 - t1).count();
+        cout << "run " << run + 1 << ": text " << text << " ms, snapshot " << snapshot << " ms" << endl;
+        bestText = min(bestText, text);
+        bestSnapshot = min(bestSnapshot, snapshot);
+    }
+    cout << "best: text " << bestText << " ms, snapshot " << bestSnapshot << " ms" << endl;
+    remove(snapshotFile.c_str());
+    return 0;
+}
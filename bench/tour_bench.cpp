@@ -0,0 +1,145 @@
+// tour_bench.cpp
+
+// Tour quality and time of DeliveryOptimizer's local search for random sets
+// of 10 to 1,000 stops drawn from the map's nodes, with the depot at
+// another random node.  Columns, in straight-line miles averaged over the
+// sets: the order generated, the nearest neighbor tour alone, the
+// optimizer's result, and a reference, the best of that result and of 10
+// runs of the same search from random orders with 60-long neighbor lists
+// (for 10 stops, the exact optimum).  Every result must be a permutation
+// of the deliveries, with old and new lengths as distanceEarthMiles gives.
+
+#include "provided.h"
+#include "GeoDistance.h"
+#include "HeldKarp.h"
+#include "TourSearch.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+static double tourLength(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+    double length = distanceEarthMiles(depot, deliveries.front().location);
+    for (size_t i = 0; i + 1 < deliveries.size(); i++)
+        length += distanceEarthMiles(deliveries[i].location, deliveries[i + 1].location);
+    return length + distanceEarthMiles(deliveries.back().location, depot);
+}
+
+static vector<string> sortedLocations(const vector<DeliveryRequest>& deliveries)
+{
+    vector<string> locations;
+    for (size_t i = 0; i < deliveries.size(); i++)
+        locations.push_back(deliveries[i].location.latitudeText + "," + deliveries[i].location.longitudeText);
+    sort(locations.begin(), locations.end());
+    return locations;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    OptimizerOptions options;
+    options.exactLimit = 0;     // the local search even for 10 stops
+    DeliveryOptimizer optimizer(&sm, options);
+
+    int problems = 0;
+    printf("     n  sets  arrival       NN    final      ref   above ref (worst)   time\n");
+    const unsigned int sizes[] = { 10, 20, 50, 100, 200, 500, 1000 };
+    for (int z = 0; z < 7; z++)
+    {
+        unsigned int n = sizes[z];
+        int sets = n <= 100 ? 20 : (n <= 500 ? 5 : 3);
+        double arrival = 0, nearest = 0, final = 0, reference = 0, ms = 0, worst = 0;
+        for (int s = 0; s < sets; s++)
+        {
+            mt19937 rng(n * 1000 + s);
+            uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+            GeoCoord depot = sm.coordOf(node(rng));
+            vector<DeliveryRequest> deliveries;
+            for (unsigned int i = 0; i < n; i++)
+                deliveries.push_back(DeliveryRequest("item", sm.coordOf(node(rng))));
+            vector<DeliveryRequest> given = deliveries;
+
+            double oldLength, newLength;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            optimizer.optimizeDeliveryOrder(depot, deliveries, oldLength, newLength);
+            ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (sortedLocations(deliveries) != sortedLocations(given) ||
+                fabs(tourLength(depot, deliveries) - newLength) > 1e-9 ||
+                fabs(tourLength(depot, given) - oldLength) > 1e-9)
+                problems++;
+
+            // point 0 is the depot, and point i+1 the given delivery i
+            unsigned int m = n + 1;
+            vector<double> lat(m), lon(m), cosLat(m);
+            lat[0] = depot.latitude;
+            lon[0] = depot.longitude;
+            for (unsigned int i = 0; i < n; i++)
+            {
+                lat[i + 1] = given[i].location.latitude;
+                lon[i + 1] = given[i].location.longitude;
+            }
+            for (unsigned int i = 0; i < m; i++)
+                cosLat[i] = cos(deg2rad(lat[i]));
+            auto crow = [&](unsigned int a, unsigned int b)
+            {
+                return distanceMiles(lat[a], lon[a], cosLat[a], lat[b], lon[b], cosLat[b]);
+            };
+            auto row = [&](unsigned int p, double* out)
+            {
+                distancesMiles(lat[p], lon[p], &lat[0], &lon[0], &cosLat[0], m, out);
+            };
+
+            NeighborLists ten;
+            ten.build(m, 10, row);
+            TourSearch<decltype(crow)> nn(crow, ten);
+            nn.nearestNeighbor(0);
+
+            double best = newLength;
+            if (n <= 10)
+            {
+                HeldKarp exact;
+                vector<unsigned int> order;
+                exact.solve(crow, m, 1, order);
+                TourSearch<decltype(crow)> tour(crow, ten);
+                tour.setOrder(order);
+                best = tour.length();
+            }
+            else
+            {
+                NeighborLists sixty;
+                sixty.build(m, 60, row);
+                for (int r = 0; r < 10; r++)
+                {
+                    vector<unsigned int> order(m);
+                    for (unsigned int i = 0; i < m; i++)
+                        order[i] = i;
+                    shuffle(order.begin(), order.end(), rng);
+                    TourSearch<decltype(crow)> search(crow, sixty);
+                    search.setOrder(order);
+                    search.improve();
+                    best = min(best, search.length());
+                }
+            }
+            arrival += oldLength;
+            nearest += nn.length();
+            final += newLength;
+            reference += best;
+            worst = max(worst, newLength / best - 1);
+        }
+        printf("%6u  %4d %8.2f %8.2f %8.2f %8.2f   %5.2f%% (%5.2f%%)  %7.2f ms\n", n, sets, arrival / sets,
+               nearest / sets, final / sets, reference / sets, 100 * (final / reference - 1), 100 * worst, ms / sets);
+    }
+    printf("%d results weren't a permutation or were mismeasured\n", problems);
+    return problems == 0 ? 0 : 1;
+}
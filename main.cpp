@@ -9,17 +9,38 @@ using namespace std;
 bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v);
 bool parseDelivery(string line, string& lat, string& lon, string& item);
 
+bool endsWith(const string& s, const string& suffix);
+
 int main(int argc, char *argv[])
 {
+    if (argc == 4  &&  string(argv[1]) == "--compile")
+    {
+        StreetMap sm;
+        if (!sm.load(argv[2]))
+        {
+            cout << "Unable to load map data file " << argv[2] << endl;
+            return 1;
+        }
+        if (!sm.saveSnapshot(argv[3]))
+        {
+            cout << "Unable to write map snapshot " << argv[3] << endl;
+            return 1;
+        }
+        return 0;
+    }
+
     if (argc != 3)
     {
         cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt" << endl;
+        cout << "       " << argv[0] << " mapdata.snap deliveries.txt" << endl;
+        cout << "       " << argv[0] << " --compile mapdata.txt mapdata.snap" << endl;
         return 1;
     }
 
     StreetMap sm;
         
-    if (!sm.load(argv[1]))
+    bool loaded = endsWith(argv[1], ".snap") ? sm.loadSnapshot(argv[1]) : sm.load(argv[1]);
+    if (!loaded)
     {
         cout << "Unable to load map data file " << argv[1] << endl;
         return 1;
@@ -100,3 +121,8 @@ bool parseDelivery(string line, string& lat, string& lon, string& item)
     }
     return true;
 }
+
+bool endsWith(const string& s, const string& suffix)
+{
+    return s.size() >= suffix.size()  &&  s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
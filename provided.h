@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <limits>
 
 enum DeliveryResult
 {
@@ -51,18 +52,27 @@ bool operator<(const GeoCoord& lhs, const GeoCoord& rhs)
     return lhs.longitudeText < rhs.longitudeText;
 }
 
+  // street name id for a segment that didn't come from a StreetMap
+const unsigned int NO_STREET_NAME = 0xffffffff;
+
 struct StreetSegment
 {
     StreetSegment(const GeoCoord& s, const GeoCoord& e, std::string streetName)
-     : start(s), end(e), name(streetName)
+     : start(s), end(e), name(streetName), nameId(NO_STREET_NAME)
+    {}
+
+    StreetSegment(const GeoCoord& s, const GeoCoord& e, std::string streetName, unsigned int streetNameId)
+     : start(s), end(e), name(streetName), nameId(streetNameId)
     {}
 
     StreetSegment()
+     : nameId(NO_STREET_NAME)
     {}
 
     GeoCoord start;
     GeoCoord end;
     std::string name;
+    unsigned int nameId;    // the StreetMap's id for name; segments on the same street share it
 };
 
 inline
@@ -71,15 +81,94 @@ bool operator==(const StreetSegment& lhs, const StreetSegment& rhs)
     return lhs.start == rhs.start  &&  lhs.end == rhs.end;
 }
 
+  // One direction of a street segment, as stored in a StreetMap's graph.
+struct StreetEdge
+{
+    unsigned int end;       // node id of the segment's end
+    unsigned int name;      // street name id; see StreetMap::streetName
+    double       length;    // in miles
+};
+
+  // A view of consecutive StreetEdges; making or copying one costs nothing.
+struct StreetEdgeRange
+{
+    const StreetEdge* first;
+    const StreetEdge* last;
+    const StreetEdge* begin() const { return first; }
+    const StreetEdge* end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+  // Flat arrays describing a loaded StreetMap as a graph.  Every coordinate
+  // that starts or ends a segment has a dense node id in [0, nodeCount), and
+  // the segments leaving node n are edges[firstEdge[n]] up to (but not
+  // including) edges[firstEdge[n+1]].  edges[e] heads angle[e] degrees
+  // counterclockwise from east, as angleOfLine measures it, and
+  // cosLatitude[n] is cos(deg2rad(latitude[n])), for distanceMiles and
+  // distancesMiles in GeoDistance.h.  component[n] is the lowest node id in
+  // n's connected part of the map, so two nodes have the same one exactly
+  // when a route joins them (segments go both ways).  The arrays stay valid
+  // until the map is loaded again or destroyed.
+struct StreetGraph
+{
+    unsigned int        nodeCount;
+    const double*       latitude;
+    const double*       longitude;
+    const double*       cosLatitude;
+    const unsigned int* firstEdge;
+    const StreetEdge*   edges;
+    const float*        angle;
+    const unsigned int* component;
+
+    StreetEdgeRange edgesFrom(unsigned int node) const
+    {
+        StreetEdgeRange r = { edges + firstEdge[node], edges + firstEdge[node+1] };
+        return r;
+    }
+};
+
+  // Where a coordinate falls on its nearest street segment.
+struct SegmentSnap
+{
+    unsigned int fromNode;  // the segment, as an edge of a StreetMap's graph leaving fromNode
+    unsigned int edge;
+    double fraction;        // how far along the edge the nearest point is: 0 at fromNode, 1 at its end
+    double latitude;        // the nearest point
+    double longitude;
+    double distance;        // from the coordinate to the nearest point, in meters
+};
+
 class StreetMapImpl;
 
+  // Once loaded, a StreetMap never changes until it is loaded again, so any
+  // number of threads may call its const member functions at the same time.
 class StreetMap
 {
 public:
     StreetMap();
     ~StreetMap();
     bool load(std::string mapFile);
+      // A snapshot is a compiled, checksummed binary image of a loaded map.
+      // Loading one maps it into memory without parsing anything.
+    bool loadSnapshot(std::string snapshotFile);
+    bool saveSnapshot(std::string snapshotFile) const;
     bool getSegmentsThatStartWith(const GeoCoord& gc, std::vector<StreetSegment>& segs) const;
+      // The segments starting at gc, as edges of graph(), without copying
+      // anything.  The range is empty if gc is not in the map.
+    StreetEdgeRange segmentsThatStartWith(const GeoCoord& gc) const;
+    const StreetGraph& graph() const;
+      // A number identifying what the map holds right now; it changes
+      // whenever the map is loaded, and no two maps ever share one.
+    unsigned int generation() const;
+    bool findNode(const GeoCoord& gc, unsigned int& node) const;
+      // The node, or the point on a segment, nearest gc and at most
+      // radiusMeters from it; false if there's none.  These search a grid
+      // built when the map is loaded, and take a few microseconds.
+    bool nearestNode(const GeoCoord& gc, double radiusMeters, unsigned int& node) const;
+    bool nearestSegment(const GeoCoord& gc, double radiusMeters, SegmentSnap& snap) const;
+    GeoCoord coordOf(unsigned int node) const;
+    std::string streetName(unsigned int name) const;
       // We prevent a StreetMap object from being copied or assigned.
     StreetMap(const StreetMap&) = delete;
     StreetMap& operator=(const StreetMap&) = delete;
@@ -87,18 +176,175 @@ private:
     StreetMapImpl* m_impl;
 };
 
+  // A route as the edges of a StreetMap's graph it follows (indexes into
+  // the graph's edges array, in order), without building StreetSegments.
+struct CompactRoute
+{
+    CompactRoute()
+     : length(0)
+    {}
+
+    std::vector<unsigned int> edges;
+    double length;      // in miles
+};
+
+class ContractionHierarchyImpl;
+
+  // A contraction hierarchy is preprocessing over a StreetMap's graph that
+  // answers shortest route queries while settling only a few hundred nodes.
+  // Building one for mapdata.txt takes a few seconds; saving it lets later
+  // runs load it instead.  A hierarchy can only be loaded with the map it
+  // was built from, and must not outlive that map.  A router ignores one
+  // built for another map, or for its map before that was loaded again.
+class ContractionHierarchy
+{
+public:
+    ContractionHierarchy();
+    ~ContractionHierarchy();
+    bool build(const StreetMap* sm);
+    bool load(std::string hierarchyFile, const StreetMap* sm);
+    bool save(std::string hierarchyFile) const;
+    bool isBuilt() const;
+      // whether it was built or loaded from sm as sm is now; a map loaded
+      // again since has a new generation, and its node ids needn't match
+    bool isBuiltFor(const StreetMap* sm) const;
+    unsigned int shortcutCount() const;
+      // The shortest route between two nodes of the map's graph, as indexes
+      // into the graph's edges array in order from startNode.  Returns false
+      // if there is no route.
+    bool route(unsigned int startNode, unsigned int endNode, std::vector<unsigned int>& edges,
+               double& length, unsigned int& nodesSettled) const;
+      // The lengths of the shortest routes from each source node to each
+      // target node, laid out as PointToPointRouter::computeDistanceMatrix
+      // lays them out, with infinity where there is no route.  This takes one
+      // search up the hierarchy from each node rather than a query per pair,
+      // so a few hundred nodes take milliseconds.
+    void distanceMatrix(const std::vector<unsigned int>& sources, const std::vector<unsigned int>& targets,
+                        std::vector<double>& distances) const;
+      // We prevent a ContractionHierarchy object from being copied or assigned.
+    ContractionHierarchy(const ContractionHierarchy&) = delete;
+    ContractionHierarchy& operator=(const ContractionHierarchy&) = delete;
+private:
+    ContractionHierarchyImpl* m_impl;
+};
+
+class LandmarksImpl;
+
+  // Landmarks are preprocessing over a StreetMap's graph that gives A* a
+  // tighter lower bound on route lengths than the straight line (the ALT
+  // heuristic).  More landmarks give tighter bounds, at two bytes per node
+  // each.  Landmarks must not outlive the map they were built from, and a
+  // router ignores landmarks built for another map, or for its map before
+  // that was loaded again: their bounds could overestimate.
+class Landmarks
+{
+public:
+    enum Selection
+    {
+        FARTHEST,   // spread out by straight-line distance; the searches run in parallel
+        AVOID       // each covers the routes the earlier ones bound worst; slower to build
+    };
+    Landmarks();
+    ~Landmarks();
+    bool build(const StreetMap* sm, unsigned int count, Selection how = AVOID);
+    bool isBuilt() const;
+      // whether they were built from sm as sm is now, as for a
+      // ContractionHierarchy
+    bool isBuiltFor(const StreetMap* sm) const;
+    unsigned int count() const;
+    unsigned int landmark(unsigned int i) const;
+      // no route between the nodes is shorter than this; infinity if the
+      // landmarks show there's no route at all
+    double lowerBound(unsigned int fromNode, unsigned int toNode) const;
+      // We prevent a Landmarks object from being copied or assigned.
+    Landmarks(const Landmarks&) = delete;
+    Landmarks& operator=(const Landmarks&) = delete;
+private:
+    LandmarksImpl* m_impl;
+};
+
+class RouteCacheImpl;
+
+  // A bounded cache of routes, keyed by start and end node, that any number
+  // of routers and threads can share.  Each entry is tagged with the
+  // StreetMap's generation when it was stored, so routes on a map that has
+  // since been reloaded are never returned; invalidate() drops everything at
+  // once.  The least recently used route goes when a shard is full.
+class RouteCache
+{
+public:
+    RouteCache(unsigned int capacity, unsigned int shards = 16);
+    ~RouteCache();
+    bool find(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, CompactRoute& route);
+    void insert(unsigned int startNode, unsigned int endNode, unsigned int mapGeneration, const CompactRoute& route);
+    void invalidate();
+    unsigned int size() const;
+    unsigned long long hits() const;
+    unsigned long long misses() const;
+    unsigned long long evictions() const;   // including routes dropped as stale
+      // We prevent a RouteCache object from being copied or assigned.
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+private:
+    RouteCacheImpl* m_impl;
+};
+
+  // How a PointToPointRouter searches.  Every option gives the same routes.
+struct RouterOptions
+{
+    RouterOptions()
+     : hierarchy(nullptr), bidirectional(false), landmarks(nullptr), cache(nullptr)
+    {}
+
+    const ContractionHierarchy* hierarchy;  // if built for the router's map, answer queries from it instead of A*
+    bool bidirectional;     // search from both ends at once; pays off most on long routes
+    const Landmarks* landmarks;     // if built for the router's map, tighten A*'s heuristic with them
+    RouteCache* cache;      // if set, look routes up here first, and store new ones
+};
+
 class PointToPointRouterImpl;
 
 class PointToPointRouter
 {
 public:
     PointToPointRouter(const StreetMap* sm);
+    PointToPointRouter(const StreetMap* sm, const RouterOptions& options);
     ~PointToPointRouter();
     DeliveryResult generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         std::list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+      // the same, for nodes of the StreetMap's graph
+    DeliveryResult generatePointToPointRoute(
+        unsigned int startNode,
+        unsigned int endNode,
+        std::list<StreetSegment>& route,
+        double& totalDistanceTravelled) const;
+      // the same, as the edges the route follows and its length, without
+      // building any StreetSegments
+    DeliveryResult generatePointToPointRoute(
+        unsigned int startNode,
+        unsigned int endNode,
+        CompactRoute& route) const;
+      // Road distances between nodes of the StreetMap's graph, far cheaper
+      // than routing each pair separately.  distances[i * targets.size() + j]
+      // is the length of the shortest route from sources[i] to targets[j], or
+      // infinity if there is none; if paths isn't null, (*paths)[i *
+      // targets.size() + j] is that route.  Many sources are shared among
+      // threads; a few are searched from on the calling thread, allocating
+      // nothing once its workspaces have grown.  Given a built hierarchy
+      // and no paths, the distances come from
+      // ContractionHierarchy::distanceMatrix, far faster again.  Returns
+      // BAD_COORD if any node isn't in the graph.
+    DeliveryResult computeDistanceMatrix(
+        const std::vector<unsigned int>& sources,
+        const std::vector<unsigned int>& targets,
+        std::vector<double>& distances,
+        std::vector<CompactRoute>* paths = nullptr) const;
+      // how many nodes the last route generated on the calling thread
+      // settled; each thread has its own count, so threads can share a router
+    unsigned int nodesSettled() const;
       // We prevent a PointToPointRouter object from being copied or assigned.
     PointToPointRouter(const PointToPointRouter&) = delete;
     PointToPointRouter& operator=(const PointToPointRouter&) = delete;
@@ -115,18 +361,67 @@ struct DeliveryRequest
     GeoCoord location;
 };
 
+  // How hard a DeliveryOptimizer works.  Up to exactLimit deliveries, it
+  // finds the shortest order there is, by dynamic programming over the sets
+  // of deliveries; that takes about 4ms for 15 deliveries, and more than
+  // doubles with each one added.  For more, it runs one local search, which
+  // takes a few milliseconds even for a thousand deliveries.
+  // Given a time budget or a number of rounds, it then keeps kicking the tour
+  // out of its local optimum and searching again (iterated local search),
+  // on several threads at once, until the budget or the rounds run out.
+  // Each round, every thread makes a fixed number of kicks from the best
+  // tour so far, and the best tour is chosen between rounds, so the result
+  // depends only on the seed, the thread count and the number of rounds
+  // completed; the time budget is only checked between rounds.  With a
+  // number of rounds and no time budget, the result is fully reproducible.
+  //
+  // Tours are measured in straight lines unless roadDistance is set.  Then
+  // the optimizer finds every stop on the map as a DeliveryPlanner would,
+  // measures the shortest route between each pair once, and orders the
+  // deliveries by the total length of the routes.  If a stop can't be found
+  // on the map, or one can't be reached from another, it falls back to
+  // straight lines.
+struct OptimizerOptions
+{
+    OptimizerOptions()
+     : exactLimit(15), timeBudget(0), rounds(0), threads(1), seed(1), roadDistance(false), snapRadius(0), router()
+    {}
+
+    unsigned int exactLimit;    // the most deliveries to order exactly; at most 20
+    double timeBudget;      // in seconds; 0 for no time limit
+    unsigned int rounds;    // the most rounds to run; 0 for no limit but the time budget
+    unsigned int threads;   // for the search or the dynamic program; 0 for as many as the machine has
+    unsigned int seed;
+    bool roadDistance;      // order by the length of the routes between stops, not straight lines
+    double snapRadius;      // for finding stops on the map, as in PlannerOptions
+    RouterOptions router;   // how the routes between stops are measured; a built hierarchy is fastest
+};
+
 class DeliveryOptimizerImpl;
 
 class DeliveryOptimizer
 {
 public:
     DeliveryOptimizer(const StreetMap* sm);
+    DeliveryOptimizer(const StreetMap* sm, const OptimizerOptions& options);
     ~DeliveryOptimizer();
     void optimizeDeliveryOrder(
         const GeoCoord& depot,
         std::vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
         double& newCrowDistance) const;
+      // The same, also giving the length of the routes from the depot through
+      // the deliveries and back, before and after, as a DeliveryPlanner with
+      // the same snapRadius would route them; infinity if a stop can't be
+      // found on the map or reached.  When ordering by road distance, the
+      // new crow distance may be longer than the old.
+    void optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        std::vector<DeliveryRequest>& deliveries,
+        double& oldCrowDistance,
+        double& newCrowDistance,
+        double& oldRoadDistance,
+        double& newRoadDistance) const;
       // We prevent a DeliveryOptimizer object from being copied or assigned.
     DeliveryOptimizer(const DeliveryOptimizer&) = delete;
     DeliveryOptimizer& operator=(const DeliveryOptimizer&) = delete;
@@ -138,7 +433,7 @@ class DeliveryCommand
 {
 public:
     DeliveryCommand()
-     : m_type(INVALID)
+     : m_type(INVALID), m_map(nullptr), m_streetNameId(NO_STREET_NAME)
     {}
 
       // make this DeliveryCommand a Proceed command
@@ -146,6 +441,21 @@ public:
     {
         m_type = PROCEED;
         m_streetName = streetName;
+        m_map = nullptr;
+        m_streetNameId = NO_STREET_NAME;
+        m_direction = dir;
+        m_distance = dist;
+    }
+
+      // the same, naming the street by its id in a StreetMap; the name's
+      // text is only looked up when the command is described, so the map
+      // must still exist, unreloaded, when streetName() or description() is
+      // called
+    void initAsProceedCommand(std::string dir, const StreetMap* map, unsigned int streetNameId, double dist)
+    {
+        m_type = PROCEED;
+        m_map = map;
+        m_streetNameId = streetNameId;
         m_direction = dir;
         m_distance = dist;
     }
@@ -155,6 +465,17 @@ public:
     {
         m_type = TURN;
         m_streetName = streetName;
+        m_map = nullptr;
+        m_streetNameId = NO_STREET_NAME;
+        m_direction = dir;
+        m_distance = 0;
+    }
+
+    void initAsTurnCommand(std::string dir, const StreetMap* map, unsigned int streetNameId)
+    {
+        m_type = TURN;
+        m_map = map;
+        m_streetNameId = streetNameId;
         m_direction = dir;
         m_distance = 0;
     }
@@ -173,7 +494,12 @@ public:
 
     std::string streetName() const
     {
-        return m_streetName;
+        return m_map ? m_map->streetName(m_streetNameId) : m_streetName;
+    }
+
+    unsigned int streetNameId() const
+    {
+        return m_streetNameId;
     }
 
     std::string description() const
@@ -185,12 +511,12 @@ public:
             oss << "<invalid>";
             break;
           case TURN:
-            oss << "Turn " << m_direction << " on " << m_streetName;
+            oss << "Turn " << m_direction << " on " << streetName();
             break;
           case PROCEED:
             oss.setf(std::ios::fixed);
             oss.precision(2);
-            oss << "Proceed " << m_direction << " on " << m_streetName << " for " << m_distance << " miles";
+            oss << "Proceed " << m_direction << " on " << streetName() << " for " << m_distance << " miles";
             break;
           case DELIVER:
             oss << "DELIVER " << m_item;
@@ -203,23 +529,56 @@ private:
     enum CommandType { INVALID, PROCEED, TURN, DELIVER };
     CommandType m_type;        // turn left, turn right, proceed
     std::string  m_streetName;  // Westwood Blvd
+    const StreetMap* m_map;     // if set, the street is m_streetNameId in this map, which must outlive
+                                // the command and not be loaded again while it's described
+    unsigned int m_streetNameId;
     std::string  m_direction;   // "left" for turn or "northeast" for proceed
     std::string  m_item;        // Item to deliver
     double       m_distance;    // 1.92 (in miles)
 };
 
+  // How a DeliveryPlanner treats the depot and delivery coordinates.
+struct PlannerOptions
+{
+    PlannerOptions()
+     : snapRadius(0), optimizer(), keepOrder(false), router()
+    {}
+
+      // in meters; if positive, a coordinate that isn't the end of a segment
+      // is moved to the nearest point on a segment this close to it, and
+      // routes start or end partway along that segment, instead of the plan
+      // failing with BAD_COORD
+    double snapRadius;
+    OptimizerOptions optimizer;     // for ordering the deliveries; its snapRadius is replaced by the one above
+    bool keepOrder;         // make the deliveries in the order given, without optimizing it
+    RouterOptions router;   // how routes between the stops are found
+};
+
 class DeliveryPlannerImpl;
 
+  // The commands a plan gives name their streets through the planner's
+  // StreetMap, so the map must outlive them, and not be loaded again, for as
+  // long as they are described.
 class DeliveryPlanner
 {
 public:
     DeliveryPlanner(const StreetMap* sm);
+    DeliveryPlanner(const StreetMap* sm, const PlannerOptions& options);
     ~DeliveryPlanner();
     DeliveryResult generateDeliveryPlan(
         const GeoCoord& depot,
         const std::vector<DeliveryRequest>& deliveries,
         std::vector<DeliveryCommand>& commands,
         double& totalDistanceTravelled) const;
+      // The same, also giving the length of each leg driven: from the depot
+      // to the first delivery made, between each delivery and the next, and
+      // from the last back to the depot.
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        std::vector<DeliveryCommand>& commands,
+        double& totalDistanceTravelled,
+        std::vector<double>& legDistances) const;
       // We prevent a DeliveryPlanner object from being copied or assigned.
     DeliveryPlanner(const DeliveryPlanner&) = delete;
     DeliveryPlanner& operator=(const DeliveryPlanner&) = delete;
@@ -227,6 +586,90 @@ private:
     DeliveryPlannerImpl* m_impl;
 };
 
+  // A delivery for one of a fleet of vehicles: how much of a vehicle's
+  // capacity it takes, and when it may be made, in hours after the vehicles
+  // leave the depot.  A vehicle arriving before earliest waits; one that
+  // can't arrive by latest can't make the delivery.
+struct FleetDelivery
+{
+    FleetDelivery(const DeliveryRequest& req, double ld = 1, double from = 0,
+                  double until = std::numeric_limits<double>::infinity())
+     : request(req), load(ld), earliest(from), latest(until)
+    {}
+
+    DeliveryRequest request;
+    double load;
+    double earliest;
+    double latest;
+};
+
+  // The fleet a FleetPlanner plans for, and how it plans.  Travel times are
+  // distance over speed.  The routes are planned by straight-line distance
+  // unless roadDistance is set or some delivery has a window that closes,
+  // which only road distances can be sure of keeping to; then a built
+  // hierarchy in router is all but needed for thousands of deliveries, and
+  // the road distance matrix takes 16 bytes per pair of them.  Either way,
+  // the arrival times given are for the routes the directions drive.
+struct FleetOptions
+{
+    FleetOptions()
+     : vehicleCount(1), capacity(std::numeric_limits<double>::infinity()), speed(20), serviceTime(0),
+       timeBudget(0), threads(0), roadDistance(false), snapRadius(0), router()
+    {}
+
+    unsigned int vehicleCount;
+    double capacity;        // of each vehicle, in the units of FleetDelivery::load
+    double speed;           // in miles per hour
+    double serviceTime;     // hours spent making each delivery
+    double timeBudget;      // in seconds, for improving the routes; 0 to improve them until no move helps
+    unsigned int threads;   // 0 for as many as the machine has
+    bool roadDistance;      // plan with the length of the routes between stops, not straight lines
+    double snapRadius;      // as in PlannerOptions
+    RouterOptions router;   // for the road distances and the vehicles' directions
+};
+
+  // One vehicle's part of a fleet plan.
+struct VehiclePlan
+{
+    VehiclePlan()
+     : distance(0)
+    {}
+
+    std::vector<unsigned int> deliveries;   // indexes into the deliveries planned, in the order made
+    std::vector<double> arrival;            // when the vehicle reaches each, in hours, following commands
+    std::vector<DeliveryCommand> commands;  // from the depot, through the deliveries, and back;
+                                            // they name streets through the planner's StreetMap
+    double distance;                        // driven, in miles
+};
+
+class FleetPlannerImpl;
+
+  // Plans the deliveries of a fleet of vehicles leaving one depot together:
+  // which vehicle makes each delivery and in what order, keeping within each
+  // vehicle's capacity and each delivery's time window while keeping the
+  // total distance short.
+class FleetPlanner
+{
+public:
+    FleetPlanner(const StreetMap* sm, const FleetOptions& options);
+    ~FleetPlanner();
+      // vehicles gets one plan per vehicle (some may make no deliveries), and
+      // unassigned the indexes of the deliveries no vehicle could reach from
+      // the depot, make in time or had room for.  Returns BAD_COORD if the depot or a delivery
+      // isn't on the map, and NO_ROUTE if a vehicle's route can't be driven.
+    DeliveryResult generateFleetPlan(
+        const GeoCoord& depot,
+        const std::vector<FleetDelivery>& deliveries,
+        std::vector<VehiclePlan>& vehicles,
+        std::vector<unsigned int>& unassigned,
+        double& totalDistanceTravelled) const;
+      // We prevent a FleetPlanner object from being copied or assigned.
+    FleetPlanner(const FleetPlanner&) = delete;
+    FleetPlanner& operator=(const FleetPlanner&) = delete;
+private:
+    FleetPlannerImpl* m_impl;
+};
+
 // Tools for computing distance between GeoCoords, angle of a StreetSegment,
 // and angle between two StreetSegments 
 
@@ -253,20 +696,28 @@ inline double rad2deg(double rad) {
 * @param lon2d Longitude of the second point in degrees
 * @return The distance between the two points in kilometers
 */
-inline double distanceEarthKM(const GeoCoord& g1, const GeoCoord& g2) {
+inline double distanceEarthKM(double lat1d, double lon1d, double lat2d, double lon2d) {
     static const double earthRadiusKm = 6371.0;
-    double lat1r = deg2rad(g1.latitude);
-    double lon1r = deg2rad(g1.longitude);
-    double lat2r = deg2rad(g2.latitude);
-    double lon2r = deg2rad(g2.longitude);
+    double lat1r = deg2rad(lat1d);
+    double lon1r = deg2rad(lon1d);
+    double lat2r = deg2rad(lat2d);
+    double lon2r = deg2rad(lon2d);
     double u = std::sin((lat2r - lat1r) / 2);
     double v = std::sin((lon2r - lon1r) / 2);
     return 2.0 * earthRadiusKm * std::asin(std::sqrt(u * u + std::cos(lat1r) * std::cos(lat2r) * v * v));
 }
 
-inline double distanceEarthMiles(const GeoCoord& g1, const GeoCoord& g2) {
+inline double distanceEarthKM(const GeoCoord& g1, const GeoCoord& g2) {
+    return distanceEarthKM(g1.latitude, g1.longitude, g2.latitude, g2.longitude);
+}
+
+inline double distanceEarthMiles(double lat1d, double lon1d, double lat2d, double lon2d) {
     const double milesPerKm = 1 / 1.609344;
-    return distanceEarthKM(g1, g2) * milesPerKm;
+    return distanceEarthKM(lat1d, lon1d, lat2d, lon2d) * milesPerKm;
+}
+
+inline double distanceEarthMiles(const GeoCoord& g1, const GeoCoord& g2) {
+    return distanceEarthMiles(g1.latitude, g1.longitude, g2.latitude, g2.longitude);
 }
 
 inline double angleBetween2Lines(const StreetSegment& line1, const StreetSegment& line2)
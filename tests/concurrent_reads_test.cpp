@@ -0,0 +1,95 @@
+// concurrent_reads_test.cpp
+
+// Stress test for ExpandableHashMap's ConcurrentReads layout.  One writer
+// makes 300,000 inserts and replacements over 50,000 keys, growing the
+// table several times, while reader threads look keys up with find() and
+// visit() and check that every value they see is whole: each value holds
+// a, 3a and a vector of a % 7 elements, and a % 50,000 is its key.  Then
+// the map must hold the writer's last value for every key it wrote.
+// Worth running under ThreadSanitizer as well (add -fsanitize=thread).
+
+#include "ExpandableHashMap.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace std;
+
+unsigned int hasher(const unsigned int& n)
+{
+    return n * 2654435761u;
+}
+
+const unsigned int KEYS = 50000;
+
+struct Value
+{
+    unsigned int a;
+    unsigned int b;
+    vector<unsigned int> pad;
+};
+
+static bool whole(unsigned int key, const Value& v)
+{
+    return v.b == v.a * 3 && v.pad.size() == v.a % 7 && v.a % KEYS == key;
+}
+
+int main(int argc, char* argv[])
+{
+    int readers = argc > 1 ? atoi(argv[1]) : 4;
+    ExpandableHashMap<unsigned int, Value, ConcurrentReads> m;
+    atomic<bool> stop(false);
+    atomic<long> reads(0);
+    atomic<long> bad(0);
+
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++)
+    {
+        threads.push_back(thread([&, r]
+        {
+            mt19937 rng(r);
+            long n = 0;
+            while (!stop)
+            {
+                unsigned int key = rng() % KEYS;
+                Value v;
+                if (m.find(key, v) && !whole(key, v))
+                    bad++;
+                m.visit(key, [&](const Value& in) { if (!whole(key, in)) bad++; });
+                // on a machine with fewer cores than threads, let the
+                // writer run now and then
+                if (++n % 4096 == 0)
+                    this_thread::yield();
+            }
+            reads += n;
+        }));
+    }
+
+    map<unsigned int, unsigned int> last;
+    mt19937 rng(99);
+    for (int i = 0; i < 300000; i++)
+    {
+        unsigned int key = rng() % KEYS;
+        unsigned int a = key + KEYS * (rng() % 100);
+        m.associate(key, Value{ a, a * 3, vector<unsigned int>(a % 7) });
+        last[key] = a;
+    }
+    stop = true;
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    for (map<unsigned int, unsigned int>::iterator p = last.begin(); p != last.end(); p++)
+    {
+        Value v;
+        if (!m.find(p->first, v) || v.a != p->second)
+            bad++;
+    }
+    if (m.size() != int(last.size()))
+        bad++;
+
+    printf("%ld reads by %d threads, %d keys, %ld bad\n", reads.load(), readers, m.size(), bad.load());
+    return bad == 0 ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+// fleet_test.cpp
+
+// Checks FleetPlanner's plans on random batches of deliveries from one
+// depot: 1 to 12 vehicles, with and without a capacity, service time and
+// time windows, planned by straight line and by road.  Every batch must
+// give one plan per vehicle, each delivery kept must be on exactly one of
+// them, and unassigned must be exactly the rest, in order.  No vehicle may
+// carry more than its capacity, or arrive anywhere after the window has
+// closed, and the total must be the sum of the vehicles' distances.  Some
+// batches add a delivery too heavy for any vehicle, or one whose window
+// closes before a vehicle could get there, which must be left unassigned;
+// others put deliveries anywhere on the map, so those the depot can't
+// reach must be too.  Each plan must also come out the same with one
+// thread as with several.
+
+#include "provided.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+using namespace std;
+
+// Whether the plan keeps to the rules above; describes the first broken
+// one.
+static bool valid(const vector<FleetDelivery>& deliveries, const FleetOptions& options,
+                  const vector<VehiclePlan>& vehicles, const vector<unsigned int>& unassigned, double total)
+{
+    if (vehicles.size() != options.vehicleCount)
+    {
+        printf("  %zu plans for %u vehicles\n", vehicles.size(), options.vehicleCount);
+        return false;
+    }
+    vector<int> seen(deliveries.size(), 0);
+    double sum = 0;
+    for (size_t v = 0; v < vehicles.size(); v++)
+    {
+        const VehiclePlan& plan = vehicles[v];
+        if (plan.arrival.size() != plan.deliveries.size())
+        {
+            printf("  vehicle %zu: %zu arrivals for %zu deliveries\n", v, plan.arrival.size(),
+                   plan.deliveries.size());
+            return false;
+        }
+        double load = 0;
+        for (size_t i = 0; i < plan.deliveries.size(); i++)
+        {
+            unsigned int d = plan.deliveries[i];
+            if (d >= deliveries.size())
+            {
+                printf("  vehicle %zu: no delivery %u\n", v, d);
+                return false;
+            }
+            seen[d]++;
+            load += deliveries[d].load;
+            if (plan.arrival[i] > deliveries[d].latest + 1e-9)
+            {
+                printf("  vehicle %zu: arrives at delivery %u at %.6f, after %.6f\n", v, d, plan.arrival[i],
+                       deliveries[d].latest);
+                return false;
+            }
+        }
+        if (load > options.capacity + 1e-9)
+        {
+            printf("  vehicle %zu: carries %g, more than %g\n", v, load, options.capacity);
+            return false;
+        }
+        sum += plan.distance;
+    }
+    if (fabs(sum - total) > 1e-9 * max(1.0, total))
+    {
+        printf("  total %.9f, but the vehicles drive %.9f\n", total, sum);
+        return false;
+    }
+    for (size_t k = 0; k < unassigned.size(); k++)
+    {
+        if (unassigned[k] >= deliveries.size() || (k > 0 && unassigned[k] <= unassigned[k-1]))
+        {
+            printf("  unassigned isn't in order\n");
+            return false;
+        }
+        if (seen[unassigned[k]] != 0)
+        {
+            printf("  delivery %u is unassigned but on a route\n", unassigned[k]);
+            return false;
+        }
+        seen[unassigned[k]] = 1;
+    }
+    for (size_t d = 0; d < seen.size(); d++)
+    {
+        if (seen[d] != 1)
+        {
+            printf("  delivery %zu is on %d routes\n", d, seen[d]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    ContractionHierarchy hierarchy;
+    if (!hierarchy.build(&sm))
+    {
+        fprintf(stderr, "Couldn't build the hierarchy\n");
+        return 1;
+    }
+    mt19937 rng(11);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+
+    // the nodes the depot can reach
+    unsigned int depotNode = node(rng);
+    vector<unsigned int> all(graph.nodeCount);
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        all[i] = i;
+    PointToPointRouter router(&sm);
+    vector<double> fromDepot;
+    router.computeDistanceMatrix(vector<unsigned int>(1, depotNode), all, fromDepot);
+    vector<unsigned int> reachable;
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        if (fromDepot[i] != numeric_limits<double>::infinity())
+            reachable.push_back(i);
+    GeoCoord depot = sm.coordOf(depotNode);
+
+    int batches = 0, failures = 0;
+    for (int s = 0; s < 40; s++)
+    {
+        FleetOptions options;
+        options.vehicleCount = 1 + rng() % 12;
+        options.capacity = s % 3 == 0 ? numeric_limits<double>::infinity() : 10 + rng() % 40;
+        options.serviceTime = s % 2 == 1 ? 0.05 : 0;
+        options.threads = 1 + s % 4;
+        options.roadDistance = s % 4 == 3;
+        options.router.hierarchy = &hierarchy;
+
+        // deliveries the depot can reach, except in the last ten batches,
+        // where they may be anywhere
+        bool anywhere = s >= 30;
+        bool windows = s % 3 != 1;
+        unsigned int n = 5 + rng() % 300;
+        vector<FleetDelivery> deliveries;
+        vector<unsigned int> impossible;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            unsigned int at = anywhere ? node(rng) : reachable[rng() % reachable.size()];
+            if (fromDepot[at] == numeric_limits<double>::infinity())
+                impossible.push_back(i);
+            double load = 1 + rng() % 3;
+            if (windows)
+            {
+                double earliest = uniform_real_distribution<double>(0, 3)(rng);
+                double latest = earliest + uniform_real_distribution<double>(0.5, 1.5)(rng);
+                deliveries.push_back(FleetDelivery(DeliveryRequest("item", sm.coordOf(at)), load, earliest, latest));
+            }
+            else
+                deliveries.push_back(FleetDelivery(DeliveryRequest("item", sm.coordOf(at)), load));
+        }
+        if (s % 7 == 0 && options.capacity != numeric_limits<double>::infinity())
+        {
+            unsigned int at = reachable[rng() % reachable.size()];
+            impossible.push_back(deliveries.size());
+            deliveries.push_back(FleetDelivery(DeliveryRequest("heavy", sm.coordOf(at)), options.capacity + 1));
+        }
+        if (s % 7 == 1)
+        {
+            unsigned int at;
+            do
+                at = reachable[rng() % reachable.size()];
+            while (fromDepot[at] < 1);
+            impossible.push_back(deliveries.size());
+            deliveries.push_back(FleetDelivery(DeliveryRequest("late", sm.coordOf(at)), 1, 0, 0.0001));
+        }
+
+        FleetPlanner planner(&sm, options);
+        vector<VehiclePlan> vehicles;
+        vector<unsigned int> unassigned;
+        double total;
+        DeliveryResult result = planner.generateFleetPlan(depot, deliveries, vehicles, unassigned, total);
+        batches++;
+        bool ok = result == DELIVERY_SUCCESS;
+        if (!ok)
+            printf("  result %d\n", result);
+        ok = ok && valid(deliveries, options, vehicles, unassigned, total);
+        for (size_t k = 0; ok && k < impossible.size(); k++)
+        {
+            if (!binary_search(unassigned.begin(), unassigned.end(), impossible[k]))
+            {
+                printf("  delivery %u was planned, but can't be made\n", impossible[k]);
+                ok = false;
+            }
+        }
+
+        // the same plan with one thread
+        FleetOptions oneThread = options;
+        oneThread.threads = 1;
+        FleetPlanner single(&sm, oneThread);
+        vector<VehiclePlan> singleVehicles;
+        vector<unsigned int> singleUnassigned;
+        double singleTotal;
+        single.generateFleetPlan(depot, deliveries, singleVehicles, singleUnassigned, singleTotal);
+        bool same = singleUnassigned == unassigned && singleVehicles.size() == vehicles.size();
+        for (size_t v = 0; same && v < vehicles.size(); v++)
+            same = singleVehicles[v].deliveries == vehicles[v].deliveries;
+        if (ok && !same)
+        {
+            printf("  the plan differs with one thread\n");
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            failures++;
+            printf("batch %d (%zu deliveries, %u vehicles) failed\n", s, deliveries.size(), options.vehicleCount);
+        }
+    }
+    printf("%d of %d plans wrong\n", failures, batches);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// geodistance_test.cpp
+
+// Checks distancesMiles with every kernel the processor can run against a
+// long double haversine, and against distanceEarthMiles: from 200 nodes of
+// the map to every node, and from 20 random points on the globe to 100,000
+// others.  The great circle distances must be within the 1e-14 relative
+// error GeoDistance.h promises up to 10,000 miles, and within 1e-12 of
+// distanceEarthMiles beyond; the equirectangular ones, across the map,
+// within a part in ten million.  distanceMiles must give exactly
+// distanceEarthMiles's bits.
+
+#include "provided.h"
+#include "GeoDistance.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+using namespace std;
+
+static long double exactMiles(long double lat1, long double lon1, long double lat2, long double lon2)
+{
+    const long double radians = 3.14159265358979323846264338327950288L / 180;
+    long double u = sinl((lat2 - lat1) * radians / 2);
+    long double v = sinl((lon2 - lon1) * radians / 2);
+    long double a = min(1.0L, u * u + cosl(lat1 * radians) * cosl(lat2 * radians) * v * v);
+    return 2 * 6371.0L * asinl(sqrtl(a)) / 1.609344L;
+}
+
+static bool check(const char* what, double worst, double bound)
+{
+    bool ok = worst <= bound;
+    printf("    %-46s %8.2g  (at most %g)%s\n", what, worst, bound, ok ? "" : "  FAILED");
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    size_t nodes = graph.nodeCount;
+
+    // points spread evenly over the globe
+    const size_t POINTS = 100000;
+    mt19937_64 rng(7);
+    uniform_real_distribution<double> sine(-1, 1);
+    uniform_real_distribution<double> longitude(-180, 180);
+    vector<double> lat(POINTS), lon(POINTS), cosLat(POINTS);
+    for (size_t i = 0; i < POINTS; i++)
+    {
+        lat[i] = asin(sine(rng)) * 180 / M_PI;
+        lon[i] = longitude(rng);
+        cosLat[i] = cos(deg2rad(lat[i]));
+    }
+
+    bool ok = true;
+    vector<double> out(max(nodes, POINTS));
+    const char* names[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+    for (int k = SCALAR_KERNEL; k <= AVX512_KERNEL; k++)
+    {
+        if (!setGeoDistanceKernel(GeoDistanceKernel(k)))
+        {
+            printf("%s: not supported here\n", names[k]);
+            continue;
+        }
+        printf("%s:\n", names[k]);
+
+        double cityExact = 0, cityEarth = 0, flat = 0;
+        for (size_t o = 0; o < 200; o++)
+        {
+            size_t s = o * 7919 % nodes;
+            distancesMiles(graph.latitude[s], graph.longitude[s], graph.latitude, graph.longitude,
+                           graph.cosLatitude, nodes, &out[0]);
+            for (size_t i = 0; i < nodes; i++)
+            {
+                long double exact = exactMiles(graph.latitude[s], graph.longitude[s], graph.latitude[i], graph.longitude[i]);
+                double earth = distanceEarthMiles(graph.latitude[s], graph.longitude[s], graph.latitude[i], graph.longitude[i]);
+                if (exact > 0)
+                    cityExact = max(cityExact, double(fabsl(out[i] - exact) / exact));
+                cityEarth = max(cityEarth, fabs(out[i] - earth));
+            }
+            distancesMiles(graph.latitude[s], graph.longitude[s], graph.latitude, graph.longitude,
+                           graph.cosLatitude, nodes, &out[0], EQUIRECTANGULAR);
+            for (size_t i = 0; i < nodes; i++)
+            {
+                long double exact = exactMiles(graph.latitude[s], graph.longitude[s], graph.latitude[i], graph.longitude[i]);
+                if (exact > 0.01)
+                    flat = max(flat, double(fabsl(out[i] - exact) / exact));
+            }
+        }
+        ok &= check("city, relative to long double", cityExact, 1e-14);
+        ok &= check("city, miles from distanceEarthMiles", cityEarth, 1e-10);
+        ok &= check("city, equirectangular relative to long double", flat, 1e-7);
+
+        double near = 0, far = 0;
+        for (size_t o = 0; o < 20; o++)
+        {
+            distancesMiles(lat[o], lon[o], &lat[0], &lon[0], &cosLat[0], POINTS, &out[0]);
+            for (size_t i = 0; i < POINTS; i++)
+            {
+                long double exact = exactMiles(lat[o], lon[o], lat[i], lon[i]);
+                if (exact == 0)
+                    continue;
+                if (exact <= 10000)
+                    near = max(near, double(fabsl(out[i] - exact) / exact));
+                else
+                {
+                    double earth = distanceEarthMiles(lat[o], lon[o], lat[i], lon[i]);
+                    far = max(far, fabs(out[i] - earth) / earth);
+                }
+            }
+        }
+        ok &= check("world to 10,000 mi, relative to long double", near, 1e-14);
+        ok &= check("world beyond, relative to distanceEarthMiles", far, 1e-12);
+    }
+
+    size_t differ = 0;
+    for (size_t i = 0; i < nodes; i++)
+    {
+        size_t j = i * 31 % nodes;
+        if (distanceMiles(graph.latitude[i], graph.longitude[i], graph.cosLatitude[i],
+                          graph.latitude[j], graph.longitude[j], graph.cosLatitude[j]) !=
+            distanceEarthMiles(graph.latitude[i], graph.longitude[i], graph.latitude[j], graph.longitude[j]))
+            differ++;
+    }
+    printf("distanceMiles differs from distanceEarthMiles for %zu of %zu pairs\n", differ, nodes);
+    ok &= differ == 0;
+    return ok ? 0 : 1;
+}
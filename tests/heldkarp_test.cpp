@@ -0,0 +1,163 @@
+// heldkarp_test.cpp
+
+// Checks exact ordering against brute force over every order, for 1 to 9
+// deliveries.  First HeldKarp itself, with 1 and with 4 threads, on
+// straight-line distances between random nodes and on random asymmetric
+// distances: its tour must start at point 0, visit every point once, and
+// be no more than a millionth longer than the shortest (the float table's
+// limit).  Then optimizeDeliveryOrder, measuring by straight line and by
+// road, on stops reachable from one depot: the new length must be the
+// shortest to within 1e-9.
+
+#include "provided.h"
+#include "HeldKarp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+using namespace std;
+
+// The shortest closed tour from point 0 through the n points, by trying
+// every order of the rest.
+template <typename Distance>
+double bruteForce(Distance dist, unsigned int n)
+{
+    vector<unsigned int> order(n);
+    for (unsigned int i = 0; i < n; i++)
+        order[i] = i;
+    double best = numeric_limits<double>::infinity();
+    do
+    {
+        double length = 0;
+        for (unsigned int i = 0; i < n; i++)
+            length += dist(order[i], order[(i + 1) % n]);
+        best = min(best, length);
+    } while (next_permutation(order.begin() + 1, order.end()));
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    mt19937 rng(7);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+    uniform_real_distribution<double> length(0.1, 5);
+
+    int trials = 0, failures = 0;
+    double largest = 0;
+    for (unsigned int n = 1; n <= 10; n++)
+    {
+        for (int s = 0; s < (n <= 8 ? 100 : 10); s++)
+        {
+            vector<double> d(n * n);
+            bool asymmetric = s % 2 == 1;
+            vector<unsigned int> nodes(n);
+            for (unsigned int i = 0; i < n; i++)
+                nodes[i] = node(rng);
+            for (unsigned int a = 0; a < n; a++)
+            {
+                for (unsigned int b = 0; b < n; b++)
+                {
+                    if (asymmetric)
+                        d[a * n + b] = a == b ? 0 : length(rng);
+                    else
+                        d[a * n + b] = distanceEarthMiles(graph.latitude[nodes[a]], graph.longitude[nodes[a]],
+                                                          graph.latitude[nodes[b]], graph.longitude[nodes[b]]);
+                }
+            }
+            auto dist = [&](unsigned int a, unsigned int b) { return d[a * n + b]; };
+            double best = bruteForce(dist, n);
+
+            for (unsigned int threads = 1; threads <= 4; threads *= 4)
+            {
+                HeldKarp exact;
+                vector<unsigned int> order;
+                exact.solve(dist, n, threads, order);
+                trials++;
+                vector<unsigned int> sorted = order;
+                sort(sorted.begin(), sorted.end());
+                bool visitsAll = sorted.size() == n;
+                for (unsigned int i = 0; visitsAll && i < n; i++)
+                    visitsAll = sorted[i] == i;
+                if (!visitsAll || order[0] != 0)
+                {
+                    failures++;
+                    continue;
+                }
+                double got = 0;
+                for (unsigned int i = 0; i < n; i++)
+                    got += dist(order[i], order[(i + 1) % n]);
+                if (best > 0)
+                    largest = max(largest, got / best - 1);
+                if (got > best * (1 + 1e-6))
+                    failures++;
+            }
+        }
+    }
+    printf("HeldKarp: %d of %d tours wrong, at most %.2g longer than the shortest\n", failures, trials, largest);
+
+    // stops the depot can reach, so every road distance is finite
+    unsigned int depotNode = node(rng);
+    vector<unsigned int> all(graph.nodeCount);
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        all[i] = i;
+    PointToPointRouter router(&sm);
+    vector<double> fromDepot;
+    router.computeDistanceMatrix(vector<unsigned int>(1, depotNode), all, fromDepot);
+    vector<unsigned int> reachable;
+    for (unsigned int i = 0; i < graph.nodeCount; i++)
+        if (fromDepot[i] != numeric_limits<double>::infinity())
+            reachable.push_back(i);
+    GeoCoord depot = sm.coordOf(depotNode);
+
+    int optimizerTrials = 0, optimizerFailures = 0;
+    for (unsigned int m = 1; m <= 9; m++)
+    {
+        for (int s = 0; s < (m <= 7 ? 20 : 4); s++)
+        {
+            vector<DeliveryRequest> deliveries;
+            vector<unsigned int> nodes(1, depotNode);
+            for (unsigned int i = 0; i < m; i++)
+            {
+                nodes.push_back(reachable[rng() % reachable.size()]);
+                deliveries.push_back(DeliveryRequest("item", sm.coordOf(nodes.back())));
+            }
+            unsigned int n = m + 1;
+            vector<double> road;
+            router.computeDistanceMatrix(nodes, nodes, road);
+
+            for (int byRoad = 0; byRoad < 2; byRoad++)
+            {
+                OptimizerOptions options;
+                options.roadDistance = byRoad == 1;
+                DeliveryOptimizer optimizer(&sm, options);
+                vector<DeliveryRequest> ordered = deliveries;
+                double oldCrow, newCrow, oldRoad, newRoad;
+                optimizer.optimizeDeliveryOrder(depot, ordered, oldCrow, newCrow, oldRoad, newRoad);
+
+                double best;
+                if (byRoad)
+                    best = bruteForce([&](unsigned int a, unsigned int b) { return road[a * n + b]; }, n);
+                else
+                    best = bruteForce([&](unsigned int a, unsigned int b)
+                    {
+                        return distanceEarthMiles(sm.coordOf(nodes[a]), sm.coordOf(nodes[b]));
+                    }, n);
+                double got = byRoad ? newRoad : newCrow;
+                optimizerTrials++;
+                if (fabs(got - best) > 1e-9 * best)
+                    optimizerFailures++;
+            }
+        }
+    }
+    printf("optimizeDeliveryOrder: %d of %d orders not the shortest\n", optimizerFailures, optimizerTrials);
+    return failures == 0 && optimizerFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+// workspace_alloc_test.cpp
+
+// Checks that route searches reuse their thread's search workspace instead
+// of allocating.  Calls to operator new are counted while 500 random routes
+// are found with A*, bidirectional A* and a contraction hierarchy.  Each
+// is run once first, so the workspaces, the heaps and the route's edge
+// vector have already grown to the size those searches need; the second
+// run must allocate nothing.  So must a second 2 x 2 distance matrix, the
+// size a DeliveryPlanner asks for between two stops, which is searched on
+// the calling thread.  The allocations of a second 20 x 20 matrix are
+// printed too, but not checked, since it may start threads.
+
+#include "provided.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+static unsigned long long allocations = 0;
+
+void* operator new(size_t n)
+{
+    allocations++;
+    void* p = malloc(n == 0 ? 1 : n);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// Allocations made by the second of two runs over the same pairs.
+static unsigned long long routeTwice(const PointToPointRouter& router,
+                                     const vector<pair<unsigned int, unsigned int> >& pairs)
+{
+    CompactRoute route;
+    unsigned long long before = 0;
+    for (int run = 0; run < 2; run++)
+    {
+        before = allocations;
+        for (size_t i = 0; i < pairs.size(); i++)
+            router.generatePointToPointRoute(pairs[i].first, pairs[i].second, route);
+    }
+    return allocations - before;
+}
+
+int main(int argc, char* argv[])
+{
+    StreetMap sm;
+    if (!sm.load(argc > 1 ? argv[1] : "mapdata.txt"))
+    {
+        fprintf(stderr, "Couldn't load the map\n");
+        return 1;
+    }
+    const StreetGraph& graph = sm.graph();
+    ContractionHierarchy ch;
+    if (!ch.build(&sm))
+    {
+        fprintf(stderr, "Couldn't build the hierarchy\n");
+        return 1;
+    }
+
+    mt19937 rng(1);
+    uniform_int_distribution<unsigned int> node(0, graph.nodeCount - 1);
+    vector<pair<unsigned int, unsigned int> > pairs;
+    for (int i = 0; i < 500; i++)
+    {
+        unsigned int from = node(rng);
+        pairs.push_back(make_pair(from, node(rng)));
+    }
+
+    bool ok = true;
+    const char* names[] = { "A*", "bidirectional A*", "hierarchy" };
+    for (int mode = 0; mode < 3; mode++)
+    {
+        RouterOptions options;
+        options.bidirectional = mode == 1;
+        options.hierarchy = mode == 2 ? &ch : nullptr;
+        PointToPointRouter router(&sm, options);
+        unsigned long long made = routeTwice(router, pairs);
+        printf("%-18s %llu allocations over %zu routes\n", names[mode], made, pairs.size());
+        ok &= made == 0;
+    }
+
+    PointToPointRouter router(&sm);
+    for (size_t size = 2; size <= 20; size += 18)
+    {
+        vector<unsigned int> sources(size), targets(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            sources[i] = node(rng);
+            targets[i] = node(rng);
+        }
+        vector<double> distances;
+        router.computeDistanceMatrix(sources, targets, distances);
+        unsigned long long before = allocations;
+        router.computeDistanceMatrix(sources, targets, distances);
+        unsigned long long made = allocations - before;
+        printf("%-18s %llu allocations for a %zu x %zu matrix\n", "distance matrix", made, size, size);
+        if (size == 2)
+            ok &= made == 0;
+    }
+
+    return ok ? 0 : 1;
+}